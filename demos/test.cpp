@@ -10,6 +10,7 @@
 #include "bloom.hpp"
 
 #include <thread>
+#include <iostream>
 
 struct Vertex {
     glm::vec3 position;
@@ -56,7 +57,6 @@ class Test final : public ignis::IEngine {
 
     std::optional<ignis::GLTFModel> m_model;
 
-    bool m_bloomAvailable = false;
     ignis::BloomPostProcess m_bloomPass;
 
     void setup() override {
@@ -67,30 +67,37 @@ class Test final : public ignis::IEngine {
         getGlobalResourceScope().addDeferredCleanupFunction([&]() { m_model = std::nullopt; });
     }
 
-    void onWindowSizeChanged(glm::vec<2, uint32_t> size) override {
-        m_bloomPass = {};
-        m_bloomAvailable = m_bloomPass.setup(getUntilWindowSizeChangeScope());
+    void onSceneSizeChanged(glm::vec<2, uint32_t> size) override {
+        // the blur chains were declared by addPostProcessingPasses, and have just been allocated by the render graph
+        if (!m_bloomPass.setup(getUntilSceneSizeChangeScope(), getRenderGraph()))
+            IGNIS_LOG("Bloom", Warning, "Failed to set up bloom, it won't be rendered");
     }
 
-    void update() override {
-        if (m_model->shouldSetup())
-            m_model->setup(m_camera.uniform.getLayout());
-    }
-    
-    void recordGBufferCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) override {
-        m_camera.m_buffers[getInFlightIndex()].copyData(m_camera.getUniformData(viewport));
+    void prepareFrame(vk::Extent2D viewport) override {
+        m_camera.update(viewport);
 
         if (m_model->isReady())
-            m_model->drawMeshes(cmd, m_camera);
+            m_model->prepareDraw();
     }
 
-    void recordLightingCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) override {
-        if (m_model->isReady())
-            m_model->drawLights(cmd, m_camera);
+    uint32_t getGBufferChunkCount() override {
+        return m_model->isReady() ? getWorkerPool().getThreadCount() : 0;
+    }
+
+    void recordGBufferChunk(vk::CommandBuffer cmd, vk::Extent2D viewport, uint32_t chunkIndex, uint32_t chunkCount) override {
+        m_model->drawMeshes(cmd, m_camera, chunkIndex, chunkCount);
+    }
+
+    uint32_t getLightingChunkCount() override {
+        return m_model->isReady() ? getWorkerPool().getThreadCount() : 0;
     }
 
-    void recordPostProcessingCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) override {
-        m_bloomPass.draw(cmd);
+    void recordLightingChunk(vk::CommandBuffer cmd, vk::Extent2D viewport, uint32_t chunkIndex, uint32_t chunkCount) override {
+        m_model->drawLights(cmd, m_camera, chunkIndex, chunkCount);
+    }
+
+    void addPostProcessingPasses(ignis::RenderGraph& graph) override {
+        m_bloomPass.addPasses(graph);
     }
 
     void drawUI() override {
@@ -104,9 +111,133 @@ class Test final : public ignis::IEngine {
 
         ImGui::Begin("Metrics");
         ImGui::Text("FPS: %f", 1.0f / getDeltaTime());
+        ImGui::Text("Frame command buffers: %u allocated, %u reused",
+            getFrameCommandBufferStats().allocations, getFrameCommandBufferStats().reuses);
+        ImGui::Text("One time command buffers: %u allocated, %u reused",
+            getOneTimeCommandBufferStats().allocations, getOneTimeCommandBufferStats().reuses);
+        ImGui::Text("Render graph: %u passes, %u culled, %u image barriers in %u calls",
+            getRenderGraph().getStats().passCount, getRenderGraph().getStats().culledPassCount,
+            getRenderGraph().getStats().imageBarrierCount, getRenderGraph().getStats().barrierCallCount);
+        ImGui::Text("Barriers: %u in %u calls", getBarrierStats().barriers, getBarrierStats().calls);
+        ImGui::SameLine();
+        bool debugRedundantTransitions = ignis::ImageLayoutTransition::getDebugRedundantTransitions();
+        if (ImGui::Checkbox("Warn on redundant transitions", &debugRedundantTransitions))
+            ignis::ImageLayoutTransition::setDebugRedundantTransitions(debugRedundantTransitions);
+        ImGui::Text("Transient images: %u in %.2fMiB, %.2fMiB saved by aliasing, %u lazily allocated",
+            getRenderGraph().getStats().transientImageCount,
+            getRenderGraph().getStats().transientMemorySize / (1024.0 * 1024.0),
+            getRenderGraph().getStats().aliasedMemorySaved / (1024.0 * 1024.0),
+            getRenderGraph().getStats().lazyImageCount);
+        ignis::StagingPool::Stats stagingStats = getUploadEngine().getStagingStats();
+        ImGui::Text("Staging: %.2fMiB in flight (peak %.2fMiB), %.2fMiB pending, %u chunks (%u free)",
+            stagingStats.bytesInFlight / (1024.0 * 1024.0), stagingStats.peakBytesInFlight / (1024.0 * 1024.0),
+            stagingStats.bytesPending / (1024.0 * 1024.0), stagingStats.chunkCount, stagingStats.freeChunkCount);
+        ignis::GeometryPool::Stats geometryStats = getGeometryPool().getStats();
+        ImGui::Text("Geometry: %u allocations, %llu/%llu vertices in %llu free ranges, %llu/%llu indices in %llu free ranges",
+            geometryStats.allocationCount,
+            (unsigned long long)geometryStats.verticesUsed, (unsigned long long)geometryStats.vertexCapacity,
+            (unsigned long long)geometryStats.vertexFreeRanges,
+            (unsigned long long)geometryStats.indicesUsed, (unsigned long long)geometryStats.indexCapacity,
+            (unsigned long long)geometryStats.indexFreeRanges);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Compact")) getGeometryPool().compact();
+
+        if (ImGui::TreeNode("Geometry placement")) {
+            for (auto placement : { ignis::GeometryPool::DeviceLocal, ignis::GeometryPool::HostVisible }) {
+                ignis::GeometryPool::Stats stats = getGeometryPool(placement).getStats();
+                ImGui::Text("%s pool: vertices in %s, indices in %s", ignis::GeometryPool::getPlacementName(placement),
+                    vk::to_string(stats.vertexMemory[ignis::GeometryPool::Position]).c_str(),
+                    vk::to_string(stats.indexMemory).c_str());
+            }
+
+            ImGui::TreePop();
+        }
+        ImGui::Text("Input latency: %.2fms to present, %.2fms to GPU finished",
+            getLatencyStats().inputToPresent * 1000.0, getLatencyStats().inputToGPUFinished * 1000.0);
+
+        if (ImGui::TreeNode("Frame pacing")) {
+            static const std::array<vk::PresentModeKHR, 3> presentModes {
+                vk::PresentModeKHR::eFifo, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate };
+
+            if (ImGui::BeginCombo("Present mode", vk::to_string(getPresentMode()).c_str())) {
+                for (auto presentMode : presentModes)
+                    if (ImGui::Selectable(vk::to_string(presentMode).c_str(), presentMode == getPresentMode()))
+                        setPresentMode(presentMode);
+
+                ImGui::EndCombo();
+            }
+
+            int maxQueuedFrames = getMaxQueuedFrames();
+            if (ImGui::SliderInt("Max queued frames", &maxQueuedFrames, 1, s_framesInFlight))
+                setMaxQueuedFrames(maxQueuedFrames);
+
+            float frameRateLimit = getFrameRateLimit();
+            if (ImGui::DragFloat("Frame rate limit", &frameRateLimit, 1.0f, 0.0f, 1000.0f, frameRateLimit > 0.0f ? "%.0f" : "Unlimited"))
+                setFrameRateLimit(frameRateLimit);
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Render scale")) {
+            ImGui::Text("Scene resolution: %ux%u", getSceneExtent().width, getSceneExtent().height);
+
+            bool autoRenderScale = isAutoRenderScale();
+            if (ImGui::Checkbox("Automatic", &autoRenderScale))
+                setAutoRenderScale(autoRenderScale);
+
+            if (autoRenderScale) {
+                float targetFrameTime = getTargetFrameTime();
+                if (ImGui::DragFloat("Target GPU frame time", &targetFrameTime, 0.1f, 1.0f, 100.0f, "%.1fms"))
+                    setTargetFrameTime(targetFrameTime);
+
+                ImGui::Text("Render scale: %.2f", getRenderScale());
+            } else {
+                float renderScale = getRenderScale();
+                if (ImGui::SliderFloat("Render scale", &renderScale, s_minRenderScale, 1.0f))
+                    setRenderScale(renderScale);
+            }
+
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Memory")) {
+            if (!hasMemoryBudgetExtension()) ImGui::TextDisabled("VK_EXT_memory_budget is unsupported, budgets are estimates");
+
+            const auto& budgets = getMemoryBudgets();
+            for (uint32_t heap = 0; heap < budgets.size(); heap++) {
+                const MemoryHeapBudget& budget = budgets[heap];
+                char overlay[128];
+                snprintf(overlay, sizeof(overlay), "%.1f/%.1fMiB", budget.usage / (1024.0 * 1024.0), budget.budget / (1024.0 * 1024.0));
+
+                ImGui::Text("Heap %u%s: %u allocations in %u blocks", heap,
+                    budget.flags & vk::MemoryHeapFlagBits::eDeviceLocal ? " (device local)" : "",
+                    budget.allocationCount, budget.blockCount);
+                ImGui::ProgressBar(budget.budget > 0 ? static_cast<float>(budget.usage) / budget.budget : 0.0f, ImVec2 { -1.0f, 0.0f }, overlay);
+            }
+
+            if (ImGui::BeginTable("Scopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+                ImGui::TableSetupColumn("Scope");
+                ImGui::TableSetupColumn("Allocations");
+                ImGui::TableSetupColumn("Size");
+                ImGui::TableHeadersRow();
+
+                for (auto& usage : ignis::ResourceScope::getMemoryUsage()) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(usage.name.empty() ? "(unnamed)" : usage.name.c_str());
+                    ImGui::TableNextColumn(); ImGui::Text("%u", usage.allocationCount);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2fMiB", usage.bytes / (1024.0 * 1024.0));
+                }
+
+                ImGui::EndTable();
+            }
+
+            ImGui::TreePop();
+        }
+
         ImGui::End();
 
         getLog().draw();
+        getGPUProfiler().draw();
 
         ImGui::Begin("Scene");
         
@@ -117,7 +248,7 @@ class Test final : public ignis::IEngine {
 
             if (ImGui::Button("Load")) {
                 m_model = ignis::GLTFModel();
-                m_model->loadAsync(filename);
+                m_model->loadAsync(filename, m_camera.uniform.getLayout());
                 filename[0] = '\0';
             }
 
@@ -159,14 +290,41 @@ class Test final : public ignis::IEngine {
     std::string getName()       override { return "Test"; }
     uint32_t    getAppVersion() override { return VK_MAKE_API_VERSION(0, 1, 0, 0); }
 
+    bool     isHeadless()            override { return s_headlessFrameCount > 0; }
+    uint64_t getHeadlessFrameCount() override { return s_headlessFrameCount; }
+
+    void onHeadlessFramesFinished() override {
+        if (!s_capturePath.empty()) s_captureSucceeded = captureOutputImage(s_capturePath);
+    }
+
 public:
     static Test s_singleton;
+    static uint64_t s_headlessFrameCount;
+    static std::string s_capturePath;
+    static bool s_captureSucceeded;
 };
 
 Test Test::s_singleton {};
+uint64_t Test::s_headlessFrameCount = 0;
+std::string Test::s_capturePath = "";
+bool Test::s_captureSucceeded = true;
+
+int main(int argc, char** argv) {
+    // usage: test [--headless <frame count> [--capture <file.png>]]
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--headless")
+            Test::s_headlessFrameCount = std::stoull(argv[i + 1]);
+        else if (std::string(argv[i]) == "--capture")
+            Test::s_capturePath = argv[i + 1];
+    }
+
+    if (!Test::s_capturePath.empty() && Test::s_headlessFrameCount == 0) {
+        std::cerr << "--capture needs --headless" << std::endl;
+        return 1;
+    }
 
-int main() {
     ignis::IEngine::get().main();
 
-    return 0;
+    // a failed capture fails the run, so scripted regression tests notice it
+    return Test::s_captureSucceeded ? 0 : 1;
 }
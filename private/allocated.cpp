@@ -3,8 +3,6 @@
 #include "bufferBuilder.hpp"
 #include "common.hpp"
 
-#include <thread>
-
 namespace ignis {
 
 VmaAllocator BaseAllocated::getAllocator() {
@@ -17,6 +15,12 @@ VmaAllocationInfo BaseAllocated::getInfo() {
     return info;
 }
 
+vk::MemoryPropertyFlags BaseAllocated::getMemoryProperties() {
+    VkMemoryPropertyFlags flags;
+    vmaGetAllocationMemoryProperties(getAllocator(), m_allocation, &flags);
+    return vk::MemoryPropertyFlags { flags };
+}
+
 vk::ResultValue<void*> BaseAllocated::map() {
     void* data;
     vk::Result result { vmaMapMemory(getAllocator(), m_allocation, &data) };
@@ -40,50 +44,15 @@ vk::Result BaseAllocated::copyData(const void* data, uint32_t size) {
     return flush();
 }
 
-vk::Result Allocated<vk::Buffer>::stagedCopyData(const void* data, uint32_t size, vk::Fence fence, vk::Semaphore signalSemaphore) {
-    bool async = fence != VK_NULL_HANDLE || signalSemaphore != VK_NULL_HANDLE;
-
-    // using a pointer here so it can be deleted from another thread
-    ResourceScope* tempScope = new ResourceScope("Allocated<vk::Buffer>::stagedCopyData");
-    IEngine& engine = IEngine::get();
-    vk::Device device = engine.getDevice();
-
-    if (fence == VK_NULL_HANDLE) {
-        fence = device.createFence(vk::FenceCreateInfo {});
-        tempScope->addDeferredCleanupFunction([=]() { device.destroyFence(fence); });
-    }
-
-    vk::ResultValue<Allocated<vk::Buffer>> stagingBuffer = BufferBuilder { *tempScope }
-        .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
-        .setBufferUsage(vk::BufferUsageFlagBits::eTransferSrc)
-        .setSizeBuildAndCopyData(data, size);
-    
-    if (stagingBuffer.result != vk::Result::eSuccess) {
-        delete tempScope;
-        return stagingBuffer.result;
-    }
-
-    vk::CommandBuffer cmd = engine.beginOneTimeCommandBuffer(vkb::QueueType::graphics);
-    cmd.copyBuffer(*stagingBuffer.value, m_inner, vk::BufferCopy {}.setSize(size));
-
-    vk::SubmitInfo submitInfo;
-    if (signalSemaphore != VK_NULL_HANDLE) submitInfo.setSignalSemaphores(signalSemaphore);
-
-    engine.submitOneTimeCommandBuffer(cmd, vkb::QueueType::graphics, submitInfo, fence);
+vk::Result Allocated<vk::Buffer>::stagedCopyData(const void* data, uint32_t size, UploadToken* p_token, bool concurrent) {
+    vk::ResultValue<UploadToken> upload = IEngine::get().getUploadEngine().uploadBuffer(
+        m_inner, data, size, 0,
+        vk::PipelineStageFlagBits::eAllCommands, vk::AccessFlagBits::eMemoryRead,
+        concurrent);
 
-    if (async) {
-        std::thread cleanUpAndSignalFence ([=]() {
-            auto _ = device.waitForFences(fence, true, UINT64_MAX);
-            delete tempScope;
-        });
-        cleanUpAndSignalFence.detach();
+    if (p_token) *p_token = upload.value;
 
-        return vk::Result::eSuccess;
-    } else {
-        vk::Result result = device.waitForFences(fence, true, UINT64_MAX);
-        delete tempScope;
-        return result;
-    }
+    return upload.result;
 }
 
 }
@@ -0,0 +1,112 @@
+#include "barrierBatch.hpp"
+#include "engine.hpp"
+
+namespace ignis {
+
+BarrierBatch& BarrierBatch::addMemoryBarrier(const vk::MemoryBarrier2& barrier) {
+    m_memoryBarriers.push_back(barrier);
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::addBufferBarrier(const vk::BufferMemoryBarrier2& barrier) {
+    m_bufferBarriers.push_back(barrier);
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::addImageBarrier(const vk::ImageMemoryBarrier2& barrier) {
+    if (!m_imageBarriers.empty()) {
+        vk::ImageMemoryBarrier2& previous = m_imageBarriers.back();
+        const vk::ImageSubresourceRange& previousRange = previous.subresourceRange;
+        const vk::ImageSubresourceRange& range = barrier.subresourceRange;
+
+        if (previous.image == barrier.image
+         && previous.oldLayout == barrier.oldLayout
+         && previous.newLayout == barrier.newLayout
+         && previous.srcStageMask == barrier.srcStageMask
+         && previous.dstStageMask == barrier.dstStageMask
+         && previous.srcAccessMask == barrier.srcAccessMask
+         && previous.dstAccessMask == barrier.dstAccessMask
+         && previous.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex
+         && previous.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex
+         && previousRange.aspectMask == range.aspectMask
+         && previousRange.baseArrayLayer == range.baseArrayLayer
+         && previousRange.layerCount == range.layerCount
+         && previousRange.levelCount != VK_REMAINING_MIP_LEVELS
+         && previousRange.baseMipLevel + previousRange.levelCount == range.baseMipLevel
+        ) {
+            previous.subresourceRange.levelCount = range.levelCount == VK_REMAINING_MIP_LEVELS
+                ? VK_REMAINING_MIP_LEVELS
+                : previousRange.levelCount + range.levelCount;
+            return *this;
+        }
+    }
+
+    m_imageBarriers.push_back(barrier);
+    return *this;
+}
+
+BarrierBatch& BarrierBatch::addMemoryBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::MemoryBarrier& barrier) {
+    return addMemoryBarrier(vk::MemoryBarrier2 {}
+        .setSrcStageMask(toStageFlags2(srcStageMask))
+        .setDstStageMask(toStageFlags2(dstStageMask))
+        .setSrcAccessMask(toAccessFlags2(barrier.srcAccessMask))
+        .setDstAccessMask(toAccessFlags2(barrier.dstAccessMask)));
+}
+
+BarrierBatch& BarrierBatch::addBufferBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::BufferMemoryBarrier& barrier) {
+    return addBufferBarrier(vk::BufferMemoryBarrier2 {}
+        .setSrcStageMask(toStageFlags2(srcStageMask))
+        .setDstStageMask(toStageFlags2(dstStageMask))
+        .setSrcAccessMask(toAccessFlags2(barrier.srcAccessMask))
+        .setDstAccessMask(toAccessFlags2(barrier.dstAccessMask))
+        .setSrcQueueFamilyIndex(barrier.srcQueueFamilyIndex)
+        .setDstQueueFamilyIndex(barrier.dstQueueFamilyIndex)
+        .setBuffer(barrier.buffer)
+        .setOffset(barrier.offset)
+        .setSize(barrier.size));
+}
+
+BarrierBatch& BarrierBatch::addImageBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::ImageMemoryBarrier& barrier) {
+    return addImageBarrier(vk::ImageMemoryBarrier2 {}
+        .setSrcStageMask(toStageFlags2(srcStageMask))
+        .setDstStageMask(toStageFlags2(dstStageMask))
+        .setSrcAccessMask(toAccessFlags2(barrier.srcAccessMask))
+        .setDstAccessMask(toAccessFlags2(barrier.dstAccessMask))
+        .setOldLayout(barrier.oldLayout)
+        .setNewLayout(barrier.newLayout)
+        .setSrcQueueFamilyIndex(barrier.srcQueueFamilyIndex)
+        .setDstQueueFamilyIndex(barrier.dstQueueFamilyIndex)
+        .setImage(barrier.image)
+        .setSubresourceRange(barrier.subresourceRange));
+}
+
+void BarrierBatch::flush(vk::CommandBuffer cmd) {
+    if (empty()) return;
+
+    IEngine::get().countBarriers(getBarrierCount());
+
+    auto record = [
+        memoryBarriers = std::move(m_memoryBarriers),
+        bufferBarriers = std::move(m_bufferBarriers),
+        imageBarriers = std::move(m_imageBarriers)
+    ](vk::CommandBuffer cmd) {
+        cmd.pipelineBarrier2KHR(vk::DependencyInfo {}
+            .setMemoryBarriers(memoryBarriers)
+            .setBufferMemoryBarriers(bufferBarriers)
+            .setImageMemoryBarriers(imageBarriers),
+            IEngine::get().getDynamicDispatchLoader());
+    };
+
+    if (cmd) record(cmd);
+    else     IEngine::get().getUploadEngine().recordGraphicsCommands(record);
+
+    clear();
+}
+
+void BarrierBatch::clear() {
+    m_memoryBarriers.clear();
+    m_bufferBarriers.clear();
+    m_imageBarriers.clear();
+}
+
+}
@@ -0,0 +1,168 @@
+#include "blockCompression.hpp"
+
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace ignis {
+
+namespace {
+
+using Block = std::array<glm::u8vec4, 16>;
+
+Block fetchBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY) {
+    Block block;
+
+    for (uint32_t y = 0; y < 4; y++)
+    for (uint32_t x = 0; x < 4; x++) {
+        uint32_t texelX = std::min(blockX * 4 + x, width - 1);
+        uint32_t texelY = std::min(blockY * 4 + y, height - 1);
+        std::memcpy(&block[y * 4 + x], rgba + (size_t { texelY } * width + texelX) * 4, 4);
+    }
+
+    return block;
+}
+
+uint16_t to565(glm::vec3 color) {
+    return uint16_t(std::round(color.r * 31.0f / 255.0f)) << 11
+         | uint16_t(std::round(color.g * 63.0f / 255.0f)) << 5
+         | uint16_t(std::round(color.b * 31.0f / 255.0f));
+}
+
+glm::vec3 from565(uint16_t color) {
+    return {
+        ((color >> 11) & 31) * 255.0f / 31.0f,
+        ((color >> 5) & 63) * 255.0f / 63.0f,
+        (color & 31) * 255.0f / 31.0f,
+    };
+}
+
+/**
+ * @brief Always uses four color mode, which is the only mode BC3's color block has
+ */
+void encodeColorBlock(const Block& block, uint8_t* out) {
+    glm::vec3 minColor { 255.0f };
+    glm::vec3 maxColor { 0.0f };
+
+    for (auto& texel : block) {
+        minColor = glm::min(minColor, glm::vec3 { texel });
+        maxColor = glm::max(maxColor, glm::vec3 { texel });
+    }
+
+    // pulling the endpoints in a little lowers the error of the colors interpolated between them
+    glm::vec3 inset = (maxColor - minColor) / 16.0f;
+    uint16_t color0 = to565(glm::clamp(maxColor - inset, 0.0f, 255.0f));
+    uint16_t color1 = to565(glm::clamp(minColor + inset, 0.0f, 255.0f));
+
+    if (color0 < color1) std::swap(color0, color1);
+
+    uint32_t indices = 0;
+
+    if (color0 != color1) {
+        std::array<glm::vec3, 4> palette { from565(color0), from565(color1) };
+        palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+        palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+        for (uint32_t i = 0; i < 16; i++) {
+            glm::vec3 texel { block[i] };
+            uint32_t best = 0;
+            float bestDistance = FLT_MAX;
+
+            for (uint32_t j = 0; j < 4; j++) {
+                glm::vec3 difference = texel - palette[j];
+                float distance = glm::dot(difference, difference);
+                if (distance < bestDistance) { bestDistance = distance; best = j; }
+            }
+
+            indices |= best << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xff;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xff;
+    out[3] = color1 >> 8;
+    for (uint32_t i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+/**
+ * @brief A single channel block, as used for BC3's alpha and BC4 and BC5's channels
+ */
+void encodeChannelBlock(const Block& block, uint32_t channel, uint8_t* out) {
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+
+    for (auto& texel : block) {
+        minValue = std::min(minValue, texel[channel]);
+        maxValue = std::max(maxValue, texel[channel]);
+    }
+
+    uint64_t indices = 0;
+
+    // with the first endpoint greater, the other six values are interpolated between them
+    if (maxValue > minValue) {
+        std::array<float, 8> palette { float(maxValue), float(minValue) };
+        for (uint32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7.0f;
+
+        for (uint32_t i = 0; i < 16; i++) {
+            float value = block[i][channel];
+            uint64_t best = 0;
+            float bestDistance = FLT_MAX;
+
+            for (uint32_t j = 0; j < 8; j++) {
+                float distance = std::abs(value - palette[j]);
+                if (distance < bestDistance) { bestDistance = distance; best = j; }
+            }
+
+            indices |= best << (3 * i);
+        }
+    }
+
+    out[0] = maxValue;
+    out[1] = minValue;
+    for (uint32_t i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+template<typename EncodeBlock>
+std::vector<uint8_t> compress(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bytesPerBlock, EncodeBlock encodeBlock) {
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    std::vector<uint8_t> ret(size_t { blocksX } * blocksY * bytesPerBlock);
+
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+    for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+        encodeBlock(fetchBlock(rgba, width, height, blockX, blockY), &ret[(size_t { blockY } * blocksX + blockX) * bytesPerBlock]);
+
+    return ret;
+}
+
+}
+
+std::vector<uint8_t> compressBC1(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    return compress(rgba, width, height, 8, [](const Block& block, uint8_t* out) {
+        encodeColorBlock(block, out);
+    });
+}
+
+std::vector<uint8_t> compressBC3(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    return compress(rgba, width, height, 16, [](const Block& block, uint8_t* out) {
+        encodeChannelBlock(block, 3, out);
+        encodeColorBlock(block, out + 8);
+    });
+}
+
+std::vector<uint8_t> compressBC4(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t channel) {
+    return compress(rgba, width, height, 8, [channel](const Block& block, uint8_t* out) {
+        encodeChannelBlock(block, channel, out);
+    });
+}
+
+std::vector<uint8_t> compressBC5(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    return compress(rgba, width, height, 16, [](const Block& block, uint8_t* out) {
+        encodeChannelBlock(block, 0, out);
+        encodeChannelBlock(block, 1, out + 8);
+    });
+}
+
+}
@@ -4,19 +4,20 @@
 
 namespace ignis {
 
-bool BloomPostProcess::setup(ResourceScope& scope) {
+bool BloomPostProcess::setup(ResourceScope& scope, RenderGraph& graph) {
     auto& engine = IEngine::get();
     vk::Device device = engine.getDevice();
     IEngine::GBuffer& gBuffer = engine.getGBuffer();
 
-    auto blurChainImageBuilder = ImageBuilder { scope }
-        .setFormat(gBuffer.emissiveImage->getFormat())
-        .setSize(gBuffer.emissiveImage->getSize())
-        .setMipLevelCount(9)
-        .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+    // the previous setup's resources are in a retired scope
+    m_pipeline = {};
+    m_hBlurChainViews.clear();
+    m_vBlurChainViews.clear();
 
-    m_hBlurChain = blurChainImageBuilder.build();
-    m_vBlurChain = blurChainImageBuilder.build();
+    if (m_hBlurHandle == RenderGraph::s_invalidHandle || m_vBlurHandle == RenderGraph::s_invalidHandle) return false;
+
+    m_hBlurChain = &graph.getImage(m_hBlurHandle);
+    m_vBlurChain = &graph.getImage(m_vBlurHandle);
 
     for (int i = 0; i < m_hBlurChain->getMipLevelCount(); i++)
         m_hBlurChainViews.push_back(ImageViewBuilder { *m_hBlurChain, scope }
@@ -64,7 +65,7 @@ bool BloomPostProcess::setup(ResourceScope& scope) {
         .setMinFilter(vk::Filter::eLinear)
         .setMagFilter(vk::Filter::eLinear));
     
-    scope.addDeferredCleanupFunction([=]() { device.destroySampler(sampler); });
+    scope.addDeferredDestroy(device, sampler);
     
     std::vector<Uniform::Update> uniformUpdates {
         m_emissiveUniform.update(vk::DescriptorType::eCombinedImageSampler, 0, 0)
@@ -114,6 +115,10 @@ bool BloomPostProcess::setup(ResourceScope& scope) {
     return true;
 }
 
+bool BloomPostProcess::isReady() const {
+    return static_cast<bool>(m_pipeline.pipeline);
+}
+
 void BloomPostProcess::beginRenderPass(
     vk::CommandBuffer cmd,
     Image& image, vk::ImageView imageView,
@@ -142,187 +147,112 @@ void BloomPostProcess::beginRenderPass(
         .setMaxDepth(1.0f));
 }
 
-void BloomPostProcess::filterHighlights(vk::CommandBuffer cmd) {
-    IEngine::get().getGBuffer().emissiveImage->transitionLayout()
-        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-        .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-        .execute(cmd);
-
-    m_hBlurChain->transitionLayout()
-        .setOldLayout(vk::ImageLayout::eUndefined)
-        .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .execute(cmd);
-
-    m_vBlurChain->transitionLayout()
-        .setOldLayout(vk::ImageLayout::eUndefined)
-        .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .execute(cmd);
-
-    beginRenderPass(cmd, *m_vBlurChain, m_vBlurChainViews[0]);
-
-    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, m_emissiveUniform.getSet(), {});
-    
-    cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0,
-        PassConfig {
-            PassConfig::Filter, 0, PassConfig::Horizontal,
-            clipping, dispersion, mixing
-        });
-    
+void BloomPostProcess::recordPass(
+    vk::CommandBuffer cmd,
+    Image& image, vk::ImageView imageView,
+    uint32_t mipLevel,
+    vk::AttachmentLoadOp loadOp,
+    vk::DescriptorSet source,
+    PassConfig config
+) {
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.pipeline);
+
+    beginRenderPass(cmd, image, imageView, mipLevel, loadOp);
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, source, {});
+    cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0, config);
     cmd.draw(3, 1, 0, 0);
 
     cmd.endRendering(IEngine::get().getDynamicDispatchLoader());
 }
 
-void BloomPostProcess::blurDownMipChain(vk::CommandBuffer cmd) {
-    assert(m_vBlurChain->layoutIs(vk::ImageLayout::eColorAttachmentOptimal));
-    assert(m_hBlurChain->layoutIs(vk::ImageLayout::eColorAttachmentOptimal));
-
-    for (int i = 0; i < m_hBlurChain->getMipLevelCount() - 1; i++) {
-        m_vBlurChain->transitionLayout(i, 1)
-            .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-            .execute(cmd);
-
-        m_hBlurChain->transitionLayout(i, 1)
-            .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .execute(cmd);
-
-        beginRenderPass(cmd, *m_hBlurChain, m_hBlurChainViews[i], i);
-
-        cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0,
-            PassConfig {
-                PassConfig::Blur, i, PassConfig::Horizontal,
-                clipping, dispersion, mixing
-            });
+void BloomPostProcess::addPasses(RenderGraph& graph) {
+    using Usage = RenderGraph::Usage;
 
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, m_vBlurUniform.getSet(i), {});
-        cmd.draw(3, 1, 0, 0);
-
-        cmd.endRendering(IEngine::get().getDynamicDispatchLoader());
-
-        m_hBlurChain->transitionLayout(i, 1)
-            .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-            .execute(cmd);
-
-        m_vBlurChain->transitionLayout(i + 1, 1)
-            .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .execute(cmd);
-        
-        beginRenderPass(cmd, *m_vBlurChain, m_vBlurChainViews[i + 1], i + 1);
-
-        cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0,
-            PassConfig {
-                PassConfig::Blur, i, PassConfig::Vertical,
-                clipping, dispersion, mixing
-            });
+    IEngine& engine = IEngine::get();
+    vk::Extent2D extent = engine.getSceneExtent();
 
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, m_hBlurUniform.getSet(i), {});
-        cmd.draw(3, 1, 0, 0);
+    // every level must be at least a pixel across
+    uint32_t mipLevelCount = std::min<uint32_t>(s_maxMipLevelCount,
+        std::floor(std::log2(std::max(extent.width, extent.height))) + 1);
 
-        cmd.endRendering(IEngine::get().getDynamicDispatchLoader());
-    }
+    auto blurChainInfo = RenderGraph::TransientImageInfo {
+        .format        = IEngine::GBuffer::s_emissiveFormat,
+        .extent        = extent,
+        .mipLevelCount = mipLevelCount,
+        .usage         = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+    };
 
-    m_vBlurChain->transitionLayout(m_vBlurChain->getMipLevelCount() - 1, 1)
-        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-        .execute(cmd);
-}
+    RenderGraph::ImageHandle emissive = engine.getGBuffer().handles.emissive;
+    RenderGraph::ImageHandle hBlur = m_hBlurHandle = graph.addTransientImage("Bloom horizontal blur chain", blurChainInfo);
+    RenderGraph::ImageHandle vBlur = m_vBlurHandle = graph.addTransientImage("Bloom vertical blur chain", blurChainInfo);
+
+    // settings are read when the pass is recorded, so they can be changed without rebuilding the graph
+    graph.addPass("Bloom filter")
+        .setGroup("Bloom")
+        .read(emissive)
+        .write(vBlur, Usage::ColorAttachment, 0, 1)
+        .setRecordFunction([this](vk::CommandBuffer cmd) {
+            if (!isReady()) return;
+
+            recordPass(cmd, *m_vBlurChain, m_vBlurChainViews[0], 0, vk::AttachmentLoadOp::eClear,
+                m_emissiveUniform.getSet(),
+                { PassConfig::Filter, 0, PassConfig::Horizontal, clipping, dispersion, mixing });
+        });
 
-void BloomPostProcess::overlayUpMipChain(vk::CommandBuffer cmd) {
-    assert(m_vBlurChain->layoutIsConsistent());
-
-    m_vBlurChain->transitionLayout()
-        .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
-        .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .execute(cmd);
-
-    for (int i = m_vBlurChain->getMipLevelCount() - 2; i >= 0; i--) {
-        m_vBlurChain->transitionLayout(i + 1, 1)
-            .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-            .execute(cmd);
-
-        beginRenderPass(cmd, *m_vBlurChain, m_vBlurChainViews[i], i, vk::AttachmentLoadOp::eLoad);
-
-        cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0,
-            PassConfig {
-                PassConfig::Overlay, i + 1, PassConfig::Horizontal,
-                clipping, dispersion, mixing
+    for (int i = 0; i < static_cast<int>(mipLevelCount) - 1; i++) {
+        graph.addPass("Bloom blur " + std::to_string(i) + " horizontal")
+            .setGroup("Bloom")
+            .read(vBlur, Usage::Sampled, i, 1)
+            .write(hBlur, Usage::ColorAttachment, i, 1)
+            .setRecordFunction([this, i](vk::CommandBuffer cmd) {
+                if (!isReady()) return;
+
+                recordPass(cmd, *m_hBlurChain, m_hBlurChainViews[i], i, vk::AttachmentLoadOp::eClear,
+                    m_vBlurUniform.getSet(i),
+                    { PassConfig::Blur, i, PassConfig::Horizontal, clipping, dispersion, mixing });
             });
 
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, m_vBlurUniform.getSet(i + 1), {});
-        cmd.draw(3, 1, 0, 0);
+        graph.addPass("Bloom blur " + std::to_string(i) + " vertical")
+            .setGroup("Bloom")
+            .read(hBlur, Usage::Sampled, i, 1)
+            .write(vBlur, Usage::ColorAttachment, i + 1, 1)
+            .setRecordFunction([this, i](vk::CommandBuffer cmd) {
+                if (!isReady()) return;
 
-        cmd.endRendering(IEngine::get().getDynamicDispatchLoader());
+                recordPass(cmd, *m_vBlurChain, m_vBlurChainViews[i + 1], i + 1, vk::AttachmentLoadOp::eClear,
+                    m_hBlurUniform.getSet(i),
+                    { PassConfig::Blur, i, PassConfig::Vertical, clipping, dispersion, mixing });
+            });
     }
 
-    IEngine::GBuffer& gBuffer = IEngine::get().getGBuffer();
-
-    m_vBlurChain->transitionLayout(0, 1)
-        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-        .execute(cmd);
-
-    gBuffer.emissiveImage->transitionLayout()
-        .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .execute(cmd);
-
-    beginRenderPass(cmd, *gBuffer.emissiveImage, gBuffer.emissiveImageView, 0, vk::AttachmentLoadOp::eLoad);
-
-    cmd.pushConstants<PassConfig>(m_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0,
-        PassConfig {
-            PassConfig::Overlay, 1, PassConfig::Horizontal,
-            clipping, dispersion, 1.0f
-        });
-
-    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipeline.layout, 0, m_vBlurUniform.getSet(), {});
-    cmd.draw(3, 1, 0, 0);
+    for (int i = static_cast<int>(mipLevelCount) - 2; i >= 0; i--) {
+        graph.addPass("Bloom overlay " + std::to_string(i))
+            .setGroup("Bloom")
+            .read(vBlur, Usage::Sampled, i + 1, 1)
+            .write(vBlur, Usage::ColorAttachment, i, 1)
+            .setRecordFunction([this, i](vk::CommandBuffer cmd) {
+                if (!isReady()) return;
+
+                recordPass(cmd, *m_vBlurChain, m_vBlurChainViews[i], i, vk::AttachmentLoadOp::eLoad,
+                    m_vBlurUniform.getSet(i + 1),
+                    { PassConfig::Overlay, i + 1, PassConfig::Horizontal, clipping, dispersion, mixing });
+            });
+    }
 
-    cmd.endRendering(IEngine::get().getDynamicDispatchLoader());
-}
+    graph.addPass("Bloom composite")
+        .setGroup("Bloom")
+        .read(vBlur, Usage::Sampled, 0, 1)
+        .write(emissive)
+        .setRecordFunction([this](vk::CommandBuffer cmd) {
+            if (!isReady()) return;
 
-void BloomPostProcess::draw(vk::CommandBuffer cmd) {
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline.pipeline);
+            IEngine::GBuffer& gBuffer = IEngine::get().getGBuffer();
 
-    filterHighlights(cmd);
-    blurDownMipChain(cmd);
-    overlayUpMipChain(cmd);
+            recordPass(cmd, *gBuffer.emissiveImage, gBuffer.emissiveImageView, 0, vk::AttachmentLoadOp::eLoad,
+                m_vBlurUniform.getSet(),
+                { PassConfig::Overlay, 1, PassConfig::Horizontal, clipping, dispersion, 1.0f });
+        });
 }
 
 }
@@ -1,4 +1,5 @@
 #include "bufferBuilder.hpp"
+#include "common.hpp"
 
 namespace ignis {
 
@@ -22,6 +23,11 @@ BufferBuilder& BufferBuilder::setAllocationUsage(VmaMemoryUsage usage) {
     return *this;
 }
 
+BufferBuilder& BufferBuilder::setAllocationFlags(VmaAllocationCreateFlags flags) {
+    m_allocationCreateInfo.flags = flags;
+    return *this;
+}
+
 BufferBuilder& BufferBuilder::setSize(uint32_t size) {
     m_bufferCreateInfo.setSize(size);
     return *this;
@@ -30,17 +36,22 @@ BufferBuilder& BufferBuilder::setSize(uint32_t size) {
 vk::ResultValue<Allocated<vk::Buffer>> BufferBuilder::build() {
     Allocated<vk::Buffer> value;
 
+    std::vector<uint32_t> queueFamilyIndices = uniqueQueueFamilyIndices(m_queueFamilyIndices);
+    if (queueFamilyIndices.size() < 2) queueFamilyIndices.clear();
+
     VkBufferCreateInfo bufferCreateInfo = m_bufferCreateInfo
-        .setQueueFamilyIndices(m_queueFamilyIndices);
+        .setSharingMode(queueFamilyIndices.empty() ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent)
+        .setQueueFamilyIndices(queueFamilyIndices);
     
     VkBuffer buffer;
 
-    vk::Result result { vmaCreateBuffer(getAllocator(), &bufferCreateInfo, &m_allocationCreateInfo, &buffer, &value.m_allocation, nullptr) };
+    VmaAllocationInfo allocationInfo {};
+    vk::Result result { vmaCreateBuffer(getAllocator(), &bufferCreateInfo, &m_allocationCreateInfo, &buffer, &value.m_allocation, &allocationInfo) };
     *value = buffer;
 
-    r_scope.addDeferredCleanupFunction([=, allocator = getAllocator(), allocation = value.m_allocation]() {
-        vmaDestroyBuffer(allocator, buffer, allocation);
-    });
+    r_scope.addDeferredDestroy(getAllocator(), vk::Buffer { buffer }, value.m_allocation);
+
+    if (result == vk::Result::eSuccess) r_scope.trackAllocation(allocationInfo.size);
 
     return { result, value };
 }
@@ -1,7 +1,6 @@
 #include "camera.hpp"
 #include "common.hpp"
 #include "engine.hpp"
-#include "bufferBuilder.hpp"
 #include "uniformBuilder.hpp"
 
 namespace ignis {
@@ -19,36 +18,36 @@ CameraUniform Camera::getUniformData(vk::Extent2D viewport) {
     return uniform;
 }
 
+bool Camera::update(vk::Extent2D viewport) {
+    FrameAllocator& frameAllocator = IEngine::get().getFrameAllocator();
+
+    FrameAllocation allocation = frameAllocator.allocateAndCopy(getUniformData(viewport), frameAllocator.getUniformAlignment());
+    if (!allocation.isValid()) return false;
+
+    m_dynamicOffset = static_cast<uint32_t>(allocation.offset);
+    return true;
+}
+
 void Camera::setup(ResourceScope& scope) {
     uniform = ignis::UniformBuilder { scope }
         .setPool(ignis::DescriptorPoolBuilder { scope }
-            .setMaxSetCount(IEngine::s_framesInFlight)
-            .addPoolSize({ vk::DescriptorType::eUniformBuffer, IEngine::s_framesInFlight })
+            .setMaxSetCount(1)
+            .addPoolSize({ vk::DescriptorType::eUniformBufferDynamic, 1 })
             .build())
         .addLayouts(ignis::DescriptorLayoutBuilder { scope }
             .addBinding(vk::DescriptorSetLayoutBinding {}
                 .setBinding(0)
-                .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+                .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
                 .setDescriptorCount(1)
                 .setStageFlags(vk::ShaderStageFlagBits::eAllGraphics))
-            .build(), IEngine::s_framesInFlight)
+            .build())
         .build();
 
-    std::vector<Uniform::Update> updates;
-    for (int i = 0; i < IEngine::s_framesInFlight; i++) {
-        m_buffers.push_back(getValue(ignis::BufferBuilder { scope }
-            .addQueueFamilyIndices({ IEngine::get().getQueueIndex(vkb::QueueType::graphics) })
-            .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
-            .setBufferUsage(vk::BufferUsageFlagBits::eUniformBuffer)
-            .setSize<ignis::CameraUniform>(1)
-            .build(), "Failed to create a camera uniform buffer"));
-        
-        updates.push_back(uniform.update(vk::DescriptorType::eUniformBuffer, i, 0)
-            .addBufferInfo(vk::DescriptorBufferInfo {}
-                .setBuffer(*m_buffers.back())
-                .setRange(sizeof(CameraUniform))));
-    }
-    Uniform::updateUniforms(updates);
+    // every frame in flight shares the frame allocator's buffer, so one set is enough
+    Uniform::updateUniforms({ uniform.update(vk::DescriptorType::eUniformBufferDynamic, 0, 0)
+        .addBufferInfo(vk::DescriptorBufferInfo {}
+            .setBuffer(IEngine::get().getFrameAllocator().getBuffer())
+            .setRange(sizeof(CameraUniform))) });
 }
 
 }
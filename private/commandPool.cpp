@@ -0,0 +1,151 @@
+#include "commandPool.hpp"
+#include "engine.hpp"
+
+namespace ignis {
+
+void FrameCommandPool::setup(ResourceScope& scope, uint32_t queueFamilyIndex) {
+    vk::Device device = IEngine::get().getDevice();
+
+    m_pool = device.createCommandPool(vk::CommandPoolCreateInfo {}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(queueFamilyIndex));
+
+    scope.addDeferredCleanupFunction([&, device]() {
+        device.destroyCommandPool(m_pool);
+        m_primaryBuffers.clear();
+        m_secondaryBuffers.clear();
+    });
+}
+
+void FrameCommandPool::reset() {
+    IEngine::get().getDevice().resetCommandPool(m_pool);
+
+    m_primaryCursor = 0;
+    m_secondaryCursor = 0;
+    m_stats = {};
+}
+
+vk::CommandBuffer FrameCommandPool::allocate(vk::CommandBufferLevel level) {
+    bool primary = level == vk::CommandBufferLevel::ePrimary;
+
+    auto& buffers = primary ? m_primaryBuffers : m_secondaryBuffers;
+    auto& cursor = primary ? m_primaryCursor : m_secondaryCursor;
+
+    if (cursor < buffers.size()) {
+        m_stats.reuses++;
+        return buffers[cursor++];
+    }
+
+    buffers.push_back(IEngine::get().getDevice().allocateCommandBuffers(vk::CommandBufferAllocateInfo {}
+        .setCommandBufferCount(1)
+        .setCommandPool(m_pool)
+        .setLevel(level))[0]);
+
+    m_stats.allocations++;
+    cursor++;
+
+    return buffers.back();
+}
+
+void OneTimeCommandPool::setup(ResourceScope& scope, uint32_t queueFamilyIndex) {
+    m_device = IEngine::get().getDevice();
+
+    m_pool = m_device.createCommandPool(vk::CommandPoolCreateInfo {}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient
+                | vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+        .setQueueFamilyIndex(queueFamilyIndex));
+
+    scope.addDeferredCleanupFunction([&]() {
+        for (auto& inFlight : m_inFlight) m_freeFences.push_back(inFlight.fence);
+        for (auto& fence : m_freeFences) m_device.destroyFence(fence);
+        m_device.destroyCommandPool(m_pool);
+
+        m_inFlight.clear();
+        m_freeFences.clear();
+        m_freeBuffers.clear();
+    });
+}
+
+void OneTimeCommandPool::recycle() {
+    for (auto it = m_inFlight.begin(); it != m_inFlight.end();) {
+        if (m_device.getFenceStatus(it->fence) != vk::Result::eSuccess) {
+            it++;
+            continue;
+        }
+
+        m_device.resetFences(it->fence);
+        m_freeFences.push_back(it->fence);
+        m_freeBuffers.push_back(it->cmd);
+        it = m_inFlight.erase(it);
+    }
+}
+
+vk::CommandBuffer OneTimeCommandPool::begin() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    recycle();
+
+    vk::CommandBuffer cmd;
+
+    if (!m_freeBuffers.empty()) {
+        cmd = m_freeBuffers.back();
+        m_freeBuffers.pop_back();
+        m_stats.reuses++;
+    } else {
+        cmd = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo {}
+            .setCommandBufferCount(1)
+            .setCommandPool(m_pool)
+            .setLevel(vk::CommandBufferLevel::ePrimary))[0];
+        m_stats.allocations++;
+    }
+
+    // begin implicitly resets command buffers from a pool created with eResetCommandBuffer
+    cmd.begin(vk::CommandBufferBeginInfo {}.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    return cmd;
+}
+
+void OneTimeCommandPool::submit(vk::CommandBuffer cmd, vk::Queue queue, vk::SubmitInfo submitInfo, bool wait) {
+    cmd.end();
+
+    vk::Fence fence;
+
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+
+        if (!m_freeFences.empty()) {
+            fence = m_freeFences.back();
+            m_freeFences.pop_back();
+        } else {
+            fence = m_device.createFence(vk::FenceCreateInfo {});
+        }
+
+        {
+            auto queueLock = IEngine::get().lockQueue(queue);
+            queue.submit(submitInfo.setCommandBuffers(cmd), fence);
+        }
+
+        if (!wait) {
+            m_inFlight.push_back({ cmd, fence });
+            return;
+        }
+    }
+
+    // waited on outside the lock, and only put back afterwards, so recycle() never resets it under the wait
+    vk::resultCheck(m_device.waitForFences(fence, true, UINT64_MAX), "Failed to wait for a one time submission");
+
+    std::lock_guard<std::mutex> lock { m_mutex };
+    m_device.resetFences(fence);
+    m_freeFences.push_back(fence);
+    m_freeBuffers.push_back(cmd);
+}
+
+CommandBufferStats OneTimeCommandPool::collectStats() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    CommandBufferStats stats = m_stats;
+    m_stats = {};
+    return stats;
+}
+
+}
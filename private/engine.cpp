@@ -2,8 +2,11 @@
 #include "common.hpp"
 #include "uniformBuilder.hpp"
 #include "pipelineBuilder.hpp"
+#include "bufferBuilder.hpp"
 
+#include <external/stb_image_write.h>
 #include <iostream>
+#include <thread>
 
 namespace ignis {
 
@@ -26,20 +29,128 @@ IEngine& IEngine::get() {
 }
 
 vk::CommandBuffer IEngine::beginOneTimeCommandBuffer(vkb::QueueType queueType) {
-    getCommandPool(queueType);
-    vk::CommandBuffer cmd = getDevice().allocateCommandBuffers(vk::CommandBufferAllocateInfo {}
-        .setCommandBufferCount(1)
-        .setCommandPool(getCommandPool(queueType))
-        .setLevel(vk::CommandBufferLevel::ePrimary))[0];
+    return getOneTimeCommandPool(queueType).begin();
+}
 
-    cmd.begin(vk::CommandBufferBeginInfo {}.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+void IEngine::submitOneTimeCommandBuffer(vk::CommandBuffer cmd, vkb::QueueType queueType, vk::SubmitInfo submitInfo, bool wait) {
+    getOneTimeCommandPool(queueType).submit(cmd, getQueue(queueType), submitInfo, wait);
+}
 
-    return cmd;
+vk::CommandBuffer IEngine::beginAsyncComputeCommands() {
+    return m_computeOneTimeCmdPool.begin();
 }
 
-void IEngine::submitOneTimeCommandBuffer(vk::CommandBuffer cmd, vkb::QueueType queueType, vk::SubmitInfo submitInfo, vk::Fence fence) {
-    cmd.end();
-    getQueue(queueType).submit(submitInfo.setCommandBuffers(cmd), fence);
+void IEngine::submitAsyncComputeCommands(vk::CommandBuffer cmd, vk::PipelineStageFlags graphicsWaitStages, ComputeTiming timing) {
+    if (timing == ComputeTiming::AfterGraphics) {
+        m_deferredComputeSubmissions.push_back({ cmd, graphicsWaitStages });
+        return;
+    }
+
+    vk::Semaphore computeFinishedSemaphore = acquireSemaphore();
+
+    m_computeOneTimeCmdPool.submit(cmd, m_computeQueue, vk::SubmitInfo {}
+        .setSignalSemaphores(computeFinishedSemaphore));
+
+    m_pendingGraphicsWaits.push_back({ computeFinishedSemaphore, graphicsWaitStages });
+}
+
+vk::Semaphore IEngine::acquireSemaphore() {
+    if (m_freeSemaphores.empty()) return getDevice().createSemaphore(vk::SemaphoreCreateInfo {});
+
+    vk::Semaphore semaphore = m_freeSemaphores.back();
+    m_freeSemaphores.pop_back();
+    return semaphore;
+}
+
+uint64_t IEngine::getCompletedTimelineValue() const {
+    return getDevice().getSemaphoreCounterValue(m_frameTimeline);
+}
+
+void IEngine::waitForTimelineValue(uint64_t value) const {
+    vk::resultCheck(getDevice().waitSemaphores(vk::SemaphoreWaitInfo {}
+        .setSemaphores(m_frameTimeline)
+        .setValues(value), UINT64_MAX), "Failed to wait for frame timeline");
+}
+
+void IEngine::addDeferredDeletion(std::function<void()> func, uint64_t timelineValue) {
+    if (timelineValue == 0) timelineValue = getFrameTimelineValue();
+
+    std::lock_guard<std::mutex> lock { m_deferredDeletionMutex };
+    m_deferredDeletions.push_back({ timelineValue, std::move(func) });
+}
+
+void IEngine::deferScopeCleanup(ResourceScope& scope, uint64_t timelineValue) {
+    // moving swaps the cleanup functions into the retired scope, which runs them when it is destroyed
+    auto retiredScope = std::make_shared<ResourceScope>();
+    *retiredScope = std::move(scope);
+
+    // the names were swapped too, but the scope is reused under its own name
+    scope.setName(retiredScope->getName());
+    retiredScope->setName(scope.getName() + " (retiring)");
+
+    addDeferredDeletion([retiredScope]() { retiredScope->executeDeferredCleanupFunctions(); }, timelineValue);
+}
+
+void IEngine::processDeferredDeletions(uint64_t completedValue) {
+    std::vector<std::function<void()>> ready;
+
+    {
+        std::lock_guard<std::mutex> lock { m_deferredDeletionMutex };
+
+        auto it = std::stable_partition(m_deferredDeletions.begin(), m_deferredDeletions.end(),
+            [&](const DeferredDeletion& deletion) { return deletion.timelineValue > completedValue; });
+
+        for (auto deletion = it; deletion != m_deferredDeletions.end(); deletion++)
+            ready.push_back(std::move(deletion->func));
+
+        m_deferredDeletions.erase(it, m_deferredDeletions.end());
+    }
+
+    // run outside the lock, since cleanup functions may defer further deletions
+    for (auto& func : ready) func();
+}
+
+vk::CommandBuffer IEngine::allocateFrameCommandBuffer(vk::CommandBufferLevel level) {
+    return m_frameCommandPools[getInFlightIndex()].allocate(level);
+}
+
+void IEngine::recordSecondaryChunks(
+    vk::CommandBuffer cmd,
+    const SecondaryRenderingInfo& renderingInfo,
+    uint32_t chunkCount,
+    std::function<void(vk::CommandBuffer cmd, uint32_t chunkIndex)> func
+) {
+    std::vector<vk::CommandBuffer> secondaries (chunkCount);
+    auto& workerCommandPools = m_workerCommandPools[getInFlightIndex()];
+
+    m_workerPool.dispatch(chunkCount, [&](uint32_t chunkIndex, uint32_t workerIndex) {
+        vk::CommandBuffer secondary = workerCommandPools[workerIndex].allocate(vk::CommandBufferLevel::eSecondary);
+
+        auto inheritanceRenderingInfo = vk::CommandBufferInheritanceRenderingInfo {}
+            .setColorAttachmentFormats(renderingInfo.colorAttachmentFormats)
+            .setDepthAttachmentFormat(renderingInfo.depthAttachmentFormat)
+            .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+        auto inheritanceInfo = vk::CommandBufferInheritanceInfo {}
+            .setPNext(&inheritanceRenderingInfo);
+
+        secondary.begin(vk::CommandBufferBeginInfo {}
+            .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                    | vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+            .setPInheritanceInfo(&inheritanceInfo));
+
+        // dynamic state is not inherited from the primary command buffer
+        secondary.setViewport(0, renderingInfo.viewport);
+        secondary.setScissor(0, renderingInfo.scissor);
+
+        func(secondary, chunkIndex);
+
+        secondary.end();
+        secondaries[chunkIndex] = secondary;
+    });
+
+    // executed in chunk order, regardless of the order they were recorded in
+    cmd.executeCommands(secondaries);
 }
 
 void IEngine::main() {
@@ -53,8 +164,13 @@ void IEngine::main() {
     using std::chrono::microseconds;
     #define SECONDS_BETWEEN(from, to) static_cast<double>(duration_cast<microseconds>(to - from).count()) / 1'000'000.0
 
-    while (!glfwWindowShouldClose(m_window)) {
-        glfwPollEvents();
+    while (isHeadless() ? m_frameCount < getHeadlessFrameCount() : !glfwWindowShouldClose(m_window)) {
+        paceFrame();
+
+        if (!isHeadless()) glfwPollEvents();
+        m_inputSampleTime = std::chrono::steady_clock::now();
+
+        if (!isHeadless() && m_requestedPresentMode != m_presentMode) windowSizeChanged();
 
         m_currentFrameStartTime = std::chrono::high_resolution_clock::now();
         double timeSinceStart = SECONDS_BETWEEN(m_startTime, m_currentFrameStartTime);
@@ -64,7 +180,14 @@ void IEngine::main() {
         double deltaTime = getDeltaTime();
 
         ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+
+        if (isHeadless()) {
+            // there is no platform backend without a window, so feed ImGui the display state ourselves
+            ImGuiIO& imGuiIO = ImGui::GetIO();
+            imGuiIO.DisplaySize = ImVec2 { static_cast<float>(m_outputExtent.width), static_cast<float>(m_outputExtent.height) };
+            imGuiIO.DeltaTime = timeSinceLastFrameStart > 0.0 ? static_cast<float>(timeSinceLastFrameStart) : 1.0f / 60.0f;
+        } else ImGui_ImplGlfw_NewFrame();
+
         ImGui::NewFrame();
 
         ImGuiID dockSpaceID = ImGui::DockSpaceOverViewport(ImGui::GetMainViewport(), ImGuiDockNodeFlags_PassthruCentralNode | ImGuiDockNodeFlags_NoDockingInCentralNode);
@@ -85,6 +208,8 @@ void IEngine::main() {
         lastFrameStart = m_currentFrameStartTime;
     }
 
+    if (isHeadless()) onHeadlessFramesFinished();
+
     getDevice().waitIdle();
 
     getGlobalResourceScope().executeDeferredCleanupFunctions();
@@ -95,35 +220,37 @@ void IEngine::main() {
 void IEngine::init() {
     auto& grs = getGlobalResourceScope();
 
-    glfwInit();
-    grs.addDeferredCleanupFunction([]() {
-        glfwTerminate();
-    });
-    
     glm::ivec2 initialWindowSize = getInitialWindowSize();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    // glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-    // glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_FALSE); -- ImGui does not work with non-retina windows on MacOS >:(
-    m_window = glfwCreateWindow(
-        initialWindowSize.x, initialWindowSize.y,
-        getName().c_str(), nullptr, nullptr
-    );
-
-    glfwSetWindowUserPointer(m_window, this);
-
-    glm::ivec2 _framebufferSize;
-    glfwGetFramebufferSize(m_window, &_framebufferSize.x, &_framebufferSize.y);
-    glm::vec<2, uint32_t> framebufferSize = _framebufferSize;
-
-    grs.addDeferredCleanupFunction([window = m_window]() {
-        glfwDestroyWindow(window);
-    });
 
+    if (!isHeadless()) {
+        glfwInit();
+        grs.addDeferredCleanupFunction([]() {
+            glfwTerminate();
+        });
+        
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        // glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        // glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_FALSE); -- ImGui does not work with non-retina windows on MacOS >:(
+        m_window = glfwCreateWindow(
+            initialWindowSize.x, initialWindowSize.y,
+            getName().c_str(), nullptr, nullptr
+        );
+
+        glfwSetWindowUserPointer(m_window, this);
+
+        grs.addDeferredCleanupFunction([window = m_window]() {
+            glfwDestroyWindow(window);
+        });
+    }
+
+    // the frame timeline uses timeline semaphores from core Vulkan 1.2, rather than VK_KHR_timeline_semaphore
     m_instance = getValue(vkb::InstanceBuilder {}
         .set_app_name(getName().c_str())
         .set_engine_name(getEngineName().c_str())
         .set_app_version(getAppVersion())
         .set_engine_version(getEngineVersion())
+        .require_api_version(1, 2, 0)
+        .set_headless(isHeadless())
         .request_validation_layers()
         .use_default_debug_messenger()
         .build(), "Failed to create a vulkan instance");
@@ -132,79 +259,199 @@ void IEngine::init() {
         vkb::destroy_instance(instance);
     });
 
-    vk::resultCheck(vk::Result { glfwCreateWindowSurface(getInstance(), m_window, nullptr, &m_surface) },
-        "Failed to create a surface");
-    grs.addDeferredCleanupFunction([instance = getInstance(), surface = getSurface()]() {
-        instance.destroySurfaceKHR(surface);
-    });
+    if (!isHeadless()) {
+        vk::resultCheck(vk::Result { glfwCreateWindowSurface(getInstance(), m_window, nullptr, &m_surface) },
+            "Failed to create a surface");
+        grs.addDeferredCleanupFunction([instance = getInstance(), surface = getSurface()]() {
+            instance.destroySurfaceKHR(surface);
+        });
+    }
 
-    m_phys_device = getValue(vkb::PhysicalDeviceSelector { m_instance }
-        .set_surface(m_surface)
+    m_phys_device = getValue(vkb::PhysicalDeviceSelector { m_instance, m_surface }
         .set_minimum_version(1, 2)
         .add_required_extensions({
             "VK_KHR_dynamic_rendering",
             "VK_KHR_depth_stencil_resolve",
             "VK_KHR_create_renderpass2",
             "VK_KHR_multiview",
-            "VK_KHR_maintenance2"
+            "VK_KHR_maintenance2",
+            "VK_KHR_synchronization2"
         })
+        .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+        .set_required_features_12(vk::PhysicalDeviceVulkan12Features {}
+            .setTimelineSemaphore(true))
         .select(), "Failed to select a physical device");
 
+    std::vector<std::string> deviceExtensions = m_phys_device.get_extensions();
+    m_hasMemoryBudgetExtension = std::find(deviceExtensions.begin(), deviceExtensions.end(),
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != deviceExtensions.end();
+
+    if (!m_hasMemoryBudgetExtension)
+        IGNIS_LOG("Engine", Warning, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME " is not supported, memory budgets are estimated");
+
+    // block compressed textures are optional, the device is created with whatever is set here
+    vk::PhysicalDeviceFeatures supportedFeatures = getPhysicalDevice().getFeatures();
+    m_phys_device.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    // so is compute mip generation, which falls back to blitting without these
+    m_phys_device.features.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+    m_phys_device.features.shaderStorageImageArrayDynamicIndexing = supportedFeatures.shaderStorageImageArrayDynamicIndexing;
+
+    if (!supportsBlockCompression())
+        IGNIS_LOG("Engine", Warning, "BC texture compression is not supported, compressed textures can't be loaded");
+
     auto dynamicRenderingFeatures = vk::PhysicalDeviceDynamicRenderingFeatures {}
         .setDynamicRendering(true);
 
+    auto synchronization2Features = vk::PhysicalDeviceSynchronization2Features {}
+        .setSynchronization2(true);
+
     m_device = getValue(vkb::DeviceBuilder { m_phys_device }
         .add_pNext(&dynamicRenderingFeatures)
+        .add_pNext(&synchronization2Features)
         .build(), "Failed to create a logical device");
     
     grs.addDeferredCleanupFunction([device = m_device]() {
         vkb::destroy_device(device);
     });
 
+    // extension commands, e.g. barriers recorded while creating the swapchain images, go through this
+    m_dispatchLoaderDynamic = vk::DispatchLoaderDynamic { getInstance(), vkGetInstanceProcAddr, getDevice(), vkGetDeviceProcAddr };
+
+    // VMA queries budgets with vkGetPhysicalDeviceMemoryProperties2, which is only core from 1.1, so the budget
+    // flag relies on vulkanApiVersion being at least that instead of VK_KHR_get_physical_device_properties2
     VmaAllocatorCreateInfo allocatorCreatInfo {
+        .flags = m_hasMemoryBudgetExtension ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u,
+        .physicalDevice = getPhysicalDevice(),
         .device = getDevice(),
         .instance = getInstance(),
-        .physicalDevice = getPhysicalDevice(),
+        // matches the instance, which the frame timeline needs to be 1.2
+        .vulkanApiVersion = VK_API_VERSION_1_2,
     };
     vk::resultCheck(vk::Result { vmaCreateAllocator(&allocatorCreatInfo, &m_allocator) }, "Failed to create VMA allocator");
     grs.addDeferredCleanupFunction([allocator = m_allocator]() {
         vmaDestroyAllocator(allocator);
     });
+
+    auto timelineCreateInfo = vk::SemaphoreTypeCreateInfo {}
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+
+    m_frameTimeline = getDevice().createSemaphore(vk::SemaphoreCreateInfo {}.setPNext(&timelineCreateInfo));
+
+    // registered early so it runs late, after everything else has had the chance to defer its deletions
+    grs.addDeferredCleanupFunction([&, device = getDevice()]() {
+        // the device is idle by now, so everything can go. Deletions may defer further deletions
+        while (!m_deferredDeletions.empty()) processDeferredDeletions(UINT64_MAX);
+
+        device.destroySemaphore(m_frameTimeline);
+    });
     
     m_graphicsQueue = getValue(m_device.get_queue(vkb::QueueType::graphics), "Failed to find a graphics queue");
-    m_presentQueue = getValue(m_device.get_queue(vkb::QueueType::present), "Failed to find a present queue");
-
     m_graphicsQueueIndex = m_device.get_queue_index(vkb::QueueType::graphics).value();
-    m_presentQueueIndex = m_device.get_queue_index(vkb::QueueType::present).value();
+
+    if (isHeadless()) {
+        // nothing is ever presented, but keep the present queue valid for code that asks for it
+        m_presentQueue = m_graphicsQueue;
+        m_presentQueueIndex = m_graphicsQueueIndex;
+    } else {
+        m_presentQueue = getValue(m_device.get_queue(vkb::QueueType::present), "Failed to find a present queue");
+        m_presentQueueIndex = m_device.get_queue_index(vkb::QueueType::present).value();
+    }
+
+    // prefer a compute queue from a family without graphics support, so compute work can overlap with rendering
+    if (auto computeQueue = m_device.get_queue(vkb::QueueType::compute)) {
+        m_computeQueue = computeQueue.value();
+        m_computeQueueIndex = m_device.get_queue_index(vkb::QueueType::compute).value();
+    } else {
+        m_computeQueue = m_graphicsQueue;
+        m_computeQueueIndex = m_graphicsQueueIndex;
+    }
+
+    IGNIS_LOG("Engine", Info, (hasAsyncCompute() ? "Using an async compute queue" : "No async compute queue, compute work will run on the graphics queue"));
+
+    // prefer a transfer queue from a family without graphics support, so uploads don't stall rendering
+    if (auto transferQueue = m_device.get_queue(vkb::QueueType::transfer)) {
+        m_transferQueue = transferQueue.value();
+        m_transferQueueIndex = m_device.get_queue_index(vkb::QueueType::transfer).value();
+    } else {
+        m_transferQueue = m_graphicsQueue;
+        m_transferQueueIndex = m_graphicsQueueIndex;
+    }
+
+    IGNIS_LOG("Engine", Info, (hasDedicatedTransfer() ? "Using a dedicated transfer queue" : "No dedicated transfer queue, uploads will run on the graphics queue"));
 
     m_graphicsCmdPool = getDevice().createCommandPool(vk::CommandPoolCreateInfo {}.setQueueFamilyIndex(m_graphicsQueueIndex));
     m_presentCmdPool = getDevice().createCommandPool(vk::CommandPoolCreateInfo {}.setQueueFamilyIndex(m_presentQueueIndex));
+    m_computeCmdPool = getDevice().createCommandPool(vk::CommandPoolCreateInfo {}.setQueueFamilyIndex(m_computeQueueIndex));
+    m_transferCmdPool = getDevice().createCommandPool(vk::CommandPoolCreateInfo {}.setQueueFamilyIndex(m_transferQueueIndex));
 
     grs.addDeferredCleanupFunction([=, device = getDevice()]() {
+        device.destroyCommandPool(m_transferCmdPool);
+        device.destroyCommandPool(m_computeCmdPool);
         device.destroyCommandPool(m_presentCmdPool);
         device.destroyCommandPool(m_graphicsCmdPool);
     });
 
+    for (auto& pool : m_frameCommandPools)
+        pool.setup(grs, m_graphicsQueueIndex);
+
+    m_workerPool.setup(grs);
+
+    // command pools are externally synchronised, so each worker records from its own
+    for (auto& pools : m_workerCommandPools) {
+        pools.resize(m_workerPool.getThreadCount());
+        for (auto& pool : pools) pool.setup(grs, m_graphicsQueueIndex);
+    }
+
+    m_graphicsOneTimeCmdPool.setup(grs, m_graphicsQueueIndex);
+    m_presentOneTimeCmdPool.setup(grs, m_presentQueueIndex);
+    m_computeOneTimeCmdPool.setup(grs, m_computeQueueIndex);
+    m_transferOneTimeCmdPool.setup(grs, m_transferQueueIndex);
+
+    m_uploadEngine.setup(grs,
+        m_transferQueue, m_transferQueueIndex,
+        m_graphicsQueue, m_graphicsQueueIndex);
+
+    m_frameAllocator.setup(grs, s_framesInFlight, s_frameAllocatorSize);
+    m_geometryPool.setup(grs, s_initialGeometryVertexCapacity, s_initialGeometryIndexCapacity);
+    m_hostVisibleGeometryPool.setup(grs, s_initialHostVisibleGeometryVertexCapacity,
+        s_initialHostVisibleGeometryIndexCapacity, GeometryPool::HostVisible);
+
+    grs.addDeferredCleanupFunction([&, device = getDevice()]() {
+        for (auto& semaphore : m_freeSemaphores) device.destroySemaphore(semaphore);
+        for (auto& semaphores : m_retiringSemaphores)
+            for (auto& semaphore : semaphores) device.destroySemaphore(semaphore);
+        for (auto& wait : m_pendingGraphicsWaits) {
+            device.destroySemaphore(wait.semaphore);
+            if (wait.upstreamSemaphore) device.destroySemaphore(wait.upstreamSemaphore);
+        }
+
+        m_freeSemaphores.clear();
+        m_pendingGraphicsWaits.clear();
+        m_deferredComputeSubmissions.clear();
+    });
+
+    m_gpuProfiler.setup(grs, s_framesInFlight, m_graphicsQueueIndex);
+
     windowSizeChanged();
     grs.addDeferredCleanupFunction([&]() {
         getUntilWindowSizeChangeScope().executeDeferredCleanupFunctions();
     });
+    grs.addDeferredCleanupFunction([&]() {
+        getUntilSceneSizeChangeScope().executeDeferredCleanupFunctions();
+    });
     
     for (int i = 0; i < s_framesInFlight; i++) {
         m_imageAcquiredSemaphores.push_back(getDevice().createSemaphore(vk::SemaphoreCreateInfo {}));
         m_renderingFinishedSemaphores.push_back(getDevice().createSemaphore(vk::SemaphoreCreateInfo {}));
-        m_frameFinishedFences.push_back(getDevice().createFence(vk::FenceCreateInfo {}
-            .setFlags(vk::FenceCreateFlagBits::eSignaled)));
     }
 
     grs.addDeferredCleanupFunction([&, device = getDevice()]() {
         for (auto& semaphore : m_imageAcquiredSemaphores)     device.destroySemaphore(semaphore);
         for (auto& semaphore : m_renderingFinishedSemaphores) device.destroySemaphore(semaphore);
-        for (auto& fence     : m_frameFinishedFences)         device.destroyFence(fence);
     });
 
-    m_dispatchLoaderDynamic = vk::DispatchLoaderDynamic { getInstance(), vkGetInstanceProcAddr, getDevice(), vkGetDeviceProcAddr };
-
     m_imGuiContext = ImGui::CreateContext();
     grs.addDeferredCleanupFunction([context = getImGuiContext()]() {
         ImGui::DestroyContext(context);
@@ -215,10 +462,12 @@ void IEngine::init() {
     imGuiIO.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
     imGuiIO.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
 
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
-    grs.addDeferredCleanupFunction([]() {
-        ImGui_ImplGlfw_Shutdown();
-    });
+    if (!isHeadless()) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+        grs.addDeferredCleanupFunction([]() {
+            ImGui_ImplGlfw_Shutdown();
+        });
+    }
 
     vk::DescriptorPool imGuiDescriptorPool = DescriptorPoolBuilder { getGlobalResourceScope() }
         .addFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
@@ -248,7 +497,7 @@ void IEngine::init() {
         .ImageCount = s_framesInFlight,
         .MSAASamples = VK_SAMPLE_COUNT_1_BIT,
         .UseDynamicRendering = true,
-        .ColorAttachmentFormat = m_swapchain.image_format,
+        .ColorAttachmentFormat = static_cast<VkFormat>(getOutputFormat()),
         .DescriptorPool = imGuiDescriptorPool
     };
 
@@ -261,11 +510,60 @@ void IEngine::init() {
         .setPipelineLayout(PipelineLayoutBuilder { getGlobalResourceScope() }
             .addSet(getGBuffer().uniform.getLayout())
             .build())
-        .addColorAttachmentFormat(getVkbSwapchain().image_format)
+        .addColorAttachmentFormat(getOutputFormat())
         .addAttachmentBlendState()
         .addStageFromFile("shaders/fullscreen.vert.spv", "main", vk::ShaderStageFlagBits::eVertex)
         .addStageFromFile("shaders/postProcessing.frag.spv", "main", vk::ShaderStageFlagBits::eFragment)
         .build(), "Failed to build post processing pipeline");
+
+    m_mipGenerator.setup(grs);
+}
+
+void IEngine::setPresentMode(vk::PresentModeKHR presentMode) {
+    m_requestedPresentMode = presentMode;
+}
+
+void IEngine::setMaxQueuedFrames(uint32_t count) {
+    m_maxQueuedFrames = std::clamp<uint32_t>(count, 1, s_framesInFlight);
+}
+
+void IEngine::paceFrame() {
+    using clock = std::chrono::steady_clock;
+
+    if (m_frameRateLimit > 0.0) {
+        auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / m_frameRateLimit));
+        auto now = clock::now();
+
+        // after a hitch, start again from now rather than rushing to catch up
+        if (now - m_nextFrameTime > period) m_nextFrameTime = now;
+
+        // sleeping is only accurate to around a millisecond, so sleep most of the way and spin for the rest
+        constexpr auto spinTime = std::chrono::microseconds { 1'500 };
+        if (m_nextFrameTime - now > spinTime) std::this_thread::sleep_until(m_nextFrameTime - spinTime);
+        while (clock::now() < m_nextFrameTime) std::this_thread::yield();
+
+        m_nextFrameTime += period;
+    }
+
+    // waiting here, before input is sampled, rather than once the frame has been recorded is what reduces latency
+    uint64_t frameTimelineValue = getFrameTimelineValue();
+    if (frameTimelineValue > m_maxQueuedFrames) waitForTimelineValue(frameTimelineValue - m_maxQueuedFrames);
+
+    uint64_t completedValue = getCompletedTimelineValue();
+    auto now = clock::now();
+
+    while (!m_pendingInputSamples.empty() && m_pendingInputSamples.front().first <= completedValue) {
+        double latency = std::chrono::duration<double>(now - m_pendingInputSamples.front().second).count();
+        m_latencyStats.inputToGPUFinished = glm::mix(m_latencyStats.inputToGPUFinished, latency, 0.1);
+        m_pendingInputSamples.pop_front();
+    }
+}
+
+void IEngine::recordInputLatency(uint64_t frameTimelineValue) {
+    double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_inputSampleTime).count();
+    m_latencyStats.inputToPresent = glm::mix(m_latencyStats.inputToPresent, latency, 0.1);
+
+    m_pendingInputSamples.push_back({ frameTimelineValue, m_inputSampleTime });
 }
 
 void IEngine::registerDeltaTime(double deltaTime) {
@@ -295,310 +593,570 @@ double IEngine::getTime() const {
 void IEngine::draw(vk::Rect2D gameViewRegion) {
     ImGui::Render();
 
-    vk::Fence frameFinishedFence = m_frameFinishedFences[getInFlightIndex()];
     vk::Semaphore imageAcquiredSemaphore = m_imageAcquiredSemaphores[getInFlightIndex()];
     vk::Semaphore renderingFinishedSemaphore = m_renderingFinishedSemaphores[getInFlightIndex()];
 
-    vk::resultCheck(getDevice().waitForFences(frameFinishedFence, true, UINT64_MAX), "Frame finished fence timed out");
+    waitForTimelineValue(m_inFlightTimelineValues[getInFlightIndex()]);
+    processDeferredDeletions(getCompletedTimelineValue());
 
-    getDevice().resetFences(frameFinishedFence);
+    // models set up in the background wait to allocate geometry until this frame, which draws from it, is submitted
+    auto geometryLock = m_geometryPool.lockForDrawing();
+    auto hostVisibleGeometryLock = m_hostVisibleGeometryPool.lockForDrawing();
 
-    vk::ResultValue<uint32_t> imageIndex = getDevice().acquireNextImageKHR(getSwapchain(), UINT64_MAX, imageAcquiredSemaphore, nullptr);
+    // when headless, the offscreen image ring has one image per frame in flight, which is free now the fence has signalled
+    vk::ResultValue<uint32_t> imageIndex = isHeadless()
+        ? vk::ResultValue<uint32_t> { vk::Result::eSuccess, getInFlightIndex() }
+        : getDevice().acquireNextImageKHR(getSwapchain(), UINT64_MAX, imageAcquiredSemaphore, nullptr);
     
     bool shouldTryToRender = true;
     if (imageIndex.result == vk::Result::eSuboptimalKHR) {
         shouldTryToRender = false;
     } else vk::resultCheck(imageIndex.result, "Failed to acquire next image");
 
-    vk::CommandBuffer cmd = getDevice().allocateCommandBuffers(vk::CommandBufferAllocateInfo {}
-        .setCommandBufferCount(1)
-        .setCommandPool(getCommandPool(vkb::QueueType::graphics))
-        )[0];
+    // the frame's last submission has finished, so everything allocated from its pool can be recycled
+    FrameCommandPool& frameCommandPool = m_frameCommandPools[getInFlightIndex()];
+    frameCommandPool.reset();
+
+    // every submission that waited on these has finished, so they can be signalled again
+    auto& retiringSemaphores = m_retiringSemaphores[getInFlightIndex()];
+    m_freeSemaphores.insert(m_freeSemaphores.end(), retiringSemaphores.begin(), retiringSemaphores.end());
+    retiringSemaphores.clear();
+
+    for (auto& pool : m_workerCommandPools[getInFlightIndex()]) pool.reset();
+
+    m_uploadEngine.collect();
+
+    m_frameAllocator.beginFrame(getInFlightIndex());
+
+    updateMemoryBudgets();
+
+    vk::CommandBuffer cmd = frameCommandPool.allocate();
     
-    cmd.begin(vk::CommandBufferBeginInfo {});
+    cmd.begin(vk::CommandBufferBeginInfo {}.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    m_gpuProfiler.beginFrame(cmd, getInFlightIndex(), m_frameCount);
 
     if (shouldTryToRender) {
-        m_swapchainImages[imageIndex.value].transitionLayout()
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .execute(cmd);
-        
-        auto attachment = vk::RenderingAttachmentInfo {}
-            .setClearValue(vk::ClearValue {})
-            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setLoadOp(vk::AttachmentLoadOp::eClear);
-
-        auto emissiveAttachment = attachment.setImageView(m_gBuffer.emissiveImageView);
-
-        std::vector<vk::RenderingAttachmentInfo> gBufferAttachments {
-            attachment.setImageView(m_gBuffer.albedoImageView),
-            attachment.setImageView(m_gBuffer.normalImageView),
-            emissiveAttachment,
-            attachment.setImageView(m_gBuffer.aoMetalRoughImageView),
-        };
+        updateRenderScale();
 
-        auto colorAttachment = vk::RenderingAttachmentInfo { attachment }
-            .setImageView(m_swapchainImageViews[imageIndex.value]);
+        // only the scene targets follow the dock layout and render scale, the swapchain is left alone
+        gameViewRegion.extent = clampSceneExtent(gameViewRegion.extent);
+        vk::Extent2D sceneExtent = clampSceneExtent(vk::Extent2D {
+            static_cast<uint32_t>(gameViewRegion.extent.width * m_renderScale),
+            static_cast<uint32_t>(gameViewRegion.extent.height * m_renderScale),
+        });
 
-        auto depthAttachment = vk::RenderingAttachmentInfo {}
-            .setImageView(m_gBuffer.depthImageView)
-            .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-            .setClearValue(vk::ClearValue {}.setDepthStencil({ 1.0f }))
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
-            ;
-        
-        glm::ivec2 _windowSize;
-        glfwGetFramebufferSize(m_window, &_windowSize.x, &_windowSize.y);
-        glm::vec<2, uint32_t> windowSize = _windowSize;
-
-        cmd.setViewport(0, vk::Viewport {}
-            .setX(0).setY(0)
-            .setWidth(windowSize.x)
-            .setHeight(windowSize.y)
-            .setMinDepth(0).setMaxDepth(1));
-        
-        cmd.setScissor(0, vk::Rect2D {}
-            .setOffset({ 0, 0 })
-            .setExtent({ windowSize.x, windowSize.y }));
-
-        { // render GBuffer
-            m_gBuffer.depthImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-                .setDstStageMask(vk::PipelineStageFlagBits::eEarlyFragmentTests
-                               | vk::PipelineStageFlagBits::eLateFragmentTests)
-                .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
-                .execute(cmd);
-            m_gBuffer.albedoImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .execute(cmd);
-            m_gBuffer.normalImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .execute(cmd);
-            m_gBuffer.emissiveImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .execute(cmd);
-            m_gBuffer.aoMetalRoughImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
-                .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .execute(cmd);
-
-            cmd.beginRendering(vk::RenderingInfo {}
-                .setColorAttachments(gBufferAttachments)
-                .setPDepthAttachment(&depthAttachment)
-                .setLayerCount(1)
-                .setRenderArea({ { 0, 0 }, { windowSize.x, windowSize.y } }),
-                m_dispatchLoaderDynamic);
-            
-            recordGBufferCommands(cmd, gameViewRegion.extent);
-            
-            cmd.endRendering(m_dispatchLoaderDynamic);
-        }
+        if (sceneExtent != m_sceneExtent) sceneSizeChanged(sceneExtent);
 
-        { // render lighting to emissive
-            m_gBuffer.depthImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits::eEarlyFragmentTests
-                               | vk::PipelineStageFlagBits::eLateFragmentTests)
-                .setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
-                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-                .execute(cmd);
-            m_gBuffer.albedoImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-                .execute(cmd);
-            m_gBuffer.normalImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-                .execute(cmd);
-            m_gBuffer.aoMetalRoughImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-                .execute(cmd);
-            
-            cmd.beginRendering(vk::RenderingInfo {}
-                .setColorAttachments(emissiveAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad))
-                .setLayerCount(1)
-                .setRenderArea({ { 0, 0 }, { windowSize.x, windowSize.y } }),
-                m_dispatchLoaderDynamic);
-            
-            recordLightingCommands(cmd, gameViewRegion.extent);
-            
-            cmd.endRendering(m_dispatchLoaderDynamic);
-        }
+        m_gameViewRegion = gameViewRegion;
+        m_outputImageIndex = imageIndex.value;
 
-        recordPostProcessingCommands(cmd, gameViewRegion.extent);
-
-        cmd.setViewport(0, vk::Viewport {}
-            .setX(gameViewRegion.offset.x)
-            .setY(gameViewRegion.offset.y)
-            .setWidth(gameViewRegion.extent.width)
-            .setHeight(gameViewRegion.extent.height)
-            .setMinDepth(0).setMaxDepth(1));
-
-        { // render post processing
-            m_gBuffer.emissiveImage->transitionLayout()
-                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
-                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-                .execute(cmd);
-
-            cmd.beginRendering(vk::RenderingInfo {}
-                .setColorAttachments(colorAttachment)
-                .setLayerCount(1)
-                .setRenderArea({ { 0, 0 }, { windowSize.x, windowSize.y } }),
-                m_dispatchLoaderDynamic);
-            
-            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_postProcessingPipeline.pipeline);
-
-            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_postProcessingPipeline.layout,
-                0, getGBuffer().uniform.getSet(), {});
-            
-            cmd.draw(3, 1, 0, 0);
-            
-            cmd.endRendering(m_dispatchLoaderDynamic);
-        }
+        // swapchain images are acquired with a semaphore waited on at the color attachment output stage
+        m_renderGraph.setImage(m_outputImageHandle, m_outputImages[imageIndex.value],
+            isHeadless() ? vk::PipelineStageFlags2 {} : vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            true);
 
-        { // render engine GUI
-            cmd.beginRendering(vk::RenderingInfo {}
-                .setColorAttachments(colorAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad))
-                .setLayerCount(1)
-                .setRenderArea({ { 0, 0 }, { windowSize.x, windowSize.y } }),
-                m_dispatchLoaderDynamic);
-            
-            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
-            
-            cmd.endRendering(m_dispatchLoaderDynamic);
-        }
+        prepareFrame(gameViewRegion.extent);
+
+        m_gpuProfiler.beginScope(cmd, "Frame");
+        m_renderGraph.execute(cmd);
+        m_gpuProfiler.endScope(cmd);
+    } else {
+        m_outputImages[imageIndex.value].transitionLayout()
+            .setOldLayout(vk::ImageLayout::eUndefined)
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+            .execute(cmd);
     }
-    
-    m_swapchainImages[imageIndex.value].transitionLayout()
-        .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-        .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-        .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
-        .execute(cmd);
 
     cmd.end();
 
-    vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    std::vector<vk::Semaphore>          waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitDstStageMasks;
+    std::vector<vk::Semaphore>          signalSemaphores;
+
+    if (!isHeadless()) {
+        waitSemaphores.push_back(imageAcquiredSemaphore);
+        waitDstStageMasks.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+        signalSemaphores.push_back(renderingFinishedSemaphore);
+    }
+
+    // compute submitted before this point, either earlier this frame or after last frame's graphics work
+    for (auto& wait : m_pendingGraphicsWaits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitDstStageMasks.push_back(wait.stages);
+
+        retiringSemaphores.push_back(wait.semaphore);
+        if (wait.upstreamSemaphore) retiringSemaphores.push_back(wait.upstreamSemaphore);
+    }
+
+    m_pendingGraphicsWaits.clear();
+
+    // compute deferred until after graphics waits on a semaphore signalled by this submission
+    std::vector<vk::Semaphore> graphicsFinishedSemaphores;
+    for (auto& submission : m_deferredComputeSubmissions) {
+        graphicsFinishedSemaphores.push_back(acquireSemaphore());
+        signalSemaphores.push_back(graphicsFinishedSemaphores.back());
+    }
+
+    // uploads are acquired by their own graphics submission, which must come before any frame that uses them
+    m_uploadEngine.flush();
+
+    vk::resultCheck(m_frameAllocator.flush(), "Failed to flush the frame allocator");
 
-    getQueue(vkb::QueueType::graphics).submit(vk::SubmitInfo {}
+    // the frame timeline is signalled by the frame's last submission, so reaching it covers compute deferred until
+    // after graphics as well. A signal covers everything submitted before it on its queue, and that compute
+    // waits for this submission
+    uint64_t frameTimelineValue = getFrameTimelineValue();
+    bool signalTimelineFromGraphics = m_deferredComputeSubmissions.empty();
+    if (signalTimelineFromGraphics) signalSemaphores.push_back(m_frameTimeline);
+
+    // values for binary semaphores are ignored
+    std::vector<uint64_t> signalValues (signalSemaphores.size(), 0);
+    if (signalTimelineFromGraphics) signalValues.back() = frameTimelineValue;
+
+    auto timelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo {}
+        .setSignalSemaphoreValues(signalValues);
+
+    auto submitInfo = vk::SubmitInfo {}
+        .setPNext(&timelineSubmitInfo)
         .setCommandBuffers(cmd)
-        .setWaitDstStageMask(waitDstStageMask)
-        .setWaitSemaphores(imageAcquiredSemaphore)
-        .setSignalSemaphores(renderingFinishedSemaphore),
-        frameFinishedFence);
+        .setWaitSemaphores(waitSemaphores)
+        .setWaitDstStageMask(waitDstStageMasks)
+        .setSignalSemaphores(signalSemaphores);
+
+    {
+        auto queueLock = lockQueue(getQueue(vkb::QueueType::graphics));
+        getQueue(vkb::QueueType::graphics).submit(submitInfo);
+    }
+
+    m_inFlightTimelineValues[getInFlightIndex()] = frameTimelineValue;
+    m_frameTimelineValue = frameTimelineValue;
+
+    // anything retired by a repack from now on is deferred past this frame
+    geometryLock.unlock();
+    hostVisibleGeometryLock.unlock();
+
+    for (int i = 0; i < m_deferredComputeSubmissions.size(); i++) {
+        auto& submission = m_deferredComputeSubmissions[i];
+        vk::Semaphore computeFinishedSemaphore = acquireSemaphore();
+        vk::PipelineStageFlags computeWaitStages = vk::PipelineStageFlagBits::eAllCommands;
+
+        bool isLast = i == m_deferredComputeSubmissions.size() - 1;
+
+        std::array<vk::Semaphore, 2> computeSignalSemaphores { computeFinishedSemaphore, m_frameTimeline };
+        std::array<uint64_t, 2>      computeSignalValues     { 0, frameTimelineValue };
+
+        auto computeTimelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo {}
+            .setSignalSemaphoreValueCount(isLast ? 2 : 1)
+            .setPSignalSemaphoreValues(computeSignalValues.data());
+
+        m_computeOneTimeCmdPool.submit(submission.cmd, m_computeQueue, vk::SubmitInfo {}
+            .setPNext(&computeTimelineSubmitInfo)
+            .setWaitSemaphores(graphicsFinishedSemaphores[i])
+            .setWaitDstStageMask(computeWaitStages)
+            .setSignalSemaphoreCount(isLast ? 2 : 1)
+            .setPSignalSemaphores(computeSignalSemaphores.data()));
+
+        m_pendingGraphicsWaits.push_back({ computeFinishedSemaphore, submission.graphicsWaitStages, graphicsFinishedSemaphores[i] });
+    }
+
+    m_deferredComputeSubmissions.clear();
+
+    m_lastOutputImageIndex = imageIndex.value;
+    m_frameCount++;
+
+    m_frameCommandBufferStats = frameCommandPool.getStats();
+
+    for (auto& pool : m_workerCommandPools[getInFlightIndex()]) {
+        m_frameCommandBufferStats.allocations += pool.getStats().allocations;
+        m_frameCommandBufferStats.reuses += pool.getStats().reuses;
+    }
+
+    CommandBufferStats graphicsOneTimeStats = m_graphicsOneTimeCmdPool.collectStats();
+    CommandBufferStats presentOneTimeStats = m_presentOneTimeCmdPool.collectStats();
+    CommandBufferStats computeOneTimeStats = m_computeOneTimeCmdPool.collectStats();
+    CommandBufferStats transferOneTimeStats = m_transferOneTimeCmdPool.collectStats();
+    CommandBufferStats uploadStats = m_uploadEngine.collectCommandBufferStats();
+    m_oneTimeCommandBufferStats = {
+        .allocations = graphicsOneTimeStats.allocations + presentOneTimeStats.allocations
+                     + computeOneTimeStats.allocations + transferOneTimeStats.allocations + uploadStats.allocations,
+        .reuses = graphicsOneTimeStats.reuses + presentOneTimeStats.reuses
+                + computeOneTimeStats.reuses + transferOneTimeStats.reuses + uploadStats.reuses,
+    };
+
+    m_barrierStats = {
+        .barriers = m_barrierCount.exchange(0),
+        .calls = m_barrierCallCount.exchange(0),
+    };
+
+    if (isHeadless()) {
+        m_inFlightFrameIndex = (m_inFlightFrameIndex + 1) % s_framesInFlight;
+        return;
+    }
 
     vk::SwapchainKHR swapchain = getSwapchain();
-    vk::Result presentResult = getQueue(vkb::QueueType::present).presentKHR(vk::PresentInfoKHR {}
-        .setImageIndices(imageIndex.value)
-        .setSwapchains(swapchain)
-        .setWaitSemaphores(renderingFinishedSemaphore));
+    vk::Result presentResult;
+    {
+        auto queueLock = lockQueue(getQueue(vkb::QueueType::present));
+        presentResult = getQueue(vkb::QueueType::present).presentKHR(vk::PresentInfoKHR {}
+            .setImageIndices(imageIndex.value)
+            .setSwapchains(swapchain)
+            .setWaitSemaphores(renderingFinishedSemaphore));
+    }
 
     if (presentResult == vk::Result::eSuboptimalKHR || presentResult == vk::Result::eErrorOutOfDateKHR) {
         windowSizeChanged();
     }
     else vk::resultCheck(presentResult, "Failed to present render result");
 
+    recordInputLatency(frameTimelineValue);
+
     if (imageIndex.result == vk::Result::eSuboptimalKHR) return;
 
     m_inFlightFrameIndex = (m_inFlightFrameIndex + 1) % s_framesInFlight;
 }
 
-void IEngine::windowSizeChanged() {
-    getDevice().waitIdle();
+void IEngine::setRenderScale(float scale) {
+    m_renderScale = glm::clamp(scale, s_minRenderScale, 1.0f);
+}
 
-    auto& scope = getUntilWindowSizeChangeScope();
-    scope.executeDeferredCleanupFunctions();
+void IEngine::updateRenderScale() {
+    if (!m_autoRenderScale || !m_gpuProfiler.isSupported()) return;
 
-    m_swapchain = getValue(vkb::SwapchainBuilder {
-            getPhysicalDevice(),
-            getDevice(),
-            getSurface(),
-            m_graphicsQueueIndex,
-            m_presentQueueIndex
+    // each resolved frame is only sampled once
+    const GPUProfiler::Frame& latest = m_gpuProfiler.getLatestFrame();
+    if (latest.frameNumber == m_lastRenderScaleGPUFrame) return;
+    m_lastRenderScaleGPUFrame = latest.frameNumber;
+
+    // frames recorded before the last change were rendered at the old scale
+    if (latest.frameNumber < m_lastRenderScaleFrame) return;
+
+    double frameTime = m_gpuProfiler.getTime("Frame");
+    if (frameTime <= 0.0) return;
+
+    m_smoothedGPUFrameTime = m_smoothedGPUFrameTime > 0.0 ? glm::mix(m_smoothedGPUFrameTime, frameTime, 0.1) : frameTime;
+
+    if (m_frameCount < m_lastRenderScaleFrame + s_renderScaleSettleFrames) return;
+
+    // within 10% of the target is close enough, so the scale does not oscillate around it
+    double ratio = m_targetFrameTime / m_smoothedGPUFrameTime;
+    if (glm::abs(1.0 - ratio) < 0.1) return;
+
+    // shading cost is roughly proportional to the pixel count, so to the square of the scale.
+    // Steps are limited and rounded to 5% so the scene targets are not recreated for tiny changes
+    float scale = m_renderScale * static_cast<float>(glm::sqrt(ratio));
+    scale = glm::clamp(scale, m_renderScale - 0.1f, m_renderScale + 0.1f);
+    scale = glm::clamp(glm::round(scale * 20.0f) / 20.0f, s_minRenderScale, 1.0f);
+
+    if (scale == m_renderScale) return;
+
+    m_renderScale = scale;
+    m_lastRenderScaleFrame = m_frameCount;
+    m_smoothedGPUFrameTime = 0.0;
+}
+
+void IEngine::updateMemoryBudgets() {
+    // lets VMA refresh the budgets it caches from VK_EXT_memory_budget
+    vmaSetCurrentFrameIndex(getAllocator(), static_cast<uint32_t>(m_frameCount));
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(getAllocator(), &memoryProperties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(getAllocator(), budgets.data());
+
+    m_memoryBudgets.resize(memoryProperties->memoryHeapCount);
+    m_memoryBudgetWarnings.resize(memoryProperties->memoryHeapCount, false);
+
+    for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; heap++) {
+        MemoryHeapBudget& budget = m_memoryBudgets[heap];
+        budget.flags = vk::MemoryHeapFlags { memoryProperties->memoryHeaps[heap].flags };
+        budget.size = memoryProperties->memoryHeaps[heap].size;
+        budget.usage = budgets[heap].usage;
+        budget.budget = budgets[heap].budget;
+        budget.blockBytes = budgets[heap].statistics.blockBytes;
+        budget.allocationBytes = budgets[heap].statistics.allocationBytes;
+        budget.blockCount = budgets[heap].statistics.blockCount;
+        budget.allocationCount = budgets[heap].statistics.allocationCount;
+
+        // only warn again once usage has dropped back below the threshold
+        bool overThreshold = budget.budget > 0 && budget.usage > budget.budget * s_memoryBudgetWarningFraction;
+        if (overThreshold && !m_memoryBudgetWarnings[heap]) {
+            IGNIS_LOG("Engine", Warning, "Memory heap " << heap << " is using " << budget.usage / (1024 * 1024)
+                << "MiB of its " << budget.budget / (1024 * 1024) << "MiB budget");
+            onMemoryBudgetWarning(heap, budget);
         }
-        .build(), "Failed to create a swapchain");
+
+        m_memoryBudgetWarnings[heap] = overThreshold;
+    }
+}
+
+float IEngine::getMemoryBudgetPressure() const {
+    float pressure = 0.0f;
+
+    for (auto& budget : m_memoryBudgets)
+        if (budget.budget > 0) pressure = std::max(pressure, static_cast<float>(budget.usage) / budget.budget);
+
+    return pressure;
+}
+
+void IEngine::beginOutputRendering(vk::CommandBuffer cmd, vk::AttachmentLoadOp loadOp) {
+    auto colorAttachment = vk::RenderingAttachmentInfo {}
+        .setImageView(m_outputImageViews[m_outputImageIndex])
+        .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setClearValue(vk::ClearValue {})
+        .setStoreOp(vk::AttachmentStoreOp::eStore)
+        .setLoadOp(loadOp);
+
+    cmd.beginRendering(vk::RenderingInfo {}
+        .setColorAttachments(colorAttachment)
+        .setLayerCount(1)
+        .setRenderArea({ { 0, 0 }, m_outputExtent }),
+        m_dispatchLoaderDynamic);
+}
+
+void IEngine::recordGBufferPass(vk::CommandBuffer cmd) {
+    auto attachment = vk::RenderingAttachmentInfo {}
+        .setClearValue(vk::ClearValue {})
+        .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setStoreOp(vk::AttachmentStoreOp::eStore)
+        .setLoadOp(vk::AttachmentLoadOp::eClear);
+
+    std::vector<vk::RenderingAttachmentInfo> gBufferAttachments {
+        attachment.setImageView(m_gBuffer.albedoImageView),
+        attachment.setImageView(m_gBuffer.normalImageView),
+        attachment.setImageView(m_gBuffer.emissiveImageView),
+        attachment.setImageView(m_gBuffer.aoMetalRoughImageView),
+    };
+
+    auto depthAttachment = vk::RenderingAttachmentInfo {}
+        .setImageView(m_gBuffer.depthImageView)
+        .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        .setClearValue(vk::ClearValue {}.setDepthStencil({ 1.0f }))
+        .setStoreOp(vk::AttachmentStoreOp::eStore)
+        .setLoadOp(vk::AttachmentLoadOp::eClear)
+        ;
+
+    auto viewport = vk::Viewport {}
+        .setX(0).setY(0)
+        .setWidth(m_sceneExtent.width)
+        .setHeight(m_sceneExtent.height)
+        .setMinDepth(0).setMaxDepth(1);
+
+    auto scissor = vk::Rect2D {}
+        .setOffset({ 0, 0 })
+        .setExtent(m_sceneExtent);
+
+    cmd.setViewport(0, viewport);
+    cmd.setScissor(0, scissor);
+
+    uint32_t chunkCount = getGBufferChunkCount();
+
+    cmd.beginRendering(vk::RenderingInfo {}
+        .setFlags(chunkCount > 0 ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags {})
+        .setColorAttachments(gBufferAttachments)
+        .setPDepthAttachment(&depthAttachment)
+        .setLayerCount(1)
+        .setRenderArea({ { 0, 0 }, m_sceneExtent }),
+        m_dispatchLoaderDynamic);
     
-    scope.addDeferredCleanupFunction([swapchain = m_swapchain]() {
-        vkb::destroy_swapchain(swapchain);
-    });
+    if (chunkCount > 0) {
+        SecondaryRenderingInfo renderingInfo {
+            .colorAttachmentFormats = {
+                m_gBuffer.albedoImage->getFormat(),
+                m_gBuffer.normalImage->getFormat(),
+                m_gBuffer.emissiveImage->getFormat(),
+                m_gBuffer.aoMetalRoughImage->getFormat(),
+            },
+            .depthAttachmentFormat = m_gBuffer.depthImage->getFormat(),
+            .viewport = viewport,
+            .scissor = scissor,
+        };
 
-    glm::vec<2, uint32_t> size { m_swapchain.extent.width, m_swapchain.extent.height };
+        recordSecondaryChunks(cmd, renderingInfo, chunkCount, [&](vk::CommandBuffer secondary, uint32_t chunkIndex) {
+            recordGBufferChunk(secondary, m_gameViewRegion.extent, chunkIndex, chunkCount);
+        });
+    } else recordGBufferCommands(cmd, m_gameViewRegion.extent);
+    
+    cmd.endRendering(m_dispatchLoaderDynamic);
+}
 
-    auto swapchainImages = getValue(m_swapchain.get_images(), "Failed to get swapchain images");
-    auto swapchainImageViews = getValue(m_swapchain.get_image_views(), "Failed to get swapchain image views");
+void IEngine::recordLightingPass(vk::CommandBuffer cmd) {
+    auto emissiveAttachment = vk::RenderingAttachmentInfo {}
+        .setImageView(m_gBuffer.emissiveImageView)
+        .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setStoreOp(vk::AttachmentStoreOp::eStore)
+        .setLoadOp(vk::AttachmentLoadOp::eLoad);
+
+    uint32_t chunkCount = getLightingChunkCount();
+
+    cmd.beginRendering(vk::RenderingInfo {}
+        .setFlags(chunkCount > 0 ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags {})
+        .setColorAttachments(emissiveAttachment)
+        .setLayerCount(1)
+        .setRenderArea({ { 0, 0 }, m_sceneExtent }),
+        m_dispatchLoaderDynamic);
+    
+    if (chunkCount > 0) {
+        SecondaryRenderingInfo renderingInfo {
+            .colorAttachmentFormats = { m_gBuffer.emissiveImage->getFormat() },
+            .viewport = vk::Viewport { 0, 0,
+                static_cast<float>(m_sceneExtent.width), static_cast<float>(m_sceneExtent.height), 0, 1 },
+            .scissor = vk::Rect2D { { 0, 0 }, m_sceneExtent },
+        };
 
-    for (int i = 0; i < m_swapchain.image_count; i++) {
-        m_swapchainImages.push_back(Image {
-            vk::Image { swapchainImages[i] },
-            static_cast<vk::Format>(m_swapchain.image_format),
-            { size.x, size.y, 1 },
-            vk::ImageAspectFlagBits::eColor
+        recordSecondaryChunks(cmd, renderingInfo, chunkCount, [&](vk::CommandBuffer secondary, uint32_t chunkIndex) {
+            recordLightingChunk(secondary, m_gameViewRegion.extent, chunkIndex, chunkCount);
         });
-        m_swapchainImageViews.push_back(swapchainImageViews[i]);
-    }
+    } else recordLightingCommands(cmd, m_gameViewRegion.extent);
+    
+    cmd.endRendering(m_dispatchLoaderDynamic);
+}
 
-    scope.addDeferredCleanupFunction([&, device = getDevice()]() {
-        for (auto& imageView : m_swapchainImageViews) device.destroyImageView(imageView);
-        m_swapchainImageViews.clear();
-        m_swapchainImages.clear();
-    });
+void IEngine::recordTonemapPass(vk::CommandBuffer cmd) {
+    cmd.setViewport(0, vk::Viewport {}
+        .setX(m_gameViewRegion.offset.x)
+        .setY(m_gameViewRegion.offset.y)
+        .setWidth(m_gameViewRegion.extent.width)
+        .setHeight(m_gameViewRegion.extent.height)
+        .setMinDepth(0).setMaxDepth(1));
 
-    {   // setup gBuffer images
-        auto imageBuilder = ImageBuilder { scope }
-            .setSize(size)
-            .setUsage(vk::ImageUsageFlagBits::eSampled);
-        
-        m_gBuffer.depthImage = ImageBuilder { imageBuilder }
-            .setFormat(vk::Format::eD32Sfloat)
-            .addUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment)
-            .setAspectMask(vk::ImageAspectFlagBits::eDepth)
-            .setInitialLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-            .build();
-        
-        imageBuilder
-            .addUsage(vk::ImageUsageFlagBits::eColorAttachment)
-            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-            .setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal);
-        
-        m_gBuffer.albedoImage = ImageBuilder { imageBuilder }
-            .setFormat(vk::Format::eR8G8B8A8Srgb)
-            .build();
-        
-        m_gBuffer.normalImage = ImageBuilder { imageBuilder }
-            .setFormat(vk::Format::eR8G8B8A8Snorm)
-            .build();
-        
-        m_gBuffer.emissiveImage = ImageBuilder { imageBuilder }
-            .setFormat(vk::Format::eR16G16B16A16Sfloat)
-            .build();
-        
-        m_gBuffer.aoMetalRoughImage = ImageBuilder { imageBuilder }
-            .setFormat(vk::Format::eR8G8B8A8Unorm)
-            .build();
-    }
+    beginOutputRendering(cmd, vk::AttachmentLoadOp::eClear);
+    
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_postProcessingPipeline.pipeline);
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_postProcessingPipeline.layout,
+        0, getGBuffer().uniform.getSet(), {});
+    
+    cmd.draw(3, 1, 0, 0);
+    
+    cmd.endRendering(m_dispatchLoaderDynamic);
+}
+
+void IEngine::recordGUIPass(vk::CommandBuffer cmd) {
+    beginOutputRendering(cmd, vk::AttachmentLoadOp::eLoad);
+    
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+    
+    cmd.endRendering(m_dispatchLoaderDynamic);
+}
+
+void IEngine::addPostProcessingPasses(RenderGraph& graph) {
+    // without knowing what the application records, assume it renders into the lit image, as it did before lighting
+    // was declared as a pass. Anything which samples the lit image needs its own passes and targets instead
+    graph.addPass("Post processing")
+        .write(m_gBuffer.handles.emissive)
+        .setRecordFunction([&](vk::CommandBuffer cmd) {
+            recordPostProcessingCommands(cmd, m_gameViewRegion.extent);
+        });
+}
+
+void IEngine::buildRenderGraph(ResourceScope& scope) {
+    using Usage = RenderGraph::Usage;
+
+    m_renderGraph = RenderGraph {};
+
+    // albedo, normal and AO, metal, rough are dead after lighting, so their memory is reused by later passes
+    auto gBufferInfo = RenderGraph::TransientImageInfo {
+        .extent = m_sceneExtent,
+        .usage  = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+    };
+
+    auto depthInfo = RenderGraph::TransientImageInfo {
+        .format     = GBuffer::s_depthFormat,
+        .extent     = m_sceneExtent,
+        .usage      = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+        .aspectMask = vk::ImageAspectFlagBits::eDepth,
+    };
+
+    GBuffer::Handles& handles = m_gBuffer.handles;
+    handles.depth        = m_renderGraph.addTransientImage("Depth", depthInfo);
+    gBufferInfo.format   = GBuffer::s_albedoFormat;
+    handles.albedo       = m_renderGraph.addTransientImage("Albedo", gBufferInfo);
+    gBufferInfo.format   = GBuffer::s_normalFormat;
+    handles.normal       = m_renderGraph.addTransientImage("Normal", gBufferInfo);
+    gBufferInfo.format   = GBuffer::s_emissiveFormat;
+    handles.emissive     = m_renderGraph.addTransientImage("Emissive", gBufferInfo);
+    gBufferInfo.format   = GBuffer::s_aoMetalRoughFormat;
+    handles.aoMetalRough = m_renderGraph.addTransientImage("AO, metal, rough", gBufferInfo);
+
+    // rebound to the current swapchain or offscreen image every frame
+    m_outputImageHandle = m_renderGraph.importImage("Output", m_outputImages[0]);
+
+    m_renderGraph.addPass("G-buffer")
+        .write(handles.depth, Usage::DepthAttachment)
+        .write(handles.albedo)
+        .write(handles.normal)
+        .write(handles.emissive)
+        .write(handles.aoMetalRough)
+        .setRecordFunction([&](vk::CommandBuffer cmd) { recordGBufferPass(cmd); });
+
+    m_renderGraph.addPass("Lighting")
+        .read(handles.depth)
+        .read(handles.albedo)
+        .read(handles.normal)
+        .read(handles.aoMetalRough)
+        .write(handles.emissive)
+        .setRecordFunction([&](vk::CommandBuffer cmd) { recordLightingPass(cmd); });
+
+    addPostProcessingPasses(m_renderGraph);
+
+    m_renderGraph.addPass("Tonemap")
+        .read(handles.emissive)
+        .write(m_outputImageHandle)
+        .setRecordFunction([&](vk::CommandBuffer cmd) { recordTonemapPass(cmd); });
+
+    m_renderGraph.addPass("GUI")
+        .write(m_outputImageHandle)
+        .setRecordFunction([&](vk::CommandBuffer cmd) { recordGUIPass(cmd); });
+
+    m_renderGraph.markOutput(m_outputImageHandle, isHeadless() ? Usage::TransferSrc : Usage::Present);
+
+    m_renderGraph.compile(scope);
+}
+
+void IEngine::windowSizeChanged() {
+    // frames still in flight may be using the old resources, so they are freed once those frames have finished
+    auto& scope = getUntilWindowSizeChangeScope();
+    scope.retire();
+
+    if (isHeadless()) setupOffscreenOutput(scope);
+    else              setupSwapchain(scope);
+
+    onWindowSizeChanged({ m_outputExtent.width, m_outputExtent.height });
+
+    // the render graph imports the output images, so it is rebuilt along with the scene targets.
+    // Until the first frame reports its game view region, the scene covers the whole output
+    vk::Extent2D sceneExtent = m_sceneExtent.width > 0 && m_sceneExtent.height > 0 ? m_sceneExtent : m_outputExtent;
+    sceneSizeChanged(clampSceneExtent(sceneExtent));
+}
+
+vk::Extent2D IEngine::clampSceneExtent(vk::Extent2D extent) const {
+    // the central dock node can be empty, or overhang the output after scaling by the DPI
+    return vk::Extent2D {
+        glm::clamp<uint32_t>(extent.width, 1, glm::max<uint32_t>(1, m_outputExtent.width)),
+        glm::clamp<uint32_t>(extent.height, 1, glm::max<uint32_t>(1, m_outputExtent.height)),
+    };
+}
+
+void IEngine::sceneSizeChanged(vk::Extent2D extent) {
+    // retired on the frame timeline like the window size change scope, so resizing never waits for the device
+    auto& scope = getUntilSceneSizeChangeScope();
+    scope.retire();
+
+    m_sceneExtent = extent;
+
+    glm::vec<2, uint32_t> size { m_sceneExtent.width, m_sceneExtent.height };
+
+    // declares the G-buffer as transient images and allocates them, so it comes before anything that uses them
+    buildRenderGraph(scope);
+
+    m_gBuffer.depthImage        = &m_renderGraph.getImage(m_gBuffer.handles.depth);
+    m_gBuffer.albedoImage       = &m_renderGraph.getImage(m_gBuffer.handles.albedo);
+    m_gBuffer.normalImage       = &m_renderGraph.getImage(m_gBuffer.handles.normal);
+    m_gBuffer.emissiveImage     = &m_renderGraph.getImage(m_gBuffer.handles.emissive);
+    m_gBuffer.aoMetalRoughImage = &m_renderGraph.getImage(m_gBuffer.handles.aoMetalRough);
 
     {   // setup gBuffer image views
         m_gBuffer.depthImageView = ImageViewBuilder { *m_gBuffer.depthImage, scope }.build();
@@ -629,9 +1187,15 @@ void IEngine::windowSizeChanged() {
             .build();
 
         vk::Sampler sampler = getDevice().createSampler(vk::SamplerCreateInfo {});
-        scope.addDeferredCleanupFunction([device = getDevice(), sampler]() {
-            device.destroySampler(sampler);
-        });
+        scope.addDeferredDestroy(getDevice(), sampler);
+
+        // the lit image is upscaled to the game view region by a bicubic filter built from bilinear taps
+        vk::Sampler upscaleSampler = getDevice().createSampler(vk::SamplerCreateInfo {}
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge));
+        scope.addDeferredDestroy(getDevice(), upscaleSampler);
 
         auto imageInfo = vk::DescriptorImageInfo {}
             .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
@@ -641,8 +1205,8 @@ void IEngine::windowSizeChanged() {
             imageInfo.setImageView(m_gBuffer.depthImageView),
             imageInfo.setImageView(m_gBuffer.albedoImageView),
             imageInfo.setImageView(m_gBuffer.normalImageView),
-            imageInfo.setImageView(m_gBuffer.emissiveImageView),
-            imageInfo.setImageView(m_gBuffer.aoMetalRoughImageView),
+            imageInfo.setImageView(m_gBuffer.emissiveImageView).setSampler(upscaleSampler),
+            imageInfo.setImageView(m_gBuffer.aoMetalRoughImageView).setSampler(sampler),
         };
 
         auto descSetWrite = vk::WriteDescriptorSet {}
@@ -659,21 +1223,144 @@ void IEngine::windowSizeChanged() {
         }, {});
     }
 
-    onWindowSizeChanged(size);
+    onSceneSizeChanged(size);
+}
+
+void IEngine::setupSwapchain(ResourceScope& scope) {
+    // the old swapchain is retired rather than destroyed, it is freed along with the rest of its scope
+    m_swapchain = getValue(vkb::SwapchainBuilder {
+            getPhysicalDevice(),
+            getDevice(),
+            getSurface(),
+            m_graphicsQueueIndex,
+            m_presentQueueIndex
+        }
+        .set_old_swapchain(m_swapchain)
+        .set_desired_present_mode(static_cast<VkPresentModeKHR>(m_requestedPresentMode))
+        .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+        .build(), "Failed to create a swapchain");
+
+    m_presentMode = static_cast<vk::PresentModeKHR>(m_swapchain.present_mode);
+
+    // don't keep trying to recreate the swapchain for a mode it doesn't support
+    if (m_presentMode != m_requestedPresentMode) {
+        IGNIS_LOG("Engine", Warning, "Present mode " << vk::to_string(m_requestedPresentMode)
+            << " is not supported, using " << vk::to_string(m_presentMode));
+        m_requestedPresentMode = m_presentMode;
+    }
+    
+    scope.addDeferredCleanupFunction([swapchain = m_swapchain]() {
+        vkb::destroy_swapchain(swapchain);
+    });
+
+    m_outputExtent = m_swapchain.extent;
+    m_outputFormat = static_cast<vk::Format>(m_swapchain.image_format);
+
+    auto swapchainImages = getValue(m_swapchain.get_images(), "Failed to get swapchain images");
+    auto swapchainImageViews = getValue(m_swapchain.get_image_views(), "Failed to get swapchain image views");
+
+    m_outputImages.clear();
+    m_outputImageViews.clear();
+
+    for (int i = 0; i < m_swapchain.image_count; i++) {
+        m_outputImages.push_back(Image {
+            vk::Image { swapchainImages[i] },
+            m_outputFormat,
+            { m_outputExtent.width, m_outputExtent.height, 1 },
+            vk::ImageAspectFlagBits::eColor
+        });
+        m_outputImageViews.push_back(swapchainImageViews[i]);
+    }
+
+    scope.addDeferredCleanupFunction([device = getDevice(), imageViews = m_outputImageViews]() {
+        for (auto& imageView : imageViews) device.destroyImageView(imageView);
+    });
+}
+
+void IEngine::setupOffscreenOutput(ResourceScope& scope) {
+    glm::ivec2 size = getInitialWindowSize();
+
+    m_outputExtent = vk::Extent2D { static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y) };
+    m_outputFormat = vk::Format::eR8G8B8A8Srgb;
+
+    // the images and views themselves are owned by the scope
+    m_outputImages.clear();
+    m_outputImageViews.clear();
+
+    for (int i = 0; i < s_framesInFlight; i++) {
+        Allocated<Image> image = ImageBuilder { scope }
+            .setSize(glm::uvec2 { m_outputExtent.width, m_outputExtent.height })
+            .setFormat(m_outputFormat)
+            .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+            .build();
+
+        m_outputImageViews.push_back(ImageViewBuilder { *image, scope }.build());
+        m_outputImages.push_back(std::move(*image));
+    }
+}
+
+bool IEngine::captureOutputImage(const std::string& filename) {
+    if (!isHeadless() || m_frameCount == 0) return false;
+
+    Image& image = m_outputImages[m_lastOutputImageIndex];
+    vk::Extent3D extent = image.getExtent();
+
+    waitForTimelineValue(m_frameTimelineValue);
+
+    ResourceScope tempScope { "IEngine::captureOutputImage" };
+
+    Allocated<vk::Buffer> readbackBuffer = getValue(BufferBuilder { tempScope }
+        .setAllocationUsage(VMA_MEMORY_USAGE_GPU_TO_CPU)
+        .setBufferUsage(vk::BufferUsageFlagBits::eTransferDst)
+        .setSize(extent.width * extent.height * 4)
+        .build(), "Failed to create output image readback buffer");
+
+    getUploadEngine().recordGraphicsCommands([&](vk::CommandBuffer cmd) {
+        cmd.copyImageToBuffer(image.getImage(), vk::ImageLayout::eTransferSrcOptimal, *readbackBuffer,
+            vk::BufferImageCopy {}
+                .setImageExtent(extent)
+                .setImageSubresource(vk::ImageSubresourceLayers {}
+                    .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                    .setLayerCount(1)));
+    }).wait();
+
+    vk::ResultValue<void*> mapping = readbackBuffer.map();
+    if (mapping.result != vk::Result::eSuccess) return false;
+
+    vmaInvalidateAllocation(getAllocator(), readbackBuffer.m_allocation, 0, VK_WHOLE_SIZE);
+    bool success = stbi_write_png(filename.c_str(), extent.width, extent.height, 4, mapping.value, extent.width * 4) != 0;
+    readbackBuffer.unmap();
+
+    if (success) { IGNIS_LOG("Engine", Info, "Captured output image to " << filename); }
+    else         { IGNIS_LOG("Engine", Error, "Failed to write output image to " << filename); }
+
+    return success;
 }
 
 vk::Queue IEngine::getQueue(vkb::QueueType queueType) const {
     switch (queueType) {
     case vkb::QueueType::graphics: return m_graphicsQueue;
     case vkb::QueueType::present: return m_presentQueue;
+    case vkb::QueueType::compute: return m_computeQueue;
+    case vkb::QueueType::transfer: return m_transferQueue;
     default: throw std::runtime_error("Requested queue type does not exist");
     }
 }
 
+std::unique_lock<std::mutex> IEngine::lockQueue(vk::Queue queue) {
+    std::array<vk::Queue, 4> queues { m_graphicsQueue, m_presentQueue, m_computeQueue, m_transferQueue };
+    size_t index = std::find(queues.begin(), queues.end(), queue) - queues.begin();
+    assert(index < queues.size());
+
+    return std::unique_lock<std::mutex> { m_queueMutexes[index] };
+}
+
 uint32_t IEngine::getQueueIndex(vkb::QueueType queueType) const {
     switch (queueType) {
     case vkb::QueueType::graphics: return m_graphicsQueueIndex;
     case vkb::QueueType::present: return m_presentQueueIndex;
+    case vkb::QueueType::compute: return m_computeQueueIndex;
+    case vkb::QueueType::transfer: return m_transferQueueIndex;
     default: throw std::runtime_error("Requested queue type does not exist");
     }
 }
@@ -682,6 +1369,18 @@ vk::CommandPool IEngine::getCommandPool(vkb::QueueType queueType) const {
     switch (queueType) {
     case vkb::QueueType::graphics: return m_graphicsCmdPool;
     case vkb::QueueType::present: return m_presentCmdPool;
+    case vkb::QueueType::compute: return m_computeCmdPool;
+    case vkb::QueueType::transfer: return m_transferCmdPool;
+    default: throw std::runtime_error("Requested queue type does not exist");
+    }
+}
+
+OneTimeCommandPool& IEngine::getOneTimeCommandPool(vkb::QueueType queueType) {
+    switch (queueType) {
+    case vkb::QueueType::graphics: return m_graphicsOneTimeCmdPool;
+    case vkb::QueueType::present: return m_presentOneTimeCmdPool;
+    case vkb::QueueType::compute: return m_computeOneTimeCmdPool;
+    case vkb::QueueType::transfer: return m_transferOneTimeCmdPool;
     default: throw std::runtime_error("Requested queue type does not exist");
     }
 }
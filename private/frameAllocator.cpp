@@ -0,0 +1,79 @@
+#include "frameAllocator.hpp"
+#include "engine.hpp"
+#include "bufferBuilder.hpp"
+#include "common.hpp"
+
+namespace ignis {
+
+void FrameAllocator::setup(ResourceScope& scope, uint32_t frameCount, vk::DeviceSize frameSize) {
+    IEngine& engine = IEngine::get();
+
+    vk::PhysicalDeviceLimits limits = engine.getPhysicalDevice().getProperties().limits;
+    m_uniformAlignment = limits.minUniformBufferOffsetAlignment;
+    m_storageAlignment = limits.minStorageBufferOffsetAlignment;
+
+    // keep every frame's region aligned for any use
+    vk::DeviceSize regionAlignment = std::max({ m_uniformAlignment, m_storageAlignment, vk::DeviceSize { 256 } });
+    m_frameSize = (frameSize + regionAlignment - 1) & ~(regionAlignment - 1);
+
+    m_buffer = getValue(BufferBuilder { scope }
+        .addQueueFamilyIndices({ engine.getQueueIndex(vkb::QueueType::graphics) })
+        .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+        .setBufferUsage(vk::BufferUsageFlagBits::eVertexBuffer
+                      | vk::BufferUsageFlagBits::eIndexBuffer
+                      | vk::BufferUsageFlagBits::eUniformBuffer
+                      | vk::BufferUsageFlagBits::eStorageBuffer
+                      | vk::BufferUsageFlagBits::eIndirectBuffer)
+        .setSize(m_frameSize * frameCount)
+        .build(), "Failed to create the frame allocator's buffer");
+
+    // mapped for the buffer's whole lifetime, and unmapped before the buffer is destroyed
+    p_mapped = static_cast<uint8_t*>(getValue(m_buffer.map(), "Failed to map the frame allocator's buffer"));
+    scope.addDeferredCleanupFunction([buffer = m_buffer]() mutable {
+        buffer.unmap();
+    });
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex) {
+    m_highWaterMark = std::max(m_highWaterMark, getUsed());
+
+    m_frameIndex = frameIndex;
+    m_head = 0;
+}
+
+vk::Result FrameAllocator::flush() {
+    vk::DeviceSize used = getUsed();
+    if (used == 0) return vk::Result::eSuccess;
+
+    // a no-op for host coherent memory
+    return vk::Result { vmaFlushAllocation(IEngine::get().getAllocator(), m_buffer.m_allocation, m_frameSize * m_frameIndex, used) };
+}
+
+FrameAllocation FrameAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    vk::DeviceSize head = m_head.load(std::memory_order_relaxed);
+    vk::DeviceSize offset;
+
+    do {
+        offset = (head + alignment - 1) & ~(alignment - 1);
+
+        if (offset + size > m_frameSize) {
+            if (!m_overflowLogged.exchange(true))
+                IGNIS_LOG("Frame Allocator", Error, "Frame allocator is full, " << m_frameSize << " bytes per frame is not enough");
+
+            return {};
+        }
+    } while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    vk::DeviceSize bufferOffset = m_frameSize * m_frameIndex + offset;
+
+    return FrameAllocation {
+        .buffer = *m_buffer,
+        .offset = bufferOffset,
+        .size = size,
+        .cpuPtr = p_mapped + bufferOffset,
+    };
+}
+
+}
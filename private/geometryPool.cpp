@@ -0,0 +1,337 @@
+#include "geometryPool.hpp"
+#include "engine.hpp"
+#include "bufferBuilder.hpp"
+
+namespace ignis {
+
+// uploads are also read by compaction's copies, so they are made visible to both
+static constexpr vk::PipelineStageFlags s_geometryStages = vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eTransfer;
+
+const char* GeometryPool::getPlacementName(Placement placement) {
+    switch (placement) {
+    case DeviceLocal: return "device local";
+    case HostVisible: return "host visible";
+    }
+
+    return "unknown";
+}
+
+void GeometryPool::setup(ResourceScope& scope, uint32_t vertexCapacity, uint32_t indexCapacity, Placement placement) {
+    m_placement = placement;
+
+    vk::resultCheck(createBuffers(m_buffers, vertexCapacity, indexCapacity), "Failed to create the geometry pool's buffers");
+    logPlacement(m_buffers);
+
+    m_vertexAllocator = RangeAllocator { vertexCapacity };
+    m_indexAllocator = RangeAllocator { indexCapacity };
+
+    // allocations may still be freed afterwards, by deferred deletions, so only the buffers go
+    scope.addDeferredCleanupFunction([&]() {
+        m_buffers.scope = nullptr;
+    });
+}
+
+vk::Result GeometryPool::createBuffers(Buffers& buffers, uint32_t vertexCapacity, uint32_t indexCapacity) {
+    buffers.scope = std::make_unique<ResourceScope>(m_placement == HostVisible ? "Host visible geometry pool" : "Geometry pool");
+
+    // CPU_TO_GPU still prefers device local memory where it is also host visible, e.g. integrated GPUs or resizable BAR
+    VmaMemoryUsage           memoryUsage = m_placement == HostVisible ? VMA_MEMORY_USAGE_CPU_TO_GPU : VMA_MEMORY_USAGE_GPU_ONLY;
+    VmaAllocationCreateFlags allocationFlags = m_placement == HostVisible ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+    for (uint32_t stream = 0; stream < StreamCount; stream++) {
+        auto bufferResult = BufferBuilder { *buffers.scope }
+            .setBufferUsage(vk::BufferUsageFlagBits::eVertexBuffer
+                          | vk::BufferUsageFlagBits::eTransferDst
+                          | vk::BufferUsageFlagBits::eTransferSrc)
+            .setAllocationUsage(memoryUsage)
+            .setAllocationFlags(allocationFlags)
+            .setSize(vertexCapacity * s_streamStrides[stream])
+            .build();
+
+        if (bufferResult.result != vk::Result::eSuccess) return bufferResult.result;
+        buffers.vertexBuffers[stream] = bufferResult.value;
+        buffers.vertexPtrs[stream] = static_cast<uint8_t*>(buffers.vertexBuffers[stream].getInfo().pMappedData);
+    }
+
+    auto bufferResult = BufferBuilder { *buffers.scope }
+        .setBufferUsage(vk::BufferUsageFlagBits::eIndexBuffer
+                      | vk::BufferUsageFlagBits::eTransferDst
+                      | vk::BufferUsageFlagBits::eTransferSrc)
+        .setAllocationUsage(memoryUsage)
+        .setAllocationFlags(allocationFlags)
+        .setSize(indexCapacity * sizeof(uint32_t))
+        .build();
+
+    if (bufferResult.result != vk::Result::eSuccess) return bufferResult.result;
+    buffers.indexBuffer = bufferResult.value;
+    buffers.indexPtr = static_cast<uint8_t*>(buffers.indexBuffer.getInfo().pMappedData);
+
+    return vk::Result::eSuccess;
+}
+
+void GeometryPool::logPlacement(Buffers& buffers) {
+    static constexpr std::array<const char*, StreamCount> s_streamNames { "Position", "Texcoord", "Normal", "Tangent" };
+
+    for (uint32_t stream = 0; stream < StreamCount; stream++)
+        IGNIS_LOG("Geometry Pool", Info, "Placed " << getPlacementName(m_placement) << " " << s_streamNames[stream]
+            << " buffer in " << vk::to_string(buffers.vertexBuffers[stream].getMemoryProperties()) << " memory");
+
+    IGNIS_LOG("Geometry Pool", Info, "Placed " << getPlacementName(m_placement) << " Index buffer in "
+        << vk::to_string(buffers.indexBuffer.getMemoryProperties()) << " memory");
+}
+
+vk::Result GeometryPool::write(
+    Allocated<vk::Buffer>& buffer, uint8_t* ptr, const void* data, vk::DeviceSize size,
+    vk::DeviceSize offset, vk::AccessFlags dstAccess, UploadToken* p_token
+) {
+    if (!ptr) {
+        vk::ResultValue<UploadToken> upload = IEngine::get().getUploadEngine().uploadBuffer(
+            *buffer, data, size, offset, s_geometryStages, dstAccess | vk::AccessFlagBits::eTransferRead);
+
+        if (p_token && upload.result == vk::Result::eSuccess) *p_token = upload.value;
+        return upload.result;
+    }
+
+    // visible to the next queue submission, so no token is needed
+    std::memcpy(ptr + offset, data, size);
+    return vk::Result { vmaFlushAllocation(IEngine::get().getAllocator(), buffer.m_allocation, offset, size) };
+}
+
+vk::Result GeometryPool::repack(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    Buffers buffers;
+    vk::Result result = createBuffers(buffers, vertexCapacity, indexCapacity);
+    if (result != vk::Result::eSuccess) return result;
+
+    RangeAllocator vertexAllocator { vertexCapacity };
+    RangeAllocator indexAllocator { indexCapacity };
+
+    std::array<std::vector<vk::BufferCopy>, StreamCount> vertexCopies;
+    std::vector<vk::BufferCopy>                          indexCopies;
+
+    // an empty pool allocates from the start, so every allocation ends up packed together
+    for (auto& range : m_ranges) {
+        if (range.vertexCount == 0) continue;
+
+        uint32_t vertexOffset = vertexAllocator.allocate(range.vertexCount).value();
+        uint32_t firstIndex = indexAllocator.allocate(range.indexCount).value();
+
+        for (uint32_t stream = 0; stream < StreamCount; stream++)
+            vertexCopies[stream].push_back(vk::BufferCopy {}
+                .setSrcOffset(range.vertexOffset * s_streamStrides[stream])
+                .setDstOffset(vertexOffset * s_streamStrides[stream])
+                .setSize(range.vertexCount * s_streamStrides[stream]));
+
+        indexCopies.push_back(vk::BufferCopy {}
+            .setSrcOffset(range.firstIndex * sizeof(uint32_t))
+            .setDstOffset(firstIndex * sizeof(uint32_t))
+            .setSize(range.indexCount * sizeof(uint32_t)));
+
+        range.vertexOffset = vertexOffset;
+        range.firstIndex = firstIndex;
+    }
+
+    std::array<vk::Buffer, StreamCount> srcVertexBuffers, dstVertexBuffers;
+    for (uint32_t stream = 0; stream < StreamCount; stream++) {
+        srcVertexBuffers[stream] = *m_buffers.vertexBuffers[stream];
+        dstVertexBuffers[stream] = *buffers.vertexBuffers[stream];
+    }
+
+    vk::Buffer srcIndexBuffer = *m_buffers.indexBuffer;
+    vk::Buffer dstIndexBuffer = *buffers.indexBuffer;
+
+    // host visible allocations may be written again straight away, which a later GPU copy would overwrite
+    if (m_placement == HostVisible) {
+        for (uint32_t stream = 0; stream < StreamCount; stream++)
+            for (auto& copy : vertexCopies[stream])
+                std::memcpy(buffers.vertexPtrs[stream] + copy.dstOffset, m_buffers.vertexPtrs[stream] + copy.srcOffset, copy.size);
+
+        for (auto& copy : indexCopies)
+            std::memcpy(buffers.indexPtr + copy.dstOffset, m_buffers.indexPtr + copy.srcOffset, copy.size);
+
+        // a no-op for host coherent memory
+        for (auto& buffer : buffers.vertexBuffers) vk::resultCheck(buffer.flush(), "Failed to flush the geometry pool");
+        vk::resultCheck(buffers.indexBuffer.flush(), "Failed to flush the geometry pool");
+    } else {
+        // submitted before the next frame, which is the first to draw from the new buffers
+        IEngine::get().getUploadEngine().recordGraphicsCommands([=](vk::CommandBuffer cmd) {
+            for (uint32_t stream = 0; stream < StreamCount; stream++)
+                if (!vertexCopies[stream].empty())
+                    cmd.copyBuffer(srcVertexBuffers[stream], dstVertexBuffers[stream], vertexCopies[stream]);
+
+            if (!indexCopies.empty())
+                cmd.copyBuffer(srcIndexBuffer, dstIndexBuffer, indexCopies);
+
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, s_geometryStages, {},
+                vk::MemoryBarrier {}
+                    .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                    .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead
+                                    | vk::AccessFlagBits::eIndexRead
+                                    | vk::AccessFlagBits::eTransferRead),
+                {}, {});
+        });
+    }
+
+    bool grown = vertexCapacity > m_vertexAllocator.getCapacity() || indexCapacity > m_indexAllocator.getCapacity();
+
+    // frames in flight are still drawing from the old buffers
+    IEngine::get().deferScopeCleanup(*m_buffers.scope);
+
+    m_buffers = std::move(buffers);
+    m_vertexAllocator = std::move(vertexAllocator);
+    m_indexAllocator = std::move(indexAllocator);
+    m_compactionCount++;
+
+    IGNIS_LOG("Geometry Pool", Info, "Repacked " << getPlacementName(m_placement) << " geometry pool into "
+        << vertexCapacity << " vertices and " << indexCapacity << " indices");
+
+    // larger buffers may not fit in the same heap
+    if (grown) logPlacement(m_buffers);
+
+    return vk::Result::eSuccess;
+}
+
+vk::ResultValue<GeometryPool::Handle> GeometryPool::allocate(
+    uint32_t vertexCount, const std::array<const void*, StreamCount>& streams,
+    const std::vector<uint32_t>& indices, UploadToken* p_token
+) {
+    std::lock_guard<std::shared_mutex> lock { m_mutex };
+
+    uint32_t indexCount = indices.size();
+    if (vertexCount == 0 || indexCount == 0) return { vk::Result::eErrorUnknown, Handle { s_invalidHandle } };
+
+    std::optional<uint64_t> vertexOffset = m_vertexAllocator.allocate(vertexCount);
+    std::optional<uint64_t> firstIndex = m_indexAllocator.allocate(indexCount);
+
+    if (!vertexOffset || !firstIndex) {
+        if (vertexOffset) m_vertexAllocator.free(*vertexOffset);
+        if (firstIndex) m_indexAllocator.free(*firstIndex);
+
+        // compacting is enough if there is space, it is just fragmented. Otherwise grow as well
+        uint64_t vertexCapacity = m_vertexAllocator.getCapacity();
+        uint64_t indexCapacity = m_indexAllocator.getCapacity();
+
+        if (m_vertexAllocator.getFree() < vertexCount)
+            vertexCapacity = std::max(vertexCapacity * 2, m_vertexAllocator.getUsed() + vertexCount);
+
+        if (m_indexAllocator.getFree() < indexCount)
+            indexCapacity = std::max(indexCapacity * 2, m_indexAllocator.getUsed() + indexCount);
+
+        vk::Result result = repack(static_cast<uint32_t>(vertexCapacity), static_cast<uint32_t>(indexCapacity));
+        if (result != vk::Result::eSuccess) return { result, Handle { s_invalidHandle } };
+
+        vertexOffset = m_vertexAllocator.allocate(vertexCount);
+        firstIndex = m_indexAllocator.allocate(indexCount);
+    }
+
+    Range range {
+        .vertexOffset = static_cast<uint32_t>(*vertexOffset),
+        .vertexCount = vertexCount,
+        .firstIndex = static_cast<uint32_t>(*firstIndex),
+        .indexCount = indexCount,
+    };
+
+    vk::Result result = vk::Result::eSuccess;
+
+    for (uint32_t stream = 0; stream < StreamCount && result == vk::Result::eSuccess; stream++) {
+        if (!streams[stream]) continue;
+
+        result = write(m_buffers.vertexBuffers[stream], m_buffers.vertexPtrs[stream], streams[stream],
+            vertexCount * s_streamStrides[stream], range.vertexOffset * s_streamStrides[stream],
+            vk::AccessFlagBits::eVertexAttributeRead, p_token);
+    }
+
+    if (result == vk::Result::eSuccess)
+        result = write(m_buffers.indexBuffer, m_buffers.indexPtr, indices.data(),
+            indexCount * sizeof(uint32_t), range.firstIndex * sizeof(uint32_t),
+            vk::AccessFlagBits::eIndexRead, p_token);
+
+    if (result != vk::Result::eSuccess) {
+        m_vertexAllocator.free(range.vertexOffset);
+        m_indexAllocator.free(range.firstIndex);
+        return { result, Handle { s_invalidHandle } };
+    }
+
+    Handle handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_ranges[handle] = range;
+    } else {
+        handle = m_ranges.size();
+        m_ranges.push_back(range);
+    }
+
+    return { vk::Result::eSuccess, handle };
+}
+
+void GeometryPool::free(Handle handle) {
+    std::lock_guard<std::shared_mutex> lock { m_mutex };
+
+    Range& range = m_ranges[handle];
+    assert(range.vertexCount > 0);
+
+    m_vertexAllocator.free(range.vertexOffset);
+    m_indexAllocator.free(range.firstIndex);
+
+    range = Range {};
+    m_freeHandles.push_back(handle);
+}
+
+vk::Result GeometryPool::update(
+    Handle handle, Stream stream, const void* data, uint32_t firstVertex, uint32_t vertexCount, UploadToken* p_token
+) {
+    std::lock_guard<std::shared_mutex> lock { m_mutex };
+
+    const Range& range = m_ranges[handle];
+    assert(firstVertex + vertexCount <= range.vertexCount);
+
+    return write(m_buffers.vertexBuffers[stream], m_buffers.vertexPtrs[stream], data,
+        vertexCount * s_streamStrides[stream], (range.vertexOffset + firstVertex) * s_streamStrides[stream],
+        vk::AccessFlagBits::eVertexAttributeRead, p_token);
+}
+
+bool GeometryPool::compact() {
+    std::lock_guard<std::shared_mutex> lock { m_mutex };
+
+    // a single free range at the end means there is nothing to gain
+    bool vertexFragmented = m_vertexAllocator.getFreeRangeCount() > 1 || m_vertexAllocator.getLargestFreeRange() < m_vertexAllocator.getFree();
+    bool indexFragmented = m_indexAllocator.getFreeRangeCount() > 1 || m_indexAllocator.getLargestFreeRange() < m_indexAllocator.getFree();
+    if (!vertexFragmented && !indexFragmented) return false;
+
+    return repack(m_vertexAllocator.getCapacity(), m_indexAllocator.getCapacity()) == vk::Result::eSuccess;
+}
+
+void GeometryPool::bind(vk::CommandBuffer cmd, uint32_t firstBinding) {
+    std::array<vk::Buffer, StreamCount>     buffers;
+    std::array<vk::DeviceSize, StreamCount> offsets {};
+
+    for (uint32_t stream = 0; stream < StreamCount; stream++)
+        buffers[stream] = *m_buffers.vertexBuffers[stream];
+
+    cmd.bindVertexBuffers(firstBinding, buffers, offsets);
+    cmd.bindIndexBuffer(*m_buffers.indexBuffer, 0, vk::IndexType::eUint32);
+}
+
+GeometryPool::Stats GeometryPool::getStats() {
+    std::shared_lock<std::shared_mutex> lock { m_mutex };
+
+    Stats stats {
+        .vertexCapacity = m_vertexAllocator.getCapacity(),
+        .verticesUsed = m_vertexAllocator.getUsed(),
+        .vertexFreeRanges = m_vertexAllocator.getFreeRangeCount(),
+        .indexCapacity = m_indexAllocator.getCapacity(),
+        .indicesUsed = m_indexAllocator.getUsed(),
+        .indexFreeRanges = m_indexAllocator.getFreeRangeCount(),
+        .allocationCount = static_cast<uint32_t>(m_ranges.size() - m_freeHandles.size()),
+        .compactionCount = m_compactionCount,
+    };
+
+    for (uint32_t stream = 0; stream < StreamCount; stream++)
+        stats.vertexMemory[stream] = m_buffers.vertexBuffers[stream].getMemoryProperties();
+
+    stats.indexMemory = m_buffers.indexBuffer.getMemoryProperties();
+
+    return stats;
+}
+
+}
@@ -1,6 +1,5 @@
 #include "gltf.hpp"
 #include "log.hpp"
-#include "bufferBuilder.hpp"
 #include "uniformBuilder.hpp"
 #include "engine.hpp"
 #include <thread>
@@ -23,11 +22,6 @@ const std::map<std::string, GLTFModel::LightInstance::Type> GLTFModel::LightInst
 
 const std::vector<std::string> GLTFModel::LightInstance::s_typeToName { "ambient", "point", "spot", "directional" };
 
-GLTFModel::~GLTFModel() {
-    IEngine::get().getDevice().waitIdle();
-    m_localScope.executeDeferredCleanupFunctions();
-}
-
 void GLTFModel::loadAsync(const std::string& filename, bool* p_success) {
     m_filename = filename;
 
@@ -37,11 +31,38 @@ void GLTFModel::loadAsync(const std::string& filename, bool* p_success) {
     }).detach();
 }
 
+void GLTFModel::loadAsync(const std::string& filename, vk::DescriptorSetLayout cameraDescriptorSetLayout, bool* p_success) {
+    m_filename = filename;
+
+    std::thread([&, filename, cameraDescriptorSetLayout, p_success]() {
+        bool success = load(filename) && setup(cameraDescriptorSetLayout);
+        if (p_success) *p_success = success;
+    }).detach();
+}
+
 bool GLTFModel::load(const std::string& filename) {
     m_filename = filename;
 
     m_localScope.setName(filename);
 
+    if (filename.ends_with(".ipkg")) {
+        IGNIS_LOG("glTF", Info, "Loading model package: " << filename);
+
+        try {
+            m_package = ModelPackage::read(filename);
+        } catch (std::runtime_error& e) {
+            IGNIS_LOG("glTF", Error, e.what());
+            return false;
+        }
+
+        m_package.fillModel(m_model);
+
+        IGNIS_LOG("glTF", Info, "Loaded model package: " << filename);
+
+        m_status.value = Loaded;
+        return true;
+    }
+
     gltf::TinyGLTF loader;
     std::string error, warning;
 
@@ -63,9 +84,17 @@ bool GLTFModel::load(const std::string& filename) {
         return false;
     }
 
+    // resolved the same way as by ignis_cook, minus compressing textures, building mips and optimising geometry
+    std::vector<std::string> warnings;
+    m_package = ModelPackage::cook(m_model, {}, warnings);
+    for (auto& cookWarning : warnings) IGNIS_LOG("glTF", Warning, cookWarning);
+
+    // the package has its own copy of all the vertex data
+    m_model.buffers.clear();
+
     IGNIS_LOG("glTF", Info, "Loaded glTF file: " << filename);
 
-    m_status = Loaded;
+    m_status.value = Loaded;
     return true;
 }
 
@@ -92,42 +121,24 @@ bool GLTFModel::checkCompatibility() {
         IGNIS_LOG("glTF", Error, "Model " << getFileName() << " requires unsupported extension " << extension);
     }
 
-    for (auto& mesh : m_model.meshes) {
-        m_bindingData.emplace_back();
+    for (auto& mesh : m_package.meshes) {
+        auto& meshBindingData = m_bindingData.emplace_back();
 
         for (int primitiveID = 0; primitiveID < mesh.primitives.size(); primitiveID++) {
             auto& primitive = mesh.primitives[primitiveID];
 
-            BindingData& bindingData = m_bindingData.back().emplace_back();
-
-            bool foundPosition, foundTexcoord, foundNormal, foundTangent;
-            foundPosition = foundTexcoord = foundNormal = foundTangent = false;
-
-            #define FIND_BINDING(name, accessor, found) { \
-                auto it = primitive.attributes.find(name); \
-                found = it != primitive.attributes.end(); \
-                if (found) bindingData.accessor = it->second; \
-            }
-
-            FIND_BINDING("POSITION", positionAccessor, foundPosition);
-            FIND_BINDING("TEXCOORD_0", texcoordAccessor, foundTexcoord);
-            FIND_BINDING("NORMAL", normalAccessor, foundNormal);
-            FIND_BINDING("TANGENT", tangentAccessor, foundTangent);
+            BindingData& bindingData = meshBindingData.emplace_back();
 
-            #undef FIND_BINDING
+            // primitives which can't be drawn were reported when the model was resolved
+            if (!primitive.isValid()) continue;
 
-            if (foundPosition && foundTexcoord && foundNormal && foundTangent) {
+            if (primitive.hasTangents()) {
                 bindingData.pipelineData = &s_pipeline;
 
-            } else if (foundPosition && foundTexcoord && foundNormal) {
+            } else {
                 bindingData.pipelineData = &s_backupPipeline;
                 IGNIS_LOG("glTF", Verbose, "Mesh " << mesh.name << " primitives[" << primitiveID << "] "
                     "does not provide a 'TANGENT' attribute, so it will be rendered with a backup pipeline");
-                
-            } else {
-                IGNIS_LOG("glTF", Error, "Mesh " << mesh.name << " primitives[" << primitiveID << "] "
-                    "attributes are not compatible with any pipeline, and it won't be rendered. "
-                    "Primitives must provide at least a 'POSITION', 'TEXCOORD_0', and 'NORMAL'");
             }
         }
     }
@@ -136,60 +147,84 @@ bool GLTFModel::checkCompatibility() {
 }
 
 bool GLTFModel::setupBuffers() {
-    for (int i = 0; i < m_model.buffers.size(); i++) {
-        auto bufferUsage = vk::BufferUsageFlagBits::eVertexBuffer
-                         | vk::BufferUsageFlagBits::eIndexBuffer;
-
-        auto allocationUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-        auto bufferResult = BufferBuilder { m_localScope }
-            .setBufferUsage(bufferUsage)
-            .setAllocationUsage(allocationUsage)
-            .setSizeBuildAndCopyData(m_model.buffers[i].data);
-        
-        if (bufferResult.result != vk::Result::eSuccess) {
-            IGNIS_LOG("glTF", Error, "Failed to create buffer: " << bufferResult.result);
-            return false;
+    GeometryPool& geometryPool = IEngine::get().getGeometryPool(m_geometryPlacement);
+    std::vector<GeometryPool::Handle> geometry;
+    bool allocationFailed = false;
+    uint64_t vertexTotal = 0, indexTotal = 0;
+
+    for (int meshID = 0; meshID < m_package.meshes.size(); meshID++)
+    for (int primitiveID = 0; primitiveID < m_package.meshes[meshID].primitives.size(); primitiveID++) {
+        auto& primitive = m_package.meshes[meshID].primitives[primitiveID];
+        BindingData& bindingData = m_bindingData[meshID][primitiveID];
+
+        if (!bindingData.pipelineData) continue;
+
+        auto& streams = primitive.streams;
+        uint32_t vertexCount = primitive.vertexCount;
+        std::vector<uint32_t>& indices = primitive.indices;
+
+        auto geometryResult = geometryPool.allocate(vertexCount, {
+            streams[GeometryPool::Position].data(),
+            streams[GeometryPool::Texcoord].data(),
+            streams[GeometryPool::Normal].data(),
+            primitive.hasTangents() ? streams[GeometryPool::Tangent].data() : nullptr,
+        }, indices);
+
+        if (geometryResult.result != vk::Result::eSuccess) {
+            IGNIS_LOG("glTF", Error, "Failed to allocate geometry: " << geometryResult.result);
+            allocationFailed = true;
+            break;
         }
 
-        m_buffers.push_back(bufferResult.value);
+        bindingData.geometry = geometryResult.value;
+        geometry.push_back(geometryResult.value);
+        vertexTotal += vertexCount;
+        indexTotal += indices.size();
+
+        // the pool has its own copy now
+        streams = {};
+        indices = {};
     }
-    
-    return true;
+
+    GeometryPool::Stats stats = geometryPool.getStats();
+    IGNIS_LOG("glTF", Info, "Placed " << geometry.size() << " primitives, " << vertexTotal << " vertices and "
+        << indexTotal << " indices, in the " << GeometryPool::getPlacementName(m_geometryPlacement) << " geometry pool. "
+        << "Position: " << vk::to_string(stats.vertexMemory[GeometryPool::Position])
+        << ", Texcoord: " << vk::to_string(stats.vertexMemory[GeometryPool::Texcoord])
+        << ", Normal: " << vk::to_string(stats.vertexMemory[GeometryPool::Normal])
+        << ", Tangent: " << vk::to_string(stats.vertexMemory[GeometryPool::Tangent])
+        << ", Index: " << vk::to_string(stats.indexMemory));
+
+    // the model's scope is cleaned up once the frames in flight have finished with it
+    m_localScope.addDeferredCleanupFunction([&geometryPool, geometry]() {
+        for (auto handle : geometry) geometryPool.free(handle);
+    });
+
+    return !allocationFailed;
 }
 
 bool GLTFModel::setupImages() {
-    // workout image formats
-    std::vector<vk::Format> imageFormats(m_model.images.size(), vk::Format::eR8G8B8A8Unorm);
-
-    for (auto& material : m_model.materials) {
-        #define SET_IMAGE_FORMAT(index, format) if (index >= 0) { \
-            uint32_t textureIndex = m_model.textures[index].source; \
-            if (textureIndex >= 0) imageFormats[textureIndex] = vk::Format::format; \
+    for (auto& image : m_package.images) {
+        try {
+            // pre-built chains from ignis_cook are uploaded as they are, otherwise the mips are blitted
+            m_images.push_back(ImageBuilder { m_localScope }
+                .setInitialLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                .setFormat(image.format)
+                .setAutoMipMapMode(image.levelOffsets.size() == 1
+                    ? ImageBuilder::AutoMipMapMode::Initialise
+                    : ImageBuilder::AutoMipMapMode::None)
+                .loadMipChain(image.data.data(), image.data.size(), image.width, image.height, image.levelOffsets));
+        } catch (std::runtime_error& e) {
+            IGNIS_LOG("glTF", Error, "Failed to load image: " << e.what());
+            return false;
         }
 
-        SET_IMAGE_FORMAT(material.normalTexture.index, eR8G8B8A8Unorm);
-        SET_IMAGE_FORMAT(material.emissiveTexture.index, eR8G8B8A8Srgb);
-        SET_IMAGE_FORMAT(material.occlusionTexture.index, eR8G8B8A8Unorm);
-        SET_IMAGE_FORMAT(material.pbrMetallicRoughness.baseColorTexture.index, eR8G8B8A8Srgb);
-        SET_IMAGE_FORMAT(material.pbrMetallicRoughness.metallicRoughnessTexture.index, eR8G8B8A8Unorm);
-
-        #undef SET_IMAGE_FORMAT
-    }
-
-    for (int i = 0; i < m_model.images.size(); i++) {
-        auto& image = m_model.images[i];
-        m_images.push_back(ImageBuilder { m_localScope }
-            .setInitialLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setFormat(imageFormats[i])
-            .setAutoMipMapMode(ImageBuilder::AutoMipMapMode::Initialise)
-            .load(&image.image[0], image.width, image.height));
-
         m_imageViews.push_back(ImageViewBuilder { *m_images.back(), m_localScope }
             .build());
-    }
 
-    std::thread([&]() { for (auto& image : m_model.images) image.image.clear(); }).detach();
+        // staged by the upload, so no longer needed
+        image.data = {};
+    }
 
     return true;
 }
@@ -207,90 +242,55 @@ bool GLTFModel::setupSamplers() {
     vk::Sampler defaultSampler = device.createSampler(defaultSamplerCreateInfo);
     m_samplers.push_back(defaultSampler);
     
-    m_localScope.addDeferredCleanupFunction([=]() { device.destroySampler(defaultSampler); });
+    m_localScope.addDeferredDestroy(device, defaultSampler);
 
-    for (auto& sampler : m_model.samplers) {
+    for (auto& sampler : m_package.samplers) {
         auto createInfo = vk::SamplerCreateInfo { defaultSamplerCreateInfo }
+            .setAddressModeU(sampler.addressModeU)
+            .setAddressModeV(sampler.addressModeV)
+            .setMinFilter(sampler.minFilter)
+            .setMagFilter(sampler.magFilter)
             .setMaxLod(VK_LOD_CLAMP_NONE);
 
-        switch (sampler.wrapS) {
-        case TINYGLTF_TEXTURE_WRAP_REPEAT:          createInfo.setAddressModeU(vk::SamplerAddressMode::eRepeat); break;
-        case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:   createInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge); break;
-        case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT: createInfo.setAddressModeU(vk::SamplerAddressMode::eMirroredRepeat); break;
-        }
-
-        switch (sampler.wrapT) {
-        case TINYGLTF_TEXTURE_WRAP_REPEAT:          createInfo.setAddressModeV(vk::SamplerAddressMode::eRepeat); break;
-        case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:   createInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge); break;
-        case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT: createInfo.setAddressModeV(vk::SamplerAddressMode::eMirroredRepeat); break;
-        }
-
-        switch (sampler.minFilter) {
-        case TINYGLTF_TEXTURE_FILTER_LINEAR:  createInfo.setMinFilter(vk::Filter::eLinear); break;
-        case TINYGLTF_TEXTURE_FILTER_NEAREST: createInfo.setMinFilter(vk::Filter::eNearest); break;
-        }
-
-        switch (sampler.magFilter) {
-        case TINYGLTF_TEXTURE_FILTER_LINEAR:  createInfo.setMinFilter(vk::Filter::eLinear); break;
-        case TINYGLTF_TEXTURE_FILTER_NEAREST: createInfo.setMinFilter(vk::Filter::eNearest); break;
-        }
-
         m_samplers.push_back(device.createSampler(createInfo));
         
-        m_localScope.addDeferredCleanupFunction([=, sampler = m_samplers.back()]() {
-            device.destroySampler(sampler);
-        });
+        m_localScope.addDeferredDestroy(device, m_samplers.back());
     }
 
     return true;
 }
 
 bool GLTFModel::setupMaterials() {
-    uint32_t materialCount = m_model.materials.size();
+    uint32_t materialCount = m_package.materials.size();
 
     vk::DescriptorPool materialPool = DescriptorPoolBuilder { m_localScope }
         .setMaxSetCount(materialCount)
-        .addPoolSize({ vk::DescriptorType::eCombinedImageSampler, 5 * materialCount })
+        .addPoolSize({ vk::DescriptorType::eCombinedImageSampler, ModelPackage::TextureSlotCount * materialCount })
         .build();
     
-    for (auto& material : m_model.materials) {
+    for (auto& material : m_package.materials) {
         m_materials.push_back(UniformBuilder { m_localScope, materialPool }
             .addLayouts(s_materialLayout)
             .build());
         
-        std::vector<int> textureIDs {
-            material.pbrMetallicRoughness.baseColorTexture.index,
-            material.pbrMetallicRoughness.metallicRoughnessTexture.index,
-            material.emissiveTexture.index,
-            material.occlusionTexture.index,
-            material.normalTexture.index
-        };
-        
         std::vector<Uniform::Update> uniformUpdates;
-        for (int binding = 0; binding < textureIDs.size(); binding++) {
-            auto& texture = m_model.textures[textureIDs[binding]];
+        for (uint32_t binding = 0; binding < ModelPackage::TextureSlotCount; binding++) {
+            auto& texture = material.textures[binding];
             
+            // the default sampler is first, so a texture without a sampler gets it
             uniformUpdates.push_back(m_materials.back().update(vk::DescriptorType::eCombinedImageSampler, 0, binding)
                 .addImageInfo(vk::DescriptorImageInfo {}
                     .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                    .setImageView(texture.source < 0 ? s_nullImageView : m_imageViews[texture.source])
-                    .setSampler(m_samplers[std::min<uint32_t>(texture.sampler + 1, m_samplers.size() - 1)])));
+                    .setImageView(texture.image < 0 ? s_nullImageView : m_imageViews[texture.image])
+                    .setSampler(m_samplers[texture.sampler + 1])));
         }
         Uniform::updateUniforms(uniformUpdates);
 
         m_materialStructs.push_back(MaterialData {
-            .emissiveFactor = {
-                material.emissiveFactor[0],
-                material.emissiveFactor[1],
-                material.emissiveFactor[2] },
-            .baseColorFactor = {
-                material.pbrMetallicRoughness.baseColorFactor[0],
-                material.pbrMetallicRoughness.baseColorFactor[1],
-                material.pbrMetallicRoughness.baseColorFactor[2],
-                material.pbrMetallicRoughness.baseColorFactor[3],
-            },
-            .metallicFactor = static_cast<float>(material.pbrMetallicRoughness.metallicFactor),
-            .roughnessFactor = static_cast<float>(material.pbrMetallicRoughness.roughnessFactor),
+            .emissiveFactor = material.emissiveFactor,
+            .baseColorFactor = material.baseColorFactor,
+            .metallicFactor = material.metallicFactor,
+            .roughnessFactor = material.roughnessFactor,
         });
     }
 
@@ -455,19 +455,18 @@ bool GLTFModel::setupStatics(ResourceScope& scope, vk::DescriptorSetLayout camer
 }
 
 bool GLTFModel::setup(vk::DescriptorSetLayout cameraUniformLayout) {
+    // the render thread and a background load may both try, only one of them sets up
+    Status expected = Loaded;
+    if (!m_status.value.compare_exchange_strong(expected, SettingUp)) return expected == Ready;
+
     if (!s_pipeline.pipeline) {
         IGNIS_LOG("glTF", Error, "Trying to setup glTF model before setting up glTF shared resources." <<
                                  "Call GLTFModel::setupPipelines() before setting up any models");
         
-        m_status = Failed;
+        m_status.value = Failed;
         return false;
     }
 
-    vk::Device device = IEngine::get().getDevice();
-    
-    for (auto& s : m_oneFrameScopes)
-        m_localScope.addDeferredCleanupFunction([&]() { s.executeDeferredCleanupFunctions(); });
-
     bool success = true
         && checkCompatibility()
         && setupBuffers()
@@ -475,7 +474,7 @@ bool GLTFModel::setup(vk::DescriptorSetLayout cameraUniformLayout) {
         && setupSamplers()
         && setupMaterials();
 
-    m_status = success ? Ready : Failed;
+    m_status.value = success ? Ready : Failed;
 
     if (success) { IGNIS_LOG("glTF", Info, "Finished setting up glTF model: " << m_filename); }
     else         { IGNIS_LOG("glTF", Warning, "Failed to setup up glTF model: " << m_filename); }
@@ -533,120 +532,118 @@ void GLTFModel::updateInstances(gltf::Node& node, const glm::mat4& parentMat) {
 void GLTFModel::updateInstances(gltf::Scene& scene) {
     m_lightInstances.clear();
     m_instances.clear();
-    m_instances.resize(m_model.meshes.size());
+    m_instances.resize(m_package.meshes.size());
 
     for (auto& nodeID : scene.nodes)
         updateInstances(m_model.nodes[nodeID]);
 }
 
-bool GLTFModel::bindBuffer(vk::CommandBuffer cmd, gltf::Primitive primitive, const char* name, uint32_t binding) {
-    auto it = primitive.attributes.find(name);
-
-    if (it == primitive.attributes.end()) return false;
-
-    auto& accessorIndex = it->second;
-    auto& accessor = m_model.accessors[accessorIndex];
-    auto& bufferView = m_model.bufferViews[accessor.bufferView];
-    auto& buffer = m_buffers[bufferView.buffer];
-
-    cmd.bindVertexBuffers(binding, *buffer, bufferView.byteOffset, {});
-
-    return true;
-}
-
 bool GLTFModel::bind(
     vk::CommandBuffer cmd,
     const BindingData& data,
-    vk::DescriptorSet cameraDescriptorSet,
-    vk::DescriptorSet materialDescriptorSet
+    Camera& camera,
+    vk::DescriptorSet materialDescriptorSet,
+    PipelineData*& p_boundPipeline
 ) {
     if (!data.isValid()) return false;
 
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, data.pipelineData->pipeline);
-
-    #define BIND(binding, accessorID) if (accessorID >= 0) { \
-        auto& accessor = m_model.accessors[accessorID]; \
-        auto& bufferView = m_model.bufferViews[accessor.bufferView]; \
-        auto& buffer = m_buffers[bufferView.buffer]; \
-        cmd.bindVertexBuffers(binding, *buffer, bufferView.byteOffset, {}); \
+    // vertex and index buffers are shared by the whole geometry pool, so only the pipeline changes between primitives
+    if (p_boundPipeline != data.pipelineData) {
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, data.pipelineData->pipeline);
+        p_boundPipeline = data.pipelineData;
     }
 
-    BIND(0, data.positionAccessor);
-    BIND(1, data.texcoordAccessor);
-    BIND(2, data.normalAccessor);
-    BIND(3, data.tangentAccessor);
-
-    #undef BIND
-
     cmd.bindDescriptorSets(
         vk::PipelineBindPoint::eGraphics, data.pipelineData->layout,
-        0, { cameraDescriptorSet, materialDescriptorSet }, {});
+        0, { camera.uniform.getSet(), materialDescriptorSet }, camera.getDynamicOffset());
 
     return true;
 }
 
-void GLTFModel::drawMeshes(vk::CommandBuffer cmd, Camera& camera) {
+bool GLTFModel::prepareDraw() {
     updateInstances();
 
-    auto& oneFrameScope = m_oneFrameScopes[IEngine::get().getInFlightIndex()];
+    // every mesh's instances go in one allocation, and are selected with firstInstance
+    std::vector<Instance> instances;
+    m_firstInstances.clear();
 
-    oneFrameScope.executeDeferredCleanupFunctions();
-    std::vector<Allocated<vk::Buffer>> instanceBuffers;
+    for (auto& meshInstances : m_instances) {
+        m_firstInstances.push_back(instances.size());
+        instances.insert(instances.end(), meshInstances.begin(), meshInstances.end());
+    }
 
-    for (auto& instances : m_instances) {
-        auto bufferResult = BufferBuilder { oneFrameScope }
-            .setBufferUsage(vk::BufferUsageFlagBits::eVertexBuffer)
-            .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
-            .setSizeBuildAndCopyData(instances);
-        
-        if (bufferResult.result != vk::Result::eSuccess) {
-            IGNIS_LOG("glTF", Error, "Failed to create one-frame instance buffer: vk::Result = " << bufferResult.result);
-            return;
-        }
+    m_instanceAllocation = IEngine::get().getFrameAllocator().allocateAndCopy(instances);
 
-        instanceBuffers.push_back(bufferResult.value);
+    if (!m_instanceAllocation.isValid()) {
+        IGNIS_LOG("glTF", Error, "Failed to allocate this frame's instance data");
+        return false;
     }
 
-    vk::DescriptorSet cameraDescriptorSet = camera.uniform.getSet(IEngine::get().getInFlightIndex());
-    
-    for (int meshID = 0; meshID < m_model.meshes.size(); meshID++) {
-        auto& mesh = m_model.meshes[meshID];
-        for (int primitiveID = 0; primitiveID < mesh.primitives.size(); primitiveID++) {
-            auto& primitive = mesh.primitives[primitiveID];
+    if (m_primitives.empty())
+        for (int meshID = 0; meshID < m_package.meshes.size(); meshID++)
+        for (int primitiveID = 0; primitiveID < m_package.meshes[meshID].primitives.size(); primitiveID++)
+            m_primitives.push_back({ meshID, primitiveID });
 
-            BindingData& bindingData = m_bindingData[meshID][primitiveID];
+    return true;
+}
 
-            if (!bind(cmd, bindingData, cameraDescriptorSet, m_materials[primitive.material].getSet())) continue;
+void GLTFModel::drawMeshes(vk::CommandBuffer cmd, Camera& camera) {
+    if (prepareDraw()) drawMeshes(cmd, camera, 0, 1);
+}
 
-            cmd.bindVertexBuffers(4, *instanceBuffers[meshID], { 0 }, {});
+void GLTFModel::drawMeshes(vk::CommandBuffer cmd, Camera& camera, uint32_t chunkIndex, uint32_t chunkCount) {
+    if (!m_instanceAllocation.isValid()) return;
 
-            cmd.pushConstants<MaterialData>(bindingData.pipelineData->layout, vk::ShaderStageFlagBits::eAllGraphics, 0, m_materialStructs[primitive.material]);
+    GeometryPool& geometryPool = IEngine::get().getGeometryPool(m_geometryPlacement);
+    geometryPool.bind(cmd);
+    cmd.bindVertexBuffers(4, m_instanceAllocation.buffer, m_instanceAllocation.offset);
 
-            auto& indexAccessor = m_model.accessors[primitive.indices];
-            uint32_t indexCount = indexAccessor.count;
-            auto& indexBufferView = m_model.bufferViews[indexAccessor.bufferView];
-            auto& indexBuffer = m_buffers[indexBufferView.buffer];
-            cmd.bindIndexBuffer(*indexBuffer, indexBufferView.byteOffset, vk::IndexType::eUint16);
+    PipelineData* boundPipeline = nullptr;
 
-            cmd.drawIndexed(indexCount, 1, 0, 0, 0);
-        }
+    size_t first = m_primitives.size() * chunkIndex / chunkCount;
+    size_t last = m_primitives.size() * (chunkIndex + 1) / chunkCount;
+
+    for (size_t i = first; i < last; i++) {
+        auto [meshID, primitiveID] = m_primitives[i];
+        auto& primitive = m_package.meshes[meshID].primitives[primitiveID];
+
+        BindingData& bindingData = m_bindingData[meshID][primitiveID];
+
+        // meshes which are not in the scene have no instances
+        uint32_t instanceCount = m_instances[meshID].size();
+        if (instanceCount == 0) continue;
+
+        if (!bind(cmd, bindingData, camera, m_materials[primitive.material].getSet(), boundPipeline)) continue;
+
+        cmd.pushConstants<MaterialData>(bindingData.pipelineData->layout, vk::ShaderStageFlagBits::eAllGraphics, 0, m_materialStructs[primitive.material]);
+
+        const GeometryPool::Range& range = geometryPool.getRange(bindingData.geometry);
+        cmd.drawIndexed(range.indexCount, instanceCount, range.firstIndex, range.vertexOffset, m_firstInstances[meshID]);
     }
 }
 
 void GLTFModel::drawLights(vk::CommandBuffer cmd, Camera& camera) {
+    drawLights(cmd, camera, 0, 1);
+}
+
+void GLTFModel::drawLights(vk::CommandBuffer cmd, Camera& camera, uint32_t chunkIndex, uint32_t chunkCount) {
     cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, s_lightingPipeline.pipeline);
 
     cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, s_lightingPipeline.layout, 0,
-        camera.uniform.getSet(IEngine::get().getInFlightIndex()), {});
+        camera.uniform.getSet(), camera.getDynamicOffset());
 
     cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, s_lightingPipeline.layout, 1,
         IEngine::get().getGBuffer().uniform.getSet(), {});
     
     // draw ambient light
-    LightInstance { .color = { 1.0f, 1.0f, 1.0f, 0.05f } }.draw(cmd);
+    if (chunkIndex == 0)
+        LightInstance { .color = { 1.0f, 1.0f, 1.0f, 0.05f } }.draw(cmd);
+
+    size_t first = m_lightInstances.size() * chunkIndex / chunkCount;
+    size_t last = m_lightInstances.size() * (chunkIndex + 1) / chunkCount;
 
-    for (auto& lightInstance : m_lightInstances)
-        lightInstance.draw(cmd);
+    for (size_t i = first; i < last; i++)
+        m_lightInstances[i].draw(cmd);
 }
 
 void GLTFModel::renderUI() {
@@ -685,11 +682,11 @@ void GLTFModel::renderNodeUI(uint32_t nodeID) {
     }
 
     if (node.mesh >= 0) {
-        ImGui::Text("Mesh name: %s", m_model.meshes[node.mesh].name.c_str());
+        ImGui::Text("Mesh name: %s", m_package.meshes[node.mesh].name.c_str());
 
         if (ImGui::TreeNode("Materials")) {
-            for (gltf::Primitive& primitive : m_model.meshes[node.mesh].primitives)
-            if (ImGui::TreeNode(("Name: " + m_model.materials[primitive.material].name).c_str())) {
+            for (auto& primitive : m_package.meshes[node.mesh].primitives)
+            if (ImGui::TreeNode(("Name: " + m_package.materials[primitive.material].name).c_str())) {
                 MaterialData& material = m_materialStructs[primitive.material];
 
                 ImGui::DragFloat4("Base color factor", &material.baseColorFactor.x, 0.05f, 0.0f, 1.0f);
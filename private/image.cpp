@@ -4,9 +4,14 @@
 #include "common.hpp"
 #include "libraries.hpp"
 #include <stdlib.h>
+#include <cstring>
+#include <fstream>
+#include <string_view>
 
 namespace ignis {
 
+std::atomic<bool> ImageLayoutTransition::s_debugRedundantTransitions = false;
+
 ImageLayoutTransition::ImageLayoutTransition(
     Image& image
 ) : r_image(image)
@@ -14,12 +19,12 @@ ImageLayoutTransition::ImageLayoutTransition(
     setAspectMask(image.getAspectMask());
 }
 
-ImageLayoutTransition& ImageLayoutTransition::setSrcStageMask(vk::PipelineStageFlags mask) {
+ImageLayoutTransition& ImageLayoutTransition::setSrcStageMask(vk::PipelineStageFlags2 mask) {
     m_srcStageMask = mask;
     return *this;
 }
 
-ImageLayoutTransition& ImageLayoutTransition::setDstStageMask(vk::PipelineStageFlags mask) {
+ImageLayoutTransition& ImageLayoutTransition::setDstStageMask(vk::PipelineStageFlags2 mask) {
     m_dstStageMask = mask;
     return *this;
 }
@@ -34,12 +39,12 @@ ImageLayoutTransition& ImageLayoutTransition::setNewLayout(vk::ImageLayout layou
     return *this;
 }
 
-ImageLayoutTransition& ImageLayoutTransition::setSrcAccessMask(vk::AccessFlags mask) {
+ImageLayoutTransition& ImageLayoutTransition::setSrcAccessMask(vk::AccessFlags2 mask) {
     m_srcAccessMask = mask;
     return *this;
 }
 
-ImageLayoutTransition& ImageLayoutTransition::setDstAccessMask(vk::AccessFlags mask) {
+ImageLayoutTransition& ImageLayoutTransition::setDstAccessMask(vk::AccessFlags2 mask) {
     m_dstAccessMask = mask;
     return *this;
 }
@@ -64,25 +69,30 @@ ImageLayoutTransition& ImageLayoutTransition::setAspectMask(vk::ImageAspectFlags
 }
 
 void ImageLayoutTransition::execute(vk::CommandBuffer cmd) {
-    bool async = cmd != VK_NULL_HANDLE;
-
-    if (cmd == VK_NULL_HANDLE)
-        cmd = IEngine::get().beginOneTimeCommandBuffer(vkb::QueueType::graphics);
-    
-    // assert(m_oldLayout != m_newLayout);
-
-    cmd.pipelineBarrier(
-        m_srcStageMask,
-        m_dstStageMask,
-        {}, {}, {},
-        vk::ImageMemoryBarrier {}
-            .setImage(r_image.m_image)
-            .setOldLayout(m_oldLayout)
-            .setNewLayout(m_newLayout)
-            .setSrcAccessMask(m_srcAccessMask)
-            .setDstAccessMask(m_dstAccessMask)
-            .setSubresourceRange(m_subResourceRange)
-    );
+    // rather than submitting and waiting here, a null cmd joins the next upload batch, which is submitted before the next frame
+    BarrierBatch batch;
+    execute(batch);
+    batch.flush(cmd);
+}
+
+void ImageLayoutTransition::execute(BarrierBatch& batch) {
+    vk::AccessFlags2 srcAccessMask = m_srcAccessMask.value_or(getLayoutSrcAccess(m_oldLayout));
+
+    if (s_debugRedundantTransitions && m_oldLayout == m_newLayout && !srcAccessMask)
+        IGNIS_LOG("Image", Warning, "Redundant transition of image " << static_cast<VkImage>(r_image.m_image) << " from " << vk::to_string(m_oldLayout)
+            << " to the same layout, with no writes to wait on");
+
+    batch.addImageBarrier(vk::ImageMemoryBarrier2 {}
+        .setSrcStageMask(m_srcStageMask.value_or(getLayoutStages(m_oldLayout)))
+        .setDstStageMask(m_dstStageMask.value_or(getLayoutStages(m_newLayout)))
+        .setSrcAccessMask(srcAccessMask)
+        .setDstAccessMask(m_dstAccessMask.value_or(getLayoutDstAccess(m_newLayout)))
+        .setImage(r_image.m_image)
+        .setOldLayout(m_oldLayout)
+        .setNewLayout(m_newLayout)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSubresourceRange(m_subResourceRange));
 
     uint32_t mipLevelFrom = m_subResourceRange.baseMipLevel;
     uint32_t mipLevelTo = mipLevelFrom + m_subResourceRange.levelCount;
@@ -93,14 +103,86 @@ void ImageLayoutTransition::execute(vk::CommandBuffer cmd) {
     for (uint32_t arrayLayer = arrayLayerFrom; arrayLayer < arrayLayerTo; arrayLayer++) {
         r_image.getLayout(mipLevel, arrayLayer) = m_newLayout;
     }
+}
 
-    if (!async) {
-        vk::Fence fence = IEngine::get().getDevice().createFence(vk::FenceCreateInfo {});
+vk::PipelineStageFlags2 ImageLayoutTransition::getLayoutStages(vk::ImageLayout layout) {
+    using Layout = vk::ImageLayout;
+    using Stage = vk::PipelineStageFlagBits2;
+
+    switch (layout) {
+    case Layout::eUndefined:
+    case Layout::ePreinitialized:
+        return Stage::eNone;
+    case Layout::eColorAttachmentOptimal:
+        return Stage::eColorAttachmentOutput;
+    case Layout::eDepthStencilAttachmentOptimal:
+    case Layout::eDepthAttachmentOptimal:
+    case Layout::eStencilAttachmentOptimal:
+        return Stage::eEarlyFragmentTests | Stage::eLateFragmentTests;
+    case Layout::eDepthStencilReadOnlyOptimal:
+    case Layout::eDepthReadOnlyOptimal:
+    case Layout::eStencilReadOnlyOptimal:
+        return Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eFragmentShader;
+    case Layout::eShaderReadOnlyOptimal:
+        return Stage::eFragmentShader | Stage::eComputeShader;
+    case Layout::eTransferSrcOptimal:
+    case Layout::eTransferDstOptimal:
+        return Stage::eAllTransfer;
+    // presentation is ordered by the semaphores either side of it instead
+    case Layout::ePresentSrcKHR:
+        return Stage::eNone;
+    default:
+        return Stage::eAllCommands;
+    }
+}
 
-        IEngine::get().submitOneTimeCommandBuffer(cmd, vkb::QueueType::graphics, vk::SubmitInfo {}, fence);
+vk::AccessFlags2 ImageLayoutTransition::getLayoutSrcAccess(vk::ImageLayout layout) {
+    using Layout = vk::ImageLayout;
+    using Access = vk::AccessFlagBits2;
+
+    switch (layout) {
+    case Layout::eColorAttachmentOptimal:
+        return Access::eColorAttachmentWrite;
+    case Layout::eDepthStencilAttachmentOptimal:
+    case Layout::eDepthAttachmentOptimal:
+    case Layout::eStencilAttachmentOptimal:
+        return Access::eDepthStencilAttachmentWrite;
+    case Layout::eTransferDstOptimal:
+        return Access::eTransferWrite;
+    case Layout::eGeneral:
+        return Access::eMemoryWrite;
+    default:
+        return Access::eNone;
+    }
+}
 
-        auto _ = IEngine::get().getDevice().waitForFences(fence, true, UINT64_MAX);
-        IEngine::get().getDevice().destroyFence(fence);
+vk::AccessFlags2 ImageLayoutTransition::getLayoutDstAccess(vk::ImageLayout layout) {
+    using Layout = vk::ImageLayout;
+    using Access = vk::AccessFlagBits2;
+
+    switch (layout) {
+    case Layout::eUndefined:
+    case Layout::ePreinitialized:
+    case Layout::ePresentSrcKHR:
+        return Access::eNone;
+    case Layout::eColorAttachmentOptimal:
+        return Access::eColorAttachmentRead | Access::eColorAttachmentWrite;
+    case Layout::eDepthStencilAttachmentOptimal:
+    case Layout::eDepthAttachmentOptimal:
+    case Layout::eStencilAttachmentOptimal:
+        return Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite;
+    case Layout::eDepthStencilReadOnlyOptimal:
+    case Layout::eDepthReadOnlyOptimal:
+    case Layout::eStencilReadOnlyOptimal:
+        return Access::eDepthStencilAttachmentRead | Access::eShaderSampledRead;
+    case Layout::eShaderReadOnlyOptimal:
+        return Access::eShaderSampledRead;
+    case Layout::eTransferSrcOptimal:
+        return Access::eTransferRead;
+    case Layout::eTransferDstOptimal:
+        return Access::eTransferWrite;
+    default:
+        return Access::eMemoryRead | Access::eMemoryWrite;
     }
 }
 
@@ -127,53 +209,65 @@ Image::Image(
     vk::ImageAspectFlags aspectMask,
     uint32_t             mipLevelCount,
     uint32_t             arrayLayerCount,
-    vk::ImageLayout      initialLayout
+    vk::ImageLayout      initialLayout,
+    vk::ImageUsageFlags  usage
 ) : m_image(image),
     m_format(format),
     m_extent(extent),
     m_aspectMask(aspectMask),
+    m_usage(usage),
     m_arrayLayerCount(arrayLayerCount),
     m_mipLevelCount(mipLevelCount),
     m_imageLayouts(mipLevelCount * arrayLayerCount, initialLayout)
 {}
 
-void Image::generateMipMap(vk::CommandBuffer cmd, uint32_t baseArrayLayer, int32_t layerCount) {
+void Image::generateMipMap(
+    vk::CommandBuffer cmd, uint32_t baseArrayLayer, int32_t layerCount,
+    ResourceScope* p_scope, MipGenerator::Filter filter
+) {
     if (layerCount < 0) layerCount = m_arrayLayerCount - baseArrayLayer;
 
-    bool async = cmd != VK_NULL_HANDLE;
+    // without a command buffer the mips are recorded into the upload engine's open batch, which is waited on,
+    // so the dispatch's resources can be cleaned up on return
+    ResourceScope dispatchScope { "Image::generateMipMap dispatch" };
+    if (!cmd) p_scope = &dispatchScope;
 
-    ResourceScope localScope { "Image::generateMipMap" };
     auto& engine = IEngine::get();
-    vk::Device device = engine.getDevice();
-    vk::Fence fence;
+    MipGenerator& mipGenerator = engine.getMipGenerator();
 
-    if (!cmd) cmd = engine.beginOneTimeCommandBuffer(vkb::QueueType::graphics);
-    
-    if (!async) {
-        fence = device.createFence(vk::FenceCreateInfo {});
-        localScope.addDeferredCleanupFunction([=]() {
-            auto _ = device.waitForFences(fence, true, UINT64_MAX);
-            device.destroyFence(fence);
-        });
-    }
+    // prepared before recording, since the upload engine is locked while its commands are recorded
+    MipGenerator::Target target;
+    if (p_scope && mipGenerator.supports(*this)) target = mipGenerator.prepare(*p_scope, *this);
+    else if (filter != MipGenerator::Filter::Average)
+        IGNIS_LOG("Image", Warning, "Only compute mip generation has filters other than Average, these mips are blitted");
+
+    auto record = [&](vk::CommandBuffer cmd) {
+        if (target.isValid()) mipGenerator.record(cmd, target, filter, 4.0f, baseArrayLayer, layerCount);
+        else                  recordBlitMipMap(cmd);
+    };
+
+    if (cmd) record(cmd);
+    else     engine.getUploadEngine().recordGraphicsCommands(record).wait();
+}
 
-    transitionLayout()
-        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-        .setDstStageMask(vk::PipelineStageFlagBits::eTransfer)
-        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
-        .execute(cmd);
+void Image::recordBlitMipMap(vk::CommandBuffer cmd) {
+    // the first blit reads the top level, and every other level is written by the blit before it
+    BarrierBatch barriers;
+
+    transitionLayout(0, 1)
+        .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+        .execute(barriers);
+
+    if (m_mipLevelCount > 1)
+        transitionLayout(1)
+            .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+            .execute(barriers);
+
+    barriers.flush(cmd);
 
     glm::ivec2 srcImageSize { m_extent.width, m_extent.height };
 
     for (int level = 0; level < m_mipLevelCount - 1; level++) {
-        transitionLayout(level, 1)
-            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eTransfer)
-            .setDstStageMask(vk::PipelineStageFlagBits::eTransfer)
-            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-            .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
-            .execute(cmd);
-        
         glm::ivec2 dstImageSize = srcImageSize / 2;
         
         cmd.blitImage(
@@ -193,17 +287,13 @@ void Image::generateMipMap(vk::CommandBuffer cmd, uint32_t baseArrayLayer, int32
             vk::Filter::eLinear
         );
 
+        // the next blit reads this level, and the last is left in the same layout as the rest of the image
+        transitionLayout(level + 1, 1)
+            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .execute(cmd);
+
         srcImageSize = dstImageSize;
     }
-
-    // make sure we keep the last image in the same layout as the rest of the image
-    transitionLayout(m_mipLevelCount - 1, 1)
-        .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
-        .setDstStageMask(vk::PipelineStageFlagBits::eTransfer)
-        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
-        .execute(cmd);
-
-    if (!async) engine.submitOneTimeCommandBuffer(cmd, vkb::QueueType::graphics, vk::SubmitInfo {}, fence);
 }
 
 vk::ImageLayout& Image::getLayout(uint32_t mipLevel, uint32_t arrayLayer) {
@@ -262,6 +352,11 @@ ImageBuilder& ImageBuilder::addUsage(vk::ImageUsageFlags usage) {
     return *this;
 }
 
+ImageBuilder& ImageBuilder::addFlags(vk::ImageCreateFlags flags) {
+    m_flags |= flags;
+    return *this;
+}
+
 ImageBuilder& ImageBuilder::setQueueFamilyIndices(std::vector<uint32_t> indices) {
     m_queueFamilyIndices = indices;
     return *this;
@@ -299,20 +394,39 @@ ImageBuilder& ImageBuilder::setAutoMipMapMode(ImageBuilder::AutoMipMapMode mode)
     return *this;
 }
 
+ImageBuilder& ImageBuilder::setMipFilter(MipGenerator::Filter filter) {
+    m_mipFilter = filter;
+    return *this;
+}
+
 Allocated<Image> ImageBuilder::build() {
     if (m_autoMipMapMode >= Create) {
         uint32_t sideLength = std::max(m_extent.width, m_extent.height);
         m_mipLevelCount = std::floor(std::log2(sideLength));
     }
 
-    if (m_autoMipMapMode >= Initialise)
-        addUsage(vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+    // generated in one compute dispatch where possible, otherwise blitted a level at a time
+    if (m_autoMipMapMode >= Initialise) {
+        if (IEngine::get().getMipGenerator().supports(m_format, m_extent)) {
+            addUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+
+            if (MipGenerator::getStorageFormat(m_format) != m_format)
+                addFlags(vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage);
+        } else {
+            addUsage(vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+        }
+    }
+
+    std::vector<uint32_t> queueFamilyIndices = uniqueQueueFamilyIndices(m_queueFamilyIndices);
+    if (queueFamilyIndices.size() < 2) queueFamilyIndices.clear();
 
     VkImageCreateInfo imageCreateInfo = vk::ImageCreateInfo {}
+        .setFlags(m_flags)
         .setMipLevels(m_mipLevelCount)
         .setArrayLayers(m_arrayLayerCount)
         .setFormat(m_format)
-        .setQueueFamilyIndices(m_queueFamilyIndices)
+        .setSharingMode(queueFamilyIndices.empty() ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent)
+        .setQueueFamilyIndices(queueFamilyIndices)
         .setUsage(m_usage)
         .setExtent(m_extent)
         .setImageType(m_imageType)
@@ -328,9 +442,9 @@ Allocated<Image> ImageBuilder::build() {
     VmaAllocationInfo allocationInfo;
     vmaCreateImage(getAllocator(), &imageCreateInfo, &allocationCreateInfo, &image, &allocation, &allocationInfo);
 
-    r_scope.addDeferredCleanupFunction([=, allocator = getAllocator()]() {
-        vmaDestroyImage(allocator, image, allocation);
-    });
+    r_scope.addDeferredDestroy(getAllocator(), vk::Image { image }, allocation);
+
+    r_scope.trackAllocation(allocationInfo.size);
 
     Allocated<Image> ret = Allocated { Image {
         image,
@@ -338,7 +452,9 @@ Allocated<Image> ImageBuilder::build() {
         m_extent,
         m_aspectMask,
         m_mipLevelCount,
-        m_arrayLayerCount
+        m_arrayLayerCount,
+        vk::ImageLayout::eUndefined,
+        m_usage
     }, allocation };
 
     if (m_initialLayout != vk::ImageLayout::eUndefined)
@@ -349,7 +465,209 @@ Allocated<Image> ImageBuilder::build() {
     return ret;
 }
 
-Allocated<Image> ImageBuilder::load(const char* filename) {
+namespace {
+
+struct MipChainFile {
+    vk::Format                  format = vk::Format::eUndefined;
+    uint32_t                    width  = 0;
+    uint32_t                    height = 0;
+    std::vector<vk::DeviceSize> levelOffsets;
+};
+
+template<typename T>
+T readAt(const std::vector<char>& file, size_t offset) {
+    if (offset + sizeof(T) > file.size()) throw std::runtime_error("Image file is truncated");
+
+    T value;
+    std::memcpy(&value, file.data() + offset, sizeof(T));
+    return value;
+}
+
+constexpr uint32_t fourCC(const char (&code)[5]) {
+    return uint32_t(uint8_t(code[0])) | uint32_t(uint8_t(code[1])) << 8 | uint32_t(uint8_t(code[2])) << 16 | uint32_t(uint8_t(code[3])) << 24;
+}
+
+vk::Format getDXGIFormat(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case 28: return vk::Format::eR8G8B8A8Unorm;
+    case 29: return vk::Format::eR8G8B8A8Srgb;
+    case 71: return vk::Format::eBc1RgbaUnormBlock;
+    case 72: return vk::Format::eBc1RgbaSrgbBlock;
+    case 77: return vk::Format::eBc3UnormBlock;
+    case 78: return vk::Format::eBc3SrgbBlock;
+    case 80: return vk::Format::eBc4UnormBlock;
+    case 81: return vk::Format::eBc4SnormBlock;
+    case 83: return vk::Format::eBc5UnormBlock;
+    case 84: return vk::Format::eBc5SnormBlock;
+    case 98: return vk::Format::eBc7UnormBlock;
+    case 99: return vk::Format::eBc7SrgbBlock;
+    default: return vk::Format::eUndefined;
+    }
+}
+
+/**
+ * @brief Legacy DDS headers don't say whether colour is sRGB, so `srgb` picks for them
+ */
+MipChainFile parseDDS(const std::vector<char>& file, bool srgb) {
+    constexpr size_t s_headerSize = 128;
+    constexpr size_t s_dx10HeaderSize = 20;
+
+    if (readAt<uint32_t>(file, 0) != fourCC("DDS ")) throw std::runtime_error("Not a DDS file");
+
+    MipChainFile ret;
+    ret.height = readAt<uint32_t>(file, 12);
+    ret.width = readAt<uint32_t>(file, 16);
+
+    uint32_t levelCount = std::max(readAt<uint32_t>(file, 28), 1u);
+    uint32_t pixelFormatFlags = readAt<uint32_t>(file, 80);
+    uint32_t code = readAt<uint32_t>(file, 84);
+    uint32_t caps2 = readAt<uint32_t>(file, 112);
+
+    constexpr uint32_t s_fourCCFlag = 0x4;
+    constexpr uint32_t s_rgbFlag = 0x40;
+    constexpr uint32_t s_cubemapFlag = 0x200;
+    constexpr uint32_t s_volumeFlag = 0x200000;
+
+    if (caps2 & (s_cubemapFlag | s_volumeFlag)) throw std::runtime_error("Cubemap and volume DDS files are not supported");
+
+    size_t dataOffset = s_headerSize;
+
+    if ((pixelFormatFlags & s_fourCCFlag) && code == fourCC("DX10")) {
+        ret.format = getDXGIFormat(readAt<uint32_t>(file, s_headerSize));
+        if (readAt<uint32_t>(file, s_headerSize + 12) > 1) throw std::runtime_error("DDS texture arrays are not supported");
+        dataOffset += s_dx10HeaderSize;
+    } else if (pixelFormatFlags & s_fourCCFlag) {
+        if      (code == fourCC("DXT1"))                              ret.format = srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+        else if (code == fourCC("DXT5"))                              ret.format = srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+        else if (code == fourCC("ATI1") || code == fourCC("BC4U"))    ret.format = vk::Format::eBc4UnormBlock;
+        else if (code == fourCC("BC4S"))                              ret.format = vk::Format::eBc4SnormBlock;
+        else if (code == fourCC("ATI2") || code == fourCC("BC5U"))    ret.format = vk::Format::eBc5UnormBlock;
+        else if (code == fourCC("BC5S"))                              ret.format = vk::Format::eBc5SnormBlock;
+    } else if ((pixelFormatFlags & s_rgbFlag) && readAt<uint32_t>(file, 88) == 32 && readAt<uint32_t>(file, 92) == 0xff) {
+        ret.format = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    }
+
+    if (ret.format == vk::Format::eUndefined) throw std::runtime_error("Unsupported DDS pixel format");
+
+    // the levels are stored largest first, back to back
+    FormatBlockInfo block = getFormatBlockInfo(ret.format);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        ret.levelOffsets.push_back(dataOffset);
+        dataOffset += block.getSize(std::max(ret.width >> level, 1u), std::max(ret.height >> level, 1u));
+    }
+
+    return ret;
+}
+
+MipChainFile parseKTX2(const std::vector<char>& file) {
+    static constexpr std::array<uint8_t, 12> s_identifier { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr size_t s_levelIndexOffset = 80;
+    constexpr size_t s_levelIndexStride = 24;
+
+    if (file.size() < s_identifier.size() || std::memcmp(file.data(), s_identifier.data(), s_identifier.size()) != 0)
+        throw std::runtime_error("Not a KTX2 file");
+
+    MipChainFile ret;
+    ret.format = static_cast<vk::Format>(readAt<uint32_t>(file, 12));
+    ret.width = readAt<uint32_t>(file, 20);
+    ret.height = readAt<uint32_t>(file, 24);
+
+    uint32_t depth = readAt<uint32_t>(file, 28);
+    uint32_t layerCount = readAt<uint32_t>(file, 32);
+    uint32_t faceCount = readAt<uint32_t>(file, 36);
+    uint32_t levelCount = std::max(readAt<uint32_t>(file, 40), 1u);
+    uint32_t supercompressionScheme = readAt<uint32_t>(file, 44);
+
+    // an undefined format is a Basis Universal texture, which would need transcoding
+    if (ret.format == vk::Format::eUndefined || supercompressionScheme != 0)
+        throw std::runtime_error("Supercompressed KTX2 files are not supported");
+
+    if (depth > 1 || layerCount > 1 || faceCount > 1)
+        throw std::runtime_error("Only 2D KTX2 textures are supported");
+
+    for (uint32_t level = 0; level < levelCount; level++)
+        ret.levelOffsets.push_back(readAt<uint64_t>(file, s_levelIndexOffset + level * s_levelIndexStride));
+
+    return ret;
+}
+
+bool isSrgb(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc7SrgbBlock:
+        return true;
+    default:
+        return false;
+    }
+}
+
+}
+
+FormatBlockInfo getFormatBlockInfo(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR8Unorm:
+        return { 1, 1, 1 };
+    case vk::Format::eR8G8Unorm:
+        return { 1, 1, 2 };
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eR8G8B8A8Snorm:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+        return { 1, 1, 4 };
+    case vk::Format::eR16G16B16A16Sfloat:
+        return { 1, 1, 8 };
+    case vk::Format::eR32G32B32A32Sfloat:
+        return { 1, 1, 16 };
+    case vk::Format::eBc1RgbUnormBlock:
+    case vk::Format::eBc1RgbSrgbBlock:
+    case vk::Format::eBc1RgbaUnormBlock:
+    case vk::Format::eBc1RgbaSrgbBlock:
+    case vk::Format::eBc4UnormBlock:
+    case vk::Format::eBc4SnormBlock:
+        return { 4, 4, 8 };
+    case vk::Format::eBc3UnormBlock:
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc5UnormBlock:
+    case vk::Format::eBc5SnormBlock:
+    case vk::Format::eBc7UnormBlock:
+    case vk::Format::eBc7SrgbBlock:
+        return { 4, 4, 16 };
+    default:
+        return {};
+    }
+}
+
+Allocated<Image> ImageBuilder::load(const char* filename, UploadToken* p_token) {
+    std::string_view extension = filename;
+    extension = extension.substr(std::min(extension.find_last_of('.'), extension.size()));
+
+    if (extension == ".dds" || extension == ".DDS" || extension == ".ktx2" || extension == ".KTX2") {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open image file: " + std::string { filename });
+
+        size_t filesize = file.tellg();
+        std::vector<char> bytes(filesize);
+        file.seekg(0);
+        file.read(bytes.data(), filesize);
+
+        MipChainFile mipChain = extension == ".dds" || extension == ".DDS"
+            ? parseDDS(bytes, isSrgb(m_format))
+            : parseKTX2(bytes);
+
+        setFormat(mipChain.format);
+        auto ret = loadMipChain(bytes.data(), bytes.size(), mipChain.width, mipChain.height, mipChain.levelOffsets, p_token);
+        IGNIS_LOG("Image", Info, "Loaded " << vk::to_string(mipChain.format) << " image file " << filename
+            << " with " << mipChain.levelOffsets.size() << " mip levels");
+
+        return ret;
+    }
+
     ResourceScope tempScope { "ImageBuilder::load("+std::string(filename)+")", true };
 
     int width, height, channels;
@@ -357,67 +675,78 @@ Allocated<Image> ImageBuilder::load(const char* filename) {
     tempScope.addDeferredCleanupFunction([=]() { stbi_image_free(data); });
 
     if (!data) throw std::runtime_error(std::string("Failed to open file") + std::string(filename));
-    auto ret = load(data, width, height);
+    auto ret = load(data, width, height, p_token);
     IGNIS_LOG("Image", Info, "Loaded image file" << filename);
 
     return ret;
 }
 
-Allocated<Image> ImageBuilder::load(const void* data, uint32_t width, uint32_t height) {
-    ResourceScope tempScope { "ImageBuilder::load(data, width, height)" };
+Allocated<Image> ImageBuilder::load(const void* data, uint32_t width, uint32_t height, UploadToken* p_token) {
+    auto ret = loadMipChain(data, vk::DeviceSize { width } * height * 4, width, height, { 0 }, p_token);
+
+    IGNIS_LOG("Image", Info, "Loaded image from bytes");
+
+    return ret;
+}
+
+Allocated<Image> ImageBuilder::loadMipChain(
+    const void* data, vk::DeviceSize size, uint32_t width, uint32_t height,
+    const std::vector<vk::DeviceSize>& levelOffsets, UploadToken* p_token
+) {
+    FormatBlockInfo block = getFormatBlockInfo(m_format);
+
+    if (block.bytesPerBlock == 0)
+        throw std::runtime_error("Can't load images in format " + vk::to_string(m_format));
+
+    if (block.isCompressed() && !IEngine::get().supportsBlockCompression())
+        throw std::runtime_error("Can't load " + vk::to_string(m_format) + " images, BC texture compression is not supported");
+
+    // mips can't be generated in block compressed formats, by blitting or by compute, so their chains must be pre-built
+    if (levelOffsets.size() > 1 || block.isCompressed()) {
+        if (m_autoMipMapMode != None && levelOffsets.size() == 1)
+            IGNIS_LOG("Image", Warning, "Can't generate mips for " << vk::to_string(m_format) << " images, only the top level is loaded");
+
+        m_autoMipMapMode = None;
+        m_mipLevelCount = static_cast<uint32_t>(levelOffsets.size());
+    }
 
     setSize({ width, height, 1 });
     addUsage(vk::ImageUsageFlagBits::eTransferDst);
+
+    // the upload transitions the image to its initial layout itself, once the data is in place
+    vk::ImageLayout finalLayout = m_initialLayout == vk::ImageLayout::eUndefined
+        ? vk::ImageLayout::eShaderReadOnlyOptimal
+        : m_initialLayout;
+
+    m_initialLayout = vk::ImageLayout::eUndefined;
     Allocated<Image> ret = build();
+    m_initialLayout = finalLayout;
 
-    ignis::Allocated<vk::Buffer> stagingBuffer = getValue(BufferBuilder { tempScope }
-        .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
-        .setBufferUsage(vk::BufferUsageFlagBits::eTransferSrc)
-        .setSizeBuildAndCopyData(static_cast<const uint8_t*>(data), width * height * 4),
-        "Failed to create staging buffer for image load");
-    
-    IEngine& engine = IEngine::get();
-    vk::Device device = engine.getDevice();
-    
-    vk::Fence fence = device.createFence(vk::FenceCreateInfo {});
-    tempScope.addDeferredCleanupFunction([=]() { device.destroyFence(fence); });
-    
-    vk::CommandBuffer cmd = engine.beginOneTimeCommandBuffer(vkb::QueueType::graphics);
-
-    ret.m_inner.transitionLayout()
-        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
-        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
-        .setDstStageMask(vk::PipelineStageFlagBits::eTransfer)
-        .execute(cmd);
-
-    cmd.copyBufferToImage(
-        *stagingBuffer,
-        ret.m_inner.getImage(),
-        vk::ImageLayout::eTransferDstOptimal,
-        vk::BufferImageCopy {}
-            .setBufferImageHeight(height)
-            .setBufferRowLength(width)
-            .setImageExtent(ret.m_inner.getExtent())
+    // levels are tightly packed, and a level's extent may stop part way through its last row or column of blocks
+    std::vector<vk::BufferImageCopy> regions;
+    for (uint32_t level = 0; level < levelOffsets.size(); level++) {
+        glm::uvec3 levelSize = ret.m_inner.getSize(level);
+
+        if (levelOffsets[level] + block.getSize(levelSize.x, levelSize.y) > size)
+            throw std::runtime_error("Image data is too small for mip level " + std::to_string(level));
+
+        regions.push_back(vk::BufferImageCopy {}
+            .setBufferOffset(levelOffsets[level])
+            .setImageExtent({ levelSize.x, levelSize.y, 1 })
             .setImageSubresource(vk::ImageSubresourceLayers {}
                 .setAspectMask(ret.m_inner.getAspectMask())
+                .setMipLevel(level)
                 .setLayerCount(1)));
+    }
 
-    if (m_autoMipMapMode == Initialise)
-        ret.m_inner.generateMipMap(cmd);
-    
-    ret.m_inner.transitionLayout()
-        .setNewLayout(m_initialLayout)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eTransfer)
-        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-        .setDstStageMask(vk::PipelineStageFlagBits::eAllCommands)
-        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
-        .execute(cmd);
-
-    engine.submitOneTimeCommandBuffer(cmd, vkb::QueueType::graphics, vk::SubmitInfo {}, fence);
-
-    vk::resultCheck(device.waitForFences(fence, true, UINT64_MAX), "Failed to wait for image load fence");
+    UploadToken token = getValue(IEngine::get().getUploadEngine().uploadImage(
+        ret.m_inner, data, size, regions, finalLayout,
+        m_autoMipMapMode == Initialise,
+        uniqueQueueFamilyIndices(m_queueFamilyIndices).size() > 1,
+        m_mipFilter),
+        "Failed to upload image data");
 
-    IGNIS_LOG("Image", Info, "Loaded image from bytes");
+    if (p_token) *p_token = token;
 
     return ret;
 }
@@ -433,6 +762,11 @@ ImageViewBuilder::ImageViewBuilder(
     m_aspectMask = image.getAspectMask();
 }
 
+ImageViewBuilder& ImageViewBuilder::setFormat(vk::Format format) {
+    m_format = format;
+    return *this;
+}
+
 ImageViewBuilder& ImageViewBuilder::setComponentMapping(vk::ComponentMapping mapping) {
     m_components = mapping;
     return *this;
@@ -462,7 +796,7 @@ ImageViewBuilder& ImageViewBuilder::setMipLevelRange(uint32_t base, uint32_t cou
 
 vk::ImageView ImageViewBuilder::build() {
     vk::ImageView imageView = getDevice().createImageView(vk::ImageViewCreateInfo {}
-        .setFormat(r_image.getFormat())
+        .setFormat(m_format.value_or(r_image.getFormat()))
         .setImage(r_image.getImage())
         .setComponents(m_components)
         .setViewType(m_viewType)
@@ -474,9 +808,7 @@ vk::ImageView ImageViewBuilder::build() {
             .setLevelCount(m_mipLevelCount))
         );
     
-    r_scope.addDeferredCleanupFunction([=, device = getDevice()]() {
-        device.destroyImageView(imageView);
-    });
+    r_scope.addDeferredDestroy(getDevice(), imageView);
     
     return imageView;
 }
@@ -0,0 +1,257 @@
+#include "mipGenerator.hpp"
+#include "engine.hpp"
+#include "image.hpp"
+#include "bufferBuilder.hpp"
+#include "uniformBuilder.hpp"
+#include "log.hpp"
+
+#include <bit>
+
+namespace ignis {
+
+void MipGenerator::setup(ResourceScope& scope) {
+    auto& engine = IEngine::get();
+    vk::Device device = engine.getDevice();
+    vk::PhysicalDevice physicalDevice = engine.getPhysicalDevice();
+
+    // one shader writes every format, and picks each level's image at runtime
+    vk::PhysicalDeviceFeatures features = physicalDevice.getFeatures();
+    if (!features.shaderStorageImageWriteWithoutFormat || !features.shaderStorageImageArrayDynamicIndexing) {
+        IGNIS_LOG("Mip Generator", Warning, "Compute mip generation is not supported, mips are generated by blitting");
+        return;
+    }
+
+    m_storageAlignment = physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+
+    m_setLayout = DescriptorLayoutBuilder { scope }
+        .addBinding(vk::DescriptorSetLayoutBinding {}
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute))
+        .addBinding(vk::DescriptorSetLayoutBinding {}
+            .setBinding(1)
+            .setDescriptorCount(s_maxGeneratedLevelCount)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute))
+        .addBinding(vk::DescriptorSetLayoutBinding {}
+            .setBinding(2)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute))
+        .addBinding(vk::DescriptorSetLayoutBinding {}
+            .setBinding(3)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute))
+        .build();
+
+    // the top level is read with texelFetch, so filtering never applies
+    m_sampler = device.createSampler(vk::SamplerCreateInfo {}
+        .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+        .setMinFilter(vk::Filter::eNearest)
+        .setMagFilter(vk::Filter::eNearest));
+
+    scope.addDeferredDestroy(device, m_sampler);
+
+    m_pipeline = getValue(ComputePipelineBuilder { scope }
+        .setPipelineLayout(PipelineLayoutBuilder { scope }
+            .addSet(m_setLayout)
+            .addPushConstantRange(vk::PushConstantRange {}
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                .setSize(sizeof(PushConstants)))
+            .build())
+        .setShaderModuleFromFile("shaders/mipGenerate.comp.spv")
+        .build(), "Failed to build mip generation pipeline");
+}
+
+vk::Format MipGenerator::getStorageFormat(vk::Format format) {
+    switch (format) {
+    case vk::Format::eR8G8B8A8Srgb:       return vk::Format::eR8G8B8A8Unorm;
+    case vk::Format::eB8G8R8A8Srgb:       return vk::Format::eB8G8R8A8Unorm;
+    case vk::Format::eA8B8G8R8SrgbPack32: return vk::Format::eA8B8G8R8UnormPack32;
+    default:                              return format;
+    }
+}
+
+bool MipGenerator::supports(vk::Format format, vk::Extent3D extent) const {
+    if (!isReady() || extent.width > s_maxExtent || extent.height > s_maxExtent || extent.depth > 1) return false;
+
+    // every level must be exactly half the one above it, or the texels past the last even row or column of a
+    // level would never reach the levels below it. Blitting filters odd sizes properly
+    if (!std::has_single_bit(extent.width) || !std::has_single_bit(extent.height)) return false;
+
+    vk::PhysicalDevice physicalDevice = IEngine::get().getPhysicalDevice();
+    vk::FormatFeatureFlags sampledFeatures = physicalDevice.getFormatProperties(format).optimalTilingFeatures;
+    vk::FormatFeatureFlags storageFeatures = physicalDevice.getFormatProperties(getStorageFormat(format)).optimalTilingFeatures;
+
+    return (sampledFeatures & vk::FormatFeatureFlagBits::eSampledImage)
+        && (storageFeatures & vk::FormatFeatureFlagBits::eStorageImage);
+}
+
+bool MipGenerator::supports(Image& image) const {
+    constexpr vk::ImageUsageFlags s_requiredUsage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+
+    return (image.getUsage() & s_requiredUsage) == s_requiredUsage
+        && supports(image.getFormat(), image.getExtent());
+}
+
+MipGenerator::Target MipGenerator::prepare(ResourceScope& scope, Image& image) {
+    Target ret { .p_image = &image };
+
+    uint32_t generatedLevelCount = std::min(image.getMipLevelCount() - 1, s_maxGeneratedLevelCount);
+    if (generatedLevelCount == 0) return ret;
+
+    vk::Format storageFormat = getStorageFormat(image.getFormat());
+    ret.srgb = storageFormat != image.getFormat();
+
+    vk::ImageView sourceView = ImageViewBuilder { image, scope }
+        .setViewType(vk::ImageViewType::e2DArray)
+        .setMipLevelRange(0, 1)
+        .build();
+
+    std::vector<vk::ImageView> levelViews;
+    for (uint32_t level = 1; level <= generatedLevelCount; level++)
+        levelViews.push_back(ImageViewBuilder { image, scope }
+            .setFormat(storageFormat)
+            .setViewType(vk::ImageViewType::e2DArray)
+            .setMipLevelRange(level, 1)
+            .build());
+
+    // every element of the array must be valid, but the shader never writes past the image's own levels
+    std::vector<vk::DescriptorImageInfo> levelInfos;
+    for (uint32_t level = 1; level <= s_maxGeneratedLevelCount; level++)
+        levelInfos.push_back(vk::DescriptorImageInfo {}
+            .setImageLayout(vk::ImageLayout::eGeneral)
+            .setImageView(levelViews[std::min(level, generatedLevelCount) - 1]));
+
+    glm::uvec2 tileCount = (glm::uvec2 { image.getExtent().width, image.getExtent().height } + s_tileSize - 1u) / s_tileSize;
+    uint32_t layerCount = image.getArrayLayerCount();
+
+    vk::DeviceSize countersSize = sizeof(uint32_t) * layerCount;
+    vk::DeviceSize texelsOffset = (countersSize + m_storageAlignment - 1) / m_storageAlignment * m_storageAlignment;
+    vk::DeviceSize texelsSize = sizeof(glm::vec4) * tileCount.x * tileCount.y * layerCount;
+
+    ret.scratch = getValue(BufferBuilder { scope }
+        .setAllocationUsage(VMA_MEMORY_USAGE_GPU_ONLY)
+        .setBufferUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst)
+        .setSize(static_cast<uint32_t>(texelsOffset + texelsSize))
+        .build(), "Failed to create mip generation scratch buffer").m_inner;
+
+    vk::DescriptorPool pool = DescriptorPoolBuilder { scope }
+        .setMaxSetCount(1)
+        .addPoolSize({ vk::DescriptorType::eCombinedImageSampler, 1 })
+        .addPoolSize({ vk::DescriptorType::eStorageImage, s_maxGeneratedLevelCount })
+        .addPoolSize({ vk::DescriptorType::eStorageBuffer, 2 })
+        .build();
+
+    ret.uniform = UniformBuilder { scope, pool }
+        .addLayouts(m_setLayout)
+        .build();
+
+    Uniform::updateUniforms({
+        ret.uniform.update(vk::DescriptorType::eCombinedImageSampler, 0, 0)
+            .addImageInfo(vk::DescriptorImageInfo {}
+                .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                .setImageView(sourceView)
+                .setSampler(m_sampler)),
+        ret.uniform.update(vk::DescriptorType::eStorageImage, 0, 1)
+            .setImageInfos(levelInfos),
+        ret.uniform.update(vk::DescriptorType::eStorageBuffer, 0, 2)
+            .addBufferInfo(vk::DescriptorBufferInfo { ret.scratch, 0, countersSize }),
+        ret.uniform.update(vk::DescriptorType::eStorageBuffer, 0, 3)
+            .addBufferInfo(vk::DescriptorBufferInfo { ret.scratch, texelsOffset, texelsSize }),
+    });
+
+    return ret;
+}
+
+glm::vec2 MipGenerator::getKaiserWeights(float alpha) {
+    // zeroth order modified Bessel function of the first kind, its series converges long before 16 terms
+    auto besselI0 = [](float x) {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 16; k++) {
+            term *= (x * x / 4.0f) / (k * k);
+            sum += term;
+        }
+        return sum;
+    };
+
+    // taps are 0.5 and 1.5 texels from the centre of a 4 texel wide kernel, and the cutoff is half the source rate
+    auto weight = [&](float distance) {
+        float x = distance / 2.0f;
+        float sinc = glm::sin(glm::pi<float>() * x) / (glm::pi<float>() * x);
+        float window = besselI0(alpha * glm::sqrt(1.0f - x * x)) / besselI0(alpha);
+        return sinc * window;
+    };
+
+    glm::vec2 weights { weight(1.5f), weight(0.5f) };
+    return weights / (2.0f * (weights.x + weights.y));
+}
+
+void MipGenerator::record(
+    vk::CommandBuffer cmd, Target& target,
+    Filter filter, float kaiserAlpha,
+    uint32_t baseArrayLayer, int32_t layerCount
+) {
+    Image& image = *target.p_image;
+    uint32_t generatedLevelCount = std::min(image.getMipLevelCount() - 1, s_maxGeneratedLevelCount);
+    if (generatedLevelCount == 0) return;
+
+    if (layerCount < 0) layerCount = image.getArrayLayerCount() - baseArrayLayer;
+
+    // the counters start at zero, and each dispatch's last workgroup leaves them that way for the next
+    if (!target.scratchCleared) {
+        cmd.fillBuffer(target.scratch, 0, VK_WHOLE_SIZE, 0);
+        target.scratchCleared = true;
+    }
+
+    BarrierBatch barriers;
+
+    // the previous dispatch must have read its scratch texels before this one overwrites them
+    barriers.addBufferBarrier(vk::BufferMemoryBarrier2 {}
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eClear)
+        .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+        .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setBuffer(target.scratch)
+        .setSize(VK_WHOLE_SIZE));
+
+    if (!image.layoutIs(vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1, baseArrayLayer, layerCount))
+        image.transitionLayout(0, 1, baseArrayLayer, layerCount)
+            .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .execute(barriers);
+
+    if (!image.layoutIs(vk::ImageLayout::eGeneral, 1, generatedLevelCount, baseArrayLayer, layerCount))
+        image.transitionLayout(1, generatedLevelCount, baseArrayLayer, layerCount)
+            .setNewLayout(vk::ImageLayout::eGeneral)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .execute(barriers);
+
+    barriers.flush(cmd);
+
+    glm::ivec2 sourceSize { image.getExtent().width, image.getExtent().height };
+    glm::ivec2 tileCount = (sourceSize + int(s_tileSize) - 1) / int(s_tileSize);
+
+    PushConstants pushConstants {
+        .sourceSize     = sourceSize,
+        .tileCount      = tileCount,
+        .levelCount     = generatedLevelCount,
+        .filter         = static_cast<uint32_t>(filter),
+        .srgb           = target.srgb,
+        .baseArrayLayer = baseArrayLayer,
+        .kaiserWeights  = getKaiserWeights(kaiserAlpha),
+    };
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline.layout, 0, target.uniform.getSet(), {});
+    cmd.pushConstants<PushConstants>(m_pipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+    cmd.dispatch(tileCount.x, tileCount.y, layerCount);
+}
+
+}
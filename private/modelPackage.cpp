@@ -0,0 +1,790 @@
+#include "modelPackage.hpp"
+#include "blockCompression.hpp"
+
+#include <glm/gtx/matrix_decompose.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <unordered_map>
+
+namespace ignis {
+
+bool readFloatAccessor(const gltf::Model& model, int accessorID, int componentCount, std::vector<float>& out) {
+    auto& accessor = model.accessors[accessorID];
+
+    if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || gltf::GetNumComponentsInType(accessor.type) != componentCount)
+        return false;
+
+    out.assign(accessor.count * componentCount, 0.0f);
+
+    // accessors without a buffer view are all zeros
+    if (accessor.bufferView < 0) return true;
+
+    auto& bufferView = model.bufferViews[accessor.bufferView];
+    auto& buffer = model.buffers[bufferView.buffer];
+
+    int stride = accessor.ByteStride(bufferView);
+    if (stride <= 0) return false;
+
+    const uint8_t* src = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+    for (size_t i = 0; i < accessor.count; i++)
+        std::memcpy(&out[i * componentCount], src + i * stride, componentCount * sizeof(float));
+
+    return true;
+}
+
+bool readIndices(const gltf::Model& model, int accessorID, std::vector<uint32_t>& out) {
+    auto& accessor = model.accessors[accessorID];
+    if (accessor.bufferView < 0) return false;
+
+    auto& bufferView = model.bufferViews[accessor.bufferView];
+    auto& buffer = model.buffers[bufferView.buffer];
+
+    int stride = accessor.ByteStride(bufferView);
+    if (stride <= 0) return false;
+
+    const uint8_t* src = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+    out.resize(accessor.count);
+
+    for (size_t i = 0; i < accessor.count; i++) switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:  out[i] = src[i * stride]; break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: out[i] = *reinterpret_cast<const uint16_t*>(src + i * stride); break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:   out[i] = *reinterpret_cast<const uint32_t*>(src + i * stride); break;
+    default: return false;
+    }
+
+    return true;
+}
+
+namespace {
+
+constexpr uint32_t slotBit(ModelPackage::TextureSlot slot) { return 1u << slot; }
+
+float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * @brief Halve an RGBA8 level with a box filter, averaging sRGB colour in linear space
+ */
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, bool srgb) {
+    static const std::array<float, 256> s_srgbToLinear = []() {
+        std::array<float, 256> ret;
+        for (uint32_t i = 0; i < 256; i++) ret[i] = srgbToLinear(i / 255.0f);
+        return ret;
+    }();
+
+    uint32_t dstWidth = std::max(width / 2, 1u);
+    uint32_t dstHeight = std::max(height / 2, 1u);
+    std::vector<uint8_t> dst(size_t { dstWidth } * dstHeight * 4);
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+    for (uint32_t x = 0; x < dstWidth; x++) {
+        glm::vec4 sum { 0.0f };
+
+        for (uint32_t dy = 0; dy < 2; dy++)
+        for (uint32_t dx = 0; dx < 2; dx++) {
+            uint32_t srcX = std::min(x * 2 + dx, width - 1);
+            uint32_t srcY = std::min(y * 2 + dy, height - 1);
+            const uint8_t* texel = &src[(size_t { srcY } * width + srcX) * 4];
+
+            for (uint32_t channel = 0; channel < 4; channel++)
+                sum[channel] += srgb && channel < 3 ? s_srgbToLinear[texel[channel]] : texel[channel] / 255.0f;
+        }
+
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            float value = sum[channel] / 4.0f;
+            if (srgb && channel < 3) value = linearToSrgb(value);
+            dst[(size_t { y } * dstWidth + x) * 4 + channel] = uint8_t(std::round(glm::clamp(value, 0.0f, 1.0f) * 255.0f));
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * @brief BC1 unless the alpha channel is used, or only the red channel is, e.g. occlusion
+ */
+vk::Format chooseCompressedFormat(uint32_t slots, bool srgb, bool hasAlpha) {
+    if (slots & slotBit(ModelPackage::BaseColor))
+        return hasAlpha
+            ? (srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock)
+            : (srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock);
+
+    if (slots == slotBit(ModelPackage::Occlusion)) return vk::Format::eBc4UnormBlock;
+
+    // normal maps are BC1 too, as the shader reads all three channels, rather than reconstructing z for BC5
+    return srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+}
+
+std::vector<uint8_t> compressLevel(vk::Format format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    switch (format) {
+    case vk::Format::eBc3SrgbBlock:
+    case vk::Format::eBc3UnormBlock: return compressBC3(rgba.data(), width, height);
+    case vk::Format::eBc4UnormBlock: return compressBC4(rgba.data(), width, height);
+    default:                         return compressBC1(rgba.data(), width, height);
+    }
+}
+
+ModelPackage::Image cookImage(gltf::Image& image, uint32_t slots, const ModelPackage::CookOptions& options, std::vector<std::string>& warnings) {
+    ModelPackage::Image ret;
+    bool srgb = slots & (slotBit(ModelPackage::BaseColor) | slotBit(ModelPackage::Emissive));
+
+    ret.format = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    ret.width = image.width;
+    ret.height = image.height;
+    ret.levelOffsets = { 0 };
+    ret.data = std::move(image.image);
+
+    // images are decoded to 8 bit RGBA, anything else is replaced rather than read out of bounds
+    if (image.width <= 0 || image.height <= 0 || image.bits != 8 || ret.data.size() != size_t(image.width) * image.height * 4) {
+        warnings.push_back("Image " + image.name + " isn't 8 bit RGBA, and has been replaced with white");
+        ret.width = ret.height = 1;
+        ret.data = { 255, 255, 255, 255 };
+    }
+
+    if (!options.buildMipChains) return ret;
+
+    std::vector<std::vector<uint8_t>> levels;
+    levels.push_back(std::move(ret.data));
+
+    for (uint32_t width = ret.width, height = ret.height; width > 1 || height > 1; width = std::max(width / 2, 1u), height = std::max(height / 2, 1u))
+        levels.push_back(downsample(levels.back(), width, height, srgb));
+
+    if (options.compressTextures) {
+        bool hasAlpha = false;
+        for (size_t i = 3; i < levels[0].size() && !hasAlpha; i += 4) hasAlpha = levels[0][i] != 255;
+
+        ret.format = chooseCompressedFormat(slots, srgb, hasAlpha);
+
+        for (uint32_t level = 0; level < levels.size(); level++)
+            levels[level] = compressLevel(ret.format, levels[level], std::max(ret.width >> level, 1u), std::max(ret.height >> level, 1u));
+    }
+
+    ret.data.clear();
+    ret.levelOffsets.clear();
+
+    for (auto& level : levels) {
+        ret.levelOffsets.push_back(ret.data.size());
+        ret.data.insert(ret.data.end(), level.begin(), level.end());
+    }
+
+    return ret;
+}
+
+struct VertexKey {
+    std::array<float, 12> values {};
+
+    bool operator ==(const VertexKey& other) const { return std::memcmp(values.data(), other.values.data(), sizeof(values)) == 0; }
+};
+
+struct VertexKeyHash {
+    size_t operator ()(const VertexKey& key) const {
+        // FNV-1a over the bytes, so equal keys always hash the same
+        uint64_t hash = 14695981039346656037ull;
+        auto bytes = reinterpret_cast<const uint8_t*>(key.values.data());
+        for (size_t i = 0; i < sizeof(key.values); i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+};
+
+/**
+ * @brief Point every index at the first vertex with identical attributes
+ */
+void weldVertices(ModelPackage::Primitive& primitive) {
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> firstVertices;
+    std::vector<uint32_t> remap(primitive.vertexCount);
+
+    for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++) {
+        VertexKey key;
+        size_t offset = 0;
+
+        for (uint32_t stream = 0; stream < GeometryPool::StreamCount; stream++) {
+            uint32_t componentCount = GeometryPool::s_streamStrides[stream] / sizeof(float);
+            if (!primitive.streams[stream].empty())
+                std::memcpy(&key.values[offset], &primitive.streams[stream][vertex * componentCount], componentCount * sizeof(float));
+            offset += componentCount;
+        }
+
+        remap[vertex] = firstVertices.emplace(key, vertex).first->second;
+    }
+
+    for (auto& index : primitive.indices) index = remap[index];
+}
+
+/**
+ * @brief Reorder triangles so that each reuses as many recently transformed vertices as possible,
+ *        following Tom Forsyth's linear speed vertex cache optimisation
+ */
+void optimiseVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+    constexpr uint32_t s_cacheSize = 32;
+
+    uint32_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // every vertex's triangles, packed one vertex after another
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) liveTriangles[index]++;
+
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) firstTriangle[vertex + 1] = firstTriangle[vertex] + liveTriangles[vertex];
+
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    std::vector<uint32_t> filled(vertexCount, 0);
+    for (uint32_t i = 0; i < indices.size(); i++)
+        vertexTriangles[firstTriangle[indices[i]] + filled[indices[i]]++] = i / 3;
+
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+
+    auto scoreVertex = [&](uint32_t vertex) {
+        if (liveTriangles[vertex] == 0) return -1.0f;
+
+        float score = 0.0f;
+        int32_t position = cachePositions[vertex];
+
+        // the last triangle's vertices score the same, so the next triangle doesn't have to share an edge with it
+        if (position >= 0)
+            score = position < 3 ? 0.75f : std::pow(1.0f - (position - 3) / float(s_cacheSize - 3), 1.5f);
+
+        // vertices with few triangles left are finished off first
+        return score + 2.0f * std::pow(float(liveTriangles[vertex]), -0.5f);
+    };
+
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) vertexScores[vertex] = scoreVertex(vertex);
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    std::vector<uint32_t> cache;
+    output.reserve(indices.size());
+
+    int64_t bestTriangle = -1;
+    uint32_t scanCursor = 0;
+
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // nothing in the cache has triangles left, so carry on from the first triangle not yet emitted
+        if (bestTriangle < 0) {
+            while (emitted[scanCursor]) scanCursor++;
+            bestTriangle = scanCursor;
+        }
+
+        uint32_t triangle = bestTriangle;
+        emitted[triangle] = true;
+
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t vertex = indices[triangle * 3 + corner];
+            output.push_back(vertex);
+            liveTriangles[vertex]--;
+
+            auto it = std::find(cache.begin(), cache.end(), vertex);
+            if (it != cache.end()) cache.erase(it);
+            cache.insert(cache.begin(), vertex);
+        }
+
+        for (uint32_t position = 0; position < cache.size(); position++)
+            cachePositions[cache[position]] = position < s_cacheSize ? position : -1;
+
+        for (uint32_t vertex : cache) vertexScores[vertex] = scoreVertex(vertex);
+        if (cache.size() > s_cacheSize) cache.resize(s_cacheSize);
+
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+
+        for (uint32_t vertex : cache)
+        for (uint32_t i = firstTriangle[vertex]; i < firstTriangle[vertex + 1]; i++) {
+            uint32_t candidate = vertexTriangles[i];
+            if (emitted[candidate]) continue;
+
+            float score = vertexScores[indices[candidate * 3]]
+                        + vertexScores[indices[candidate * 3 + 1]]
+                        + vertexScores[indices[candidate * 3 + 2]];
+
+            if (score > bestScore) { bestScore = score; bestTriangle = candidate; }
+        }
+    }
+
+    indices = std::move(output);
+}
+
+/**
+ * @brief Renumber vertices in the order the indices first use them, dropping any which are never used
+ */
+void optimiseVertexFetch(ModelPackage::Primitive& primitive) {
+    std::vector<uint32_t> newIndices(primitive.vertexCount, UINT32_MAX);
+    uint32_t nextIndex = 0;
+
+    for (auto& index : primitive.indices) {
+        if (newIndices[index] == UINT32_MAX) newIndices[index] = nextIndex++;
+        index = newIndices[index];
+    }
+
+    for (uint32_t stream = 0; stream < GeometryPool::StreamCount; stream++) {
+        auto& data = primitive.streams[stream];
+        if (data.empty()) continue;
+
+        uint32_t componentCount = GeometryPool::s_streamStrides[stream] / sizeof(float);
+        std::vector<float> reordered(size_t { nextIndex } * componentCount);
+
+        for (uint32_t vertex = 0; vertex < primitive.vertexCount; vertex++) if (newIndices[vertex] != UINT32_MAX)
+            std::memcpy(&reordered[size_t { newIndices[vertex] } * componentCount], &data[size_t { vertex } * componentCount], componentCount * sizeof(float));
+
+        data = std::move(reordered);
+    }
+
+    primitive.vertexCount = nextIndex;
+}
+
+ModelPackage::Primitive cookPrimitive(const gltf::Model& model, const gltf::Mesh& mesh, uint32_t primitiveID, const ModelPackage::CookOptions& options, std::vector<std::string>& warnings) {
+    const gltf::Primitive& primitive = mesh.primitives[primitiveID];
+    std::string description = "Mesh " + mesh.name + " primitives[" + std::to_string(primitiveID) + "] ";
+
+    ModelPackage::Primitive ret;
+
+    auto findAttribute = [&](const char* name) {
+        auto it = primitive.attributes.find(name);
+        return it == primitive.attributes.end() ? -1 : it->second;
+    };
+
+    int positionAccessor = findAttribute("POSITION");
+    int texcoordAccessor = findAttribute("TEXCOORD_0");
+    int normalAccessor = findAttribute("NORMAL");
+    int tangentAccessor = findAttribute("TANGENT");
+
+    if (primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != -1) {
+        warnings.push_back(description + "isn't a triangle list, and won't be rendered");
+        return ret;
+    }
+
+    if (positionAccessor < 0 || texcoordAccessor < 0 || normalAccessor < 0) {
+        warnings.push_back(description + "attributes are not compatible with any pipeline, and it won't be rendered. "
+            "Primitives must provide at least a 'POSITION', 'TEXCOORD_0', and 'NORMAL'");
+        return ret;
+    }
+
+    auto& streams = ret.streams;
+    bool success = readFloatAccessor(model, positionAccessor, 3, streams[GeometryPool::Position])
+                && readFloatAccessor(model, texcoordAccessor, 2, streams[GeometryPool::Texcoord])
+                && readFloatAccessor(model, normalAccessor, 3, streams[GeometryPool::Normal])
+                && (tangentAccessor < 0 || readFloatAccessor(model, tangentAccessor, 4, streams[GeometryPool::Tangent]));
+
+    uint32_t vertexCount = model.accessors[positionAccessor].count;
+    success = success
+        && vertexCount > 0
+        && streams[GeometryPool::Texcoord].size() == vertexCount * 2
+        && streams[GeometryPool::Normal].size() == vertexCount * 3
+        && (tangentAccessor < 0 || streams[GeometryPool::Tangent].size() == vertexCount * 4);
+
+    if (!success) {
+        warnings.push_back(description + "vertex attributes must be floats of the same count, and it won't be rendered");
+        return {};
+    }
+
+    // non-indexed primitives draw every vertex in order
+    if (primitive.indices < 0) {
+        ret.indices.resize(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) ret.indices[i] = i;
+    } else if (!readIndices(model, primitive.indices, ret.indices)) {
+        warnings.push_back(description + "has unsupported indices, and it won't be rendered");
+        return {};
+    }
+
+    for (uint32_t index : ret.indices) if (index >= vertexCount) {
+        warnings.push_back(description + "has out of range indices, and it won't be rendered");
+        return {};
+    }
+
+    ret.vertexCount = vertexCount;
+
+    if (options.optimiseGeometry) {
+        weldVertices(ret);
+        optimiseVertexCache(ret.indices, ret.vertexCount);
+        optimiseVertexFetch(ret);
+    }
+
+    return ret;
+}
+
+class PackageWriter {
+    std::ofstream m_file;
+
+public:
+    PackageWriter(const std::string& filename) : m_file(filename, std::ios::binary) {
+        if (!m_file.is_open()) throw std::runtime_error("Failed to open package for writing: " + filename);
+    }
+
+    template<typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void write(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write<uint64_t>(values.size());
+        m_file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void write(const std::string& value) {
+        write<uint64_t>(value.size());
+        m_file.write(value.data(), value.size());
+    }
+
+    bool good() const { return m_file.good(); }
+};
+
+class PackageReader {
+    std::vector<char> m_bytes;
+    size_t            m_offset = 0;
+
+    void readBytes(void* dst, uint64_t size) {
+        if (size > m_bytes.size() - m_offset) throw std::runtime_error("Package is truncated");
+        std::memcpy(dst, m_bytes.data() + m_offset, size);
+        m_offset += size;
+    }
+
+public:
+    PackageReader(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open package: " + filename);
+
+        size_t filesize = file.tellg();
+        m_bytes.resize(filesize);
+        file.seekg(0);
+        file.read(m_bytes.data(), filesize);
+    }
+
+    template<typename T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        readBytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void read(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint64_t count;
+        read(count);
+
+        if (count > (m_bytes.size() - m_offset) / sizeof(T)) throw std::runtime_error("Package is truncated");
+        values.resize(count);
+        readBytes(values.data(), count * sizeof(T));
+    }
+
+    void read(std::string& value) {
+        uint64_t size;
+        read(size);
+
+        if (size > m_bytes.size() - m_offset) throw std::runtime_error("Package is truncated");
+        value.assign(m_bytes.data() + m_offset, size);
+        m_offset += size;
+    }
+
+    template<typename T>
+    T read() { T value; read(value); return value; }
+};
+
+}
+
+ModelPackage ModelPackage::cook(gltf::Model& model, const CookOptions& options, std::vector<std::string>& warnings) {
+    ModelPackage ret;
+
+    for (auto& sampler : model.samplers) {
+        Sampler& cooked = ret.samplers.emplace_back();
+
+        auto getAddressMode = [](int wrap) {
+            switch (wrap) {
+            case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:   return vk::SamplerAddressMode::eClampToEdge;
+            case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT: return vk::SamplerAddressMode::eMirroredRepeat;
+            default:                                    return vk::SamplerAddressMode::eRepeat;
+            }
+        };
+
+        auto getFilter = [](int filter) {
+            switch (filter) {
+            case TINYGLTF_TEXTURE_FILTER_LINEAR:
+            case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST:
+            case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR:
+                return vk::Filter::eLinear;
+            default:
+                return vk::Filter::eNearest;
+            }
+        };
+
+        cooked.addressModeU = getAddressMode(sampler.wrapS);
+        cooked.addressModeV = getAddressMode(sampler.wrapT);
+        cooked.minFilter = getFilter(sampler.minFilter);
+        cooked.magFilter = getFilter(sampler.magFilter);
+    }
+
+    // each image is compressed according to what the materials use it for
+    std::vector<uint32_t> imageSlots(model.images.size(), 0);
+
+    for (auto& material : model.materials) {
+        Material& cooked = ret.materials.emplace_back();
+        cooked.name = material.name;
+        cooked.emissiveFactor = { material.emissiveFactor[0], material.emissiveFactor[1], material.emissiveFactor[2] };
+
+        auto& pbr = material.pbrMetallicRoughness;
+        cooked.baseColorFactor = { pbr.baseColorFactor[0], pbr.baseColorFactor[1], pbr.baseColorFactor[2], pbr.baseColorFactor[3] };
+        cooked.metallicFactor = pbr.metallicFactor;
+        cooked.roughnessFactor = pbr.roughnessFactor;
+
+        std::array<int, TextureSlotCount> textureIDs;
+        textureIDs[BaseColor] = pbr.baseColorTexture.index;
+        textureIDs[MetallicRoughness] = pbr.metallicRoughnessTexture.index;
+        textureIDs[Emissive] = material.emissiveTexture.index;
+        textureIDs[Occlusion] = material.occlusionTexture.index;
+        textureIDs[Normal] = material.normalTexture.index;
+
+        for (uint32_t slot = 0; slot < TextureSlotCount; slot++) {
+            if (textureIDs[slot] < 0 || textureIDs[slot] >= int(model.textures.size())) continue;
+
+            auto& texture = model.textures[textureIDs[slot]];
+            if (texture.source < 0 || texture.source >= int(model.images.size())) continue;
+
+            bool hasSampler = texture.sampler >= 0 && texture.sampler < int(model.samplers.size());
+            cooked.textures[slot] = { texture.source, hasSampler ? texture.sampler : -1 };
+            imageSlots[texture.source] |= slotBit(static_cast<TextureSlot>(slot));
+        }
+    }
+
+    for (uint32_t imageID = 0; imageID < model.images.size(); imageID++)
+        ret.images.push_back(cookImage(model.images[imageID], imageSlots[imageID], options, warnings));
+
+    // primitives without a material use the glTF default material
+    std::optional<uint32_t> defaultMaterial;
+
+    for (auto& mesh : model.meshes) {
+        Mesh& cooked = ret.meshes.emplace_back();
+        cooked.name = mesh.name;
+
+        for (uint32_t primitiveID = 0; primitiveID < mesh.primitives.size(); primitiveID++) {
+            Primitive& primitive = cooked.primitives.emplace_back(cookPrimitive(model, mesh, primitiveID, options, warnings));
+            int material = mesh.primitives[primitiveID].material;
+
+            if (material < 0 || material >= int(ret.materials.size())) {
+                if (!defaultMaterial) {
+                    defaultMaterial = ret.materials.size();
+                    ret.materials.push_back({ .name = "Default" });
+                }
+
+                material = *defaultMaterial;
+            }
+
+            primitive.material = material;
+        }
+    }
+
+    for (auto& light : model.lights) {
+        Light& cooked = ret.lights.emplace_back();
+        cooked.name = light.name;
+        cooked.type = light.type;
+        cooked.intensity = light.intensity;
+        if (light.color.size() >= 3) cooked.color = { light.color[0], light.color[1], light.color[2] };
+    }
+
+    for (auto& node : model.nodes) {
+        Node& cooked = ret.nodes.emplace_back();
+        cooked.name = node.name;
+        cooked.mesh = node.mesh;
+        cooked.light = node.light;
+        cooked.children.assign(node.children.begin(), node.children.end());
+
+        if (node.translation.size() == 3) cooked.translation = { node.translation[0], node.translation[1], node.translation[2] };
+        if (node.rotation.size() == 4)    cooked.rotation = glm::quat { float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]) };
+        if (node.scale.size() == 3)       cooked.scale = { node.scale[0], node.scale[1], node.scale[2] };
+
+        // matrices are split up, so that the transform can be edited like any other
+        if (node.matrix.size() == 16) {
+            glm::mat4 matrix;
+            for (uint32_t i = 0; i < 16; i++) matrix[i / 4][i % 4] = node.matrix[i];
+
+            glm::vec3 skew;
+            glm::vec4 perspective;
+            glm::decompose(matrix, cooked.scale, cooked.rotation, cooked.translation, skew, perspective);
+        }
+    }
+
+    for (auto& scene : model.scenes) {
+        Scene& cooked = ret.scenes.emplace_back();
+        cooked.name = scene.name;
+        cooked.nodes.assign(scene.nodes.begin(), scene.nodes.end());
+    }
+
+    return ret;
+}
+
+void ModelPackage::write(const std::string& filename) const {
+    PackageWriter writer { filename };
+
+    writer.write(s_magic);
+    writer.write(s_version);
+
+    writer.write<uint64_t>(images.size());
+    for (auto& image : images) {
+        writer.write(image.format);
+        writer.write(image.width);
+        writer.write(image.height);
+        writer.write(image.levelOffsets);
+        writer.write(image.data);
+    }
+
+    writer.write(samplers);
+
+    writer.write<uint64_t>(materials.size());
+    for (auto& material : materials) {
+        writer.write(material.name);
+        writer.write(material.emissiveFactor);
+        writer.write(material.baseColorFactor);
+        writer.write(material.metallicFactor);
+        writer.write(material.roughnessFactor);
+        writer.write(material.textures);
+    }
+
+    writer.write<uint64_t>(meshes.size());
+    for (auto& mesh : meshes) {
+        writer.write(mesh.name);
+        writer.write<uint64_t>(mesh.primitives.size());
+
+        for (auto& primitive : mesh.primitives) {
+            writer.write(primitive.material);
+            writer.write(primitive.vertexCount);
+            for (auto& stream : primitive.streams) writer.write(stream);
+            writer.write(primitive.indices);
+        }
+    }
+
+    writer.write<uint64_t>(lights.size());
+    for (auto& light : lights) {
+        writer.write(light.name);
+        writer.write(light.type);
+        writer.write(light.color);
+        writer.write(light.intensity);
+    }
+
+    writer.write<uint64_t>(nodes.size());
+    for (auto& node : nodes) {
+        writer.write(node.name);
+        writer.write(node.mesh);
+        writer.write(node.light);
+        writer.write(node.translation);
+        writer.write(node.rotation);
+        writer.write(node.scale);
+        writer.write(node.children);
+    }
+
+    writer.write<uint64_t>(scenes.size());
+    for (auto& scene : scenes) {
+        writer.write(scene.name);
+        writer.write(scene.nodes);
+    }
+
+    if (!writer.good()) throw std::runtime_error("Failed to write package: " + filename);
+}
+
+ModelPackage ModelPackage::read(const std::string& filename) {
+    PackageReader reader { filename };
+    ModelPackage ret;
+
+    if (reader.read<uint32_t>() != s_magic) throw std::runtime_error("Not a model package: " + filename);
+    if (reader.read<uint32_t>() != s_version) throw std::runtime_error("Model package is from a different version, and must be cooked again: " + filename);
+
+    ret.images.resize(reader.read<uint64_t>());
+    for (auto& image : ret.images) {
+        reader.read(image.format);
+        reader.read(image.width);
+        reader.read(image.height);
+        reader.read(image.levelOffsets);
+        reader.read(image.data);
+    }
+
+    reader.read(ret.samplers);
+
+    ret.materials.resize(reader.read<uint64_t>());
+    for (auto& material : ret.materials) {
+        reader.read(material.name);
+        reader.read(material.emissiveFactor);
+        reader.read(material.baseColorFactor);
+        reader.read(material.metallicFactor);
+        reader.read(material.roughnessFactor);
+        reader.read(material.textures);
+    }
+
+    ret.meshes.resize(reader.read<uint64_t>());
+    for (auto& mesh : ret.meshes) {
+        reader.read(mesh.name);
+        mesh.primitives.resize(reader.read<uint64_t>());
+
+        for (auto& primitive : mesh.primitives) {
+            reader.read(primitive.material);
+            reader.read(primitive.vertexCount);
+            for (auto& stream : primitive.streams) reader.read(stream);
+            reader.read(primitive.indices);
+        }
+    }
+
+    ret.lights.resize(reader.read<uint64_t>());
+    for (auto& light : ret.lights) {
+        reader.read(light.name);
+        reader.read(light.type);
+        reader.read(light.color);
+        reader.read(light.intensity);
+    }
+
+    ret.nodes.resize(reader.read<uint64_t>());
+    for (auto& node : ret.nodes) {
+        reader.read(node.name);
+        reader.read(node.mesh);
+        reader.read(node.light);
+        reader.read(node.translation);
+        reader.read(node.rotation);
+        reader.read(node.scale);
+        reader.read(node.children);
+    }
+
+    ret.scenes.resize(reader.read<uint64_t>());
+    for (auto& scene : ret.scenes) {
+        reader.read(scene.name);
+        reader.read(scene.nodes);
+    }
+
+    return ret;
+}
+
+void ModelPackage::fillModel(gltf::Model& model) const {
+    for (auto& light : lights) {
+        gltf::Light& filled = model.lights.emplace_back();
+        filled.name = light.name;
+        filled.type = light.type;
+        filled.color = { light.color.r, light.color.g, light.color.b };
+        filled.intensity = light.intensity;
+    }
+
+    for (auto& node : nodes) {
+        gltf::Node& filled = model.nodes.emplace_back();
+        filled.name = node.name;
+        filled.mesh = node.mesh;
+        filled.light = node.light;
+        filled.children.assign(node.children.begin(), node.children.end());
+        filled.translation = { node.translation.x, node.translation.y, node.translation.z };
+        filled.rotation = { node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w };
+        filled.scale = { node.scale.x, node.scale.y, node.scale.z };
+    }
+
+    for (auto& scene : scenes) {
+        gltf::Scene& filled = model.scenes.emplace_back();
+        filled.name = scene.name;
+        filled.nodes.assign(scene.nodes.begin(), scene.nodes.end());
+    }
+}
+
+}
@@ -29,9 +29,7 @@ vk::PipelineLayout PipelineLayoutBuilder::build() {
         .setPushConstantRanges(m_pushConstantRanges)
         );
     
-    r_scope.addDeferredCleanupFunction([=, device = getDevice()]() {
-        device.destroyPipelineLayout(layout);
-    });
+    r_scope.addDeferredDestroy(getDevice(), layout);
     
     return layout;
 }
@@ -64,9 +62,7 @@ vk::ShaderModule IPipelineBuilder::loadShaderModule(const char* filename) {
         .setPCode(reinterpret_cast<uint32_t*>(code.data()))
         );
     
-    r_scope.addDeferredCleanupFunction([=, device = getDevice()]() {
-        device.destroyShaderModule(shaderModule);
-    });
+    r_scope.addDeferredDestroy(getDevice(), shaderModule);
 
     return shaderModule;
 }
@@ -83,14 +79,22 @@ ComputePipelineBuilder::ComputePipelineBuilder(
 {}
 
 ComputePipelineBuilder& ComputePipelineBuilder::setPipelineLayout(vk::PipelineLayout pipelineLayout) {
+    m_layout = pipelineLayout;
     return *this;
 }
 
 ComputePipelineBuilder& ComputePipelineBuilder::setShaderModule(vk::ShaderModule shaderModule) {
+    m_shaderModule = shaderModule;
     return *this;
 }
 
+ComputePipelineBuilder& ComputePipelineBuilder::setShaderModuleFromFile(const char* filename) {
+    m_modules.push_back(loadShaderModule(filename));
+    return setShaderModule(m_modules.back());
+}
+
 ComputePipelineBuilder& ComputePipelineBuilder::setFunctionName(const char* functionName) {
+    m_functionName = functionName;
     return *this;
 }
 
@@ -107,9 +111,7 @@ vk::ResultValue<PipelineData> ComputePipelineBuilder::build() {
     if (pipeline_result.result != vk::Result::eSuccess)
         return vk::ResultValue<PipelineData> { pipeline_result.result, ret };
 
-    r_scope.addDeferredCleanupFunction([=, device = getDevice(), pipeline = pipeline_result.value ] {
-        device.destroyPipeline(pipeline);
-    });
+    r_scope.addDeferredDestroy(getDevice(), pipeline_result.value);
 
     ret.pipeline = pipeline_result.value;
 
@@ -210,9 +212,7 @@ vk::ResultValue<PipelineData> GraphicsPipelineBuilder::build() {
     if (pipelineResult.result != vk::Result::eSuccess)
         return vk::ResultValue<PipelineData> { pipelineResult.result, ret };
 
-    r_scope.addDeferredCleanupFunction([=, device = getDevice(), pipeline = pipelineResult.value]() {
-        device.destroyPipeline(pipeline);
-    });
+    r_scope.addDeferredDestroy(getDevice(), pipelineResult.value);
 
     ret.pipeline = pipelineResult.value;
 
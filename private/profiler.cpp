@@ -0,0 +1,225 @@
+#include "profiler.hpp"
+#include "engine.hpp"
+
+#include <external/json.hpp>
+#include <fstream>
+
+namespace ignis {
+
+void GPUProfiler::setup(ResourceScope& scope, uint32_t frameCount, uint32_t queueFamilyIndex, uint32_t maxScopeCount) {
+    IEngine& engine = IEngine::get();
+    vk::Device device = engine.getDevice();
+    vk::PhysicalDevice physicalDevice = engine.getPhysicalDevice();
+
+    vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+
+    m_supported = validBits > 0 && limits.timestampPeriod > 0.0f;
+
+    if (!m_supported) {
+        IGNIS_LOG("Profiler", Warning, "Timestamp queries are not supported on this queue, GPU timings will not be available");
+        return;
+    }
+
+    m_timestampMask = validBits >= 64 ? ~uint64_t { 0 } : (uint64_t { 1 } << validBits) - 1;
+    m_timestampPeriod = limits.timestampPeriod;
+    m_maxQueryCount = maxScopeCount * 2;
+
+    m_frames.resize(frameCount);
+    for (auto& frame : m_frames)
+        frame.pool = device.createQueryPool(vk::QueryPoolCreateInfo {}
+            .setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(m_maxQueryCount));
+
+    scope.addDeferredCleanupFunction([&, device]() {
+        for (auto& frame : m_frames) device.destroyQueryPool(frame.pool);
+        m_frames.clear();
+        p_currentFrame = nullptr;
+    });
+}
+
+void GPUProfiler::resolve(FrameQueries& frame) {
+    if (frame.queryCount == 0) return;
+
+    vk::ResultValue<std::vector<uint64_t>> results = IEngine::get().getDevice().getQueryPoolResults<uint64_t>(
+        frame.pool, 0, frame.queryCount,
+        frame.queryCount * sizeof(uint64_t), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+
+    // the frame's fence has signalled, so this only happens if the queries were never submitted
+    if (results.result != vk::Result::eSuccess) return;
+
+    m_latest.frameNumber = frame.frameNumber;
+    m_latest.timings.clear();
+
+    for (auto& scope : frame.scopes) {
+        uint64_t ticks = (results.value[scope.endQuery] - results.value[scope.beginQuery]) & m_timestampMask;
+        double milliseconds = static_cast<double>(ticks) * m_timestampPeriod / 1'000'000.0;
+
+        auto it = m_averages.find(scope.name);
+        if (it == m_averages.end()) it = m_averages.emplace(scope.name, milliseconds).first;
+        else it->second += (milliseconds - it->second) * s_averageWeight;
+
+        m_latest.timings.push_back({ scope.name, scope.depth, milliseconds, it->second });
+    }
+
+    if (m_recording) m_recordedFrames.push_back(m_latest);
+}
+
+void GPUProfiler::beginFrame(vk::CommandBuffer cmd, uint32_t frameIndex, uint64_t frameNumber) {
+    if (!m_supported) return;
+
+    p_currentFrame = &m_frames[frameIndex];
+    resolve(*p_currentFrame);
+
+    p_currentFrame->scopes.clear();
+    p_currentFrame->queryCount = 0;
+    p_currentFrame->frameNumber = frameNumber;
+    m_openScopes.clear();
+
+    cmd.resetQueryPool(p_currentFrame->pool, 0, m_maxQueryCount);
+}
+
+void GPUProfiler::beginScope(vk::CommandBuffer cmd, const std::string& name) {
+    if (!m_supported || !p_currentFrame) return;
+
+    if (p_currentFrame->queryCount + 2 > m_maxQueryCount) {
+        IGNIS_LOG("Profiler", Warning, "Too many profiler scopes in one frame, ignoring scope: " << name);
+        m_openScopes.push_back(UINT32_MAX);
+        return;
+    }
+
+    uint32_t query = p_currentFrame->queryCount;
+    p_currentFrame->queryCount += 2;
+
+    m_openScopes.push_back(p_currentFrame->scopes.size());
+    p_currentFrame->scopes.push_back({ name, static_cast<uint32_t>(m_openScopes.size() - 1), query, query + 1 });
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, p_currentFrame->pool, query);
+}
+
+void GPUProfiler::endScope(vk::CommandBuffer cmd) {
+    if (!m_supported || !p_currentFrame) return;
+
+    assert(!m_openScopes.empty());
+
+    uint32_t scopeIndex = m_openScopes.back();
+    m_openScopes.pop_back();
+
+    if (scopeIndex == UINT32_MAX) return;
+
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, p_currentFrame->pool, p_currentFrame->scopes[scopeIndex].endQuery);
+}
+
+double GPUProfiler::getTime(const std::string& name) const {
+    for (auto& timing : m_latest.timings)
+        if (timing.name == name) return timing.milliseconds;
+
+    return 0.0;
+}
+
+void GPUProfiler::setRecording(bool recording) {
+    if (recording && !m_recording) m_recordedFrames.clear();
+    m_recording = recording;
+}
+
+bool GPUProfiler::writeCSV(const std::string& filename) const {
+    std::ofstream file { filename };
+    if (!file.is_open()) {
+        IGNIS_LOG("Profiler", Error, "Failed to open file for writing: " << filename);
+        return false;
+    }
+
+    file << "frame,scope,depth,milliseconds\n";
+
+    auto writeFrame = [&](const Frame& frame) {
+        for (auto& timing : frame.timings)
+            file << frame.frameNumber << ",\"" << timing.name << "\"," << timing.depth << "," << timing.milliseconds << "\n";
+    };
+
+    if (m_recordedFrames.empty()) writeFrame(m_latest);
+    else for (auto& frame : m_recordedFrames) writeFrame(frame);
+
+    IGNIS_LOG("Profiler", Info, "Wrote GPU timings to " << filename);
+    return true;
+}
+
+bool GPUProfiler::writeJSON(const std::string& filename) const {
+    std::ofstream file { filename };
+    if (!file.is_open()) {
+        IGNIS_LOG("Profiler", Error, "Failed to open file for writing: " << filename);
+        return false;
+    }
+
+    auto frameToJSON = [](const Frame& frame) {
+        nlohmann::json scopes = nlohmann::json::array();
+
+        for (auto& timing : frame.timings)
+            scopes.push_back({
+                { "name", timing.name },
+                { "depth", timing.depth },
+                { "milliseconds", timing.milliseconds },
+            });
+
+        return nlohmann::json {
+            { "frame", frame.frameNumber },
+            { "scopes", scopes },
+        };
+    };
+
+    nlohmann::json frames = nlohmann::json::array();
+
+    if (m_recordedFrames.empty()) frames.push_back(frameToJSON(m_latest));
+    else for (auto& frame : m_recordedFrames) frames.push_back(frameToJSON(frame));
+
+    file << nlohmann::json { { "frames", frames } }.dump(2);
+
+    IGNIS_LOG("Profiler", Info, "Wrote GPU timings to " << filename);
+    return true;
+}
+
+void GPUProfiler::draw() {
+    ImGui::Begin("GPU Profiler");
+
+    if (!m_supported) {
+        ImGui::Text("Timestamp queries are not supported on this device");
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button(m_recording ? "Stop recording" : "Record")) setRecording(!m_recording);
+
+    ImGui::SameLine();
+    if (ImGui::Button("Save CSV")) writeCSV("gpu_timings.csv");
+
+    ImGui::SameLine();
+    if (ImGui::Button("Save JSON")) writeJSON("gpu_timings.json");
+
+    if (m_recording) {
+        ImGui::SameLine();
+        ImGui::Text("%zu frames recorded", m_recordedFrames.size());
+    }
+
+    if (ImGui::BeginTable("Timings", 3, ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch, 2.f);
+        ImGui::TableSetupColumn("Time (ms)", ImGuiTableColumnFlags_WidthStretch, 1.f);
+        ImGui::TableSetupColumn("Average (ms)", ImGuiTableColumnFlags_WidthStretch, 1.f);
+        ImGui::TableHeadersRow();
+
+        for (auto& timing : m_latest.timings) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", static_cast<int>(timing.depth * 2), "", timing.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.milliseconds);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.averageMilliseconds);
+        }
+
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+}
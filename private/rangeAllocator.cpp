@@ -0,0 +1,81 @@
+#include "rangeAllocator.hpp"
+
+namespace ignis {
+
+RangeAllocator::RangeAllocator(uint64_t capacity) : m_capacity(capacity) {
+    if (capacity > 0) insertFree(0, capacity);
+}
+
+void RangeAllocator::insertFree(uint64_t offset, uint64_t size) {
+    m_freeByOffset.emplace(offset, size);
+    m_freeBySize.emplace(size, offset);
+}
+
+void RangeAllocator::eraseFree(std::map<uint64_t, uint64_t>::iterator it) {
+    auto [first, last] = m_freeBySize.equal_range(it->second);
+    for (auto sizeIt = first; sizeIt != last; sizeIt++) if (sizeIt->second == it->first) {
+        m_freeBySize.erase(sizeIt);
+        break;
+    }
+
+    m_freeByOffset.erase(it);
+}
+
+std::optional<uint64_t> RangeAllocator::allocate(uint64_t size, uint64_t alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0) return std::nullopt;
+
+    // the smallest free range which can fit the size, including any padding for alignment
+    for (auto sizeIt = m_freeBySize.lower_bound(size); sizeIt != m_freeBySize.end(); sizeIt++) {
+        auto [rangeSize, rangeOffset] = *sizeIt;
+
+        uint64_t offset = (rangeOffset + alignment - 1) & ~(alignment - 1);
+        uint64_t padding = offset - rangeOffset;
+        if (padding + size > rangeSize) continue;
+
+        eraseFree(m_freeByOffset.find(rangeOffset));
+
+        if (padding > 0) insertFree(rangeOffset, padding);
+        if (padding + size < rangeSize) insertFree(offset + size, rangeSize - padding - size);
+
+        m_allocated.emplace(offset, size);
+        m_used += size;
+
+        return offset;
+    }
+
+    return std::nullopt;
+}
+
+void RangeAllocator::free(uint64_t offset) {
+    auto allocatedIt = m_allocated.find(offset);
+    assert(allocatedIt != m_allocated.end());
+    if (allocatedIt == m_allocated.end()) return;
+
+    uint64_t size = allocatedIt->second;
+    m_allocated.erase(allocatedIt);
+    m_used -= size;
+
+    // merge with the free ranges either side
+    auto next = m_freeByOffset.lower_bound(offset);
+
+    if (next != m_freeByOffset.begin()) {
+        auto previous = std::prev(next);
+
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            eraseFree(previous);
+        }
+    }
+
+    if (next != m_freeByOffset.end() && offset + size == next->first) {
+        size += next->second;
+        eraseFree(next);
+    }
+
+    insertFree(offset, size);
+}
+
+}
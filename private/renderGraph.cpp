@@ -0,0 +1,523 @@
+#include "renderGraph.hpp"
+#include "engine.hpp"
+
+namespace ignis {
+
+RenderGraph::Pass& RenderGraph::Pass::read(ImageHandle image, Usage usage, uint32_t baseMipLevel, uint32_t mipLevelCount) {
+    addAccess({ image, usage, baseMipLevel, mipLevelCount, false });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write(ImageHandle image, Usage usage, uint32_t baseMipLevel, uint32_t mipLevelCount) {
+    addAccess({ image, usage, baseMipLevel, mipLevelCount, true });
+    return *this;
+}
+
+void RenderGraph::Pass::addAccess(const Access& access) {
+    auto getMipLevelEnd = [](const Access& access) {
+        return access.mipLevelCount == VK_REMAINING_MIP_LEVELS
+            ? std::numeric_limits<uint32_t>::max()
+            : access.baseMipLevel + access.mipLevelCount;
+    };
+
+    // a subresource is in one layout for the whole pass, so two usages of it would need two transitions at once
+    for (const Access& other : m_accesses) {
+        bool overlaps = other.image == access.image
+            && other.baseMipLevel < getMipLevelEnd(access)
+            && access.baseMipLevel < getMipLevelEnd(other);
+
+        assert(!overlaps || other.usage == access.usage);
+    }
+
+    m_accesses.push_back(access);
+}
+
+RenderGraph::Pass& RenderGraph::Pass::setGroup(std::string group) {
+    m_group = group;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::setSideEffects(bool sideEffects) {
+    m_sideEffects = sideEffects;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::setRecordFunction(std::function<void(vk::CommandBuffer)> func) {
+    m_recordFunction = func;
+    return *this;
+}
+
+RenderGraph::UsageInfo RenderGraph::getUsageInfo(Usage usage) {
+    using Stage = vk::PipelineStageFlagBits2;
+    using Access = vk::AccessFlagBits2;
+
+    switch (usage) {
+    case Usage::ColorAttachment: return {
+        vk::ImageLayout::eColorAttachmentOptimal,
+        Stage::eColorAttachmentOutput,
+        Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+        Access::eColorAttachmentWrite };
+    case Usage::DepthAttachment: return {
+        vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+        Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+        Access::eDepthStencilAttachmentWrite };
+    case Usage::Sampled: return {
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        Stage::eFragmentShader,
+        Access::eShaderSampledRead,
+        {} };
+    case Usage::TransferSrc: return {
+        vk::ImageLayout::eTransferSrcOptimal,
+        Stage::eAllTransfer,
+        Access::eTransferRead,
+        {} };
+    case Usage::TransferDst: return {
+        vk::ImageLayout::eTransferDstOptimal,
+        Stage::eAllTransfer,
+        Access::eTransferWrite,
+        Access::eTransferWrite };
+    case Usage::Present: return {
+        vk::ImageLayout::ePresentSrcKHR,
+        Stage::eNone,
+        {},
+        {} };
+    case Usage::ComputeSampled: return {
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        Stage::eComputeShader,
+        Access::eShaderSampledRead,
+        {} };
+    case Usage::Storage: return {
+        vk::ImageLayout::eGeneral,
+        Stage::eComputeShader,
+        Access::eShaderStorageRead | Access::eShaderStorageWrite,
+        Access::eShaderStorageWrite };
+    }
+
+    assert(false);
+    return {};
+}
+
+void RenderGraph::resetState(ImageResource& resource) {
+    resource.mipStates.assign(resource.p_image ? resource.p_image->getMipLevelCount() : 0, SubresourceState {});
+    resource.touchedThisFrame = false;
+}
+
+RenderGraph::ImageHandle RenderGraph::importImage(const std::string& name, Image& image) {
+    assert(!m_compiled);
+
+    ImageResource& resource = m_images.emplace_back();
+    resource.name = name;
+    resource.p_image = &image;
+    resetState(resource);
+
+    return m_images.size() - 1;
+}
+
+void RenderGraph::setImage(ImageHandle handle, Image& image, vk::PipelineStageFlags2 firstUseStages, bool discardContents) {
+    ImageResource& resource = m_images[handle];
+    assert(!resource.transient);
+
+    resource.p_image = &image;
+    resource.discardOnFirstUse = discardContents;
+    resource.firstUseStages = firstUseStages;
+    resetState(resource);
+}
+
+RenderGraph::ImageHandle RenderGraph::addTransientImage(const std::string& name, const TransientImageInfo& info) {
+    assert(!m_compiled);
+
+    ImageResource& resource = m_images.emplace_back();
+    resource.name = name;
+    resource.transient = true;
+    resource.transientInfo = info;
+    resource.discardOnFirstUse = true;
+
+    return m_images.size() - 1;
+}
+
+std::optional<RenderGraph::ImageHandle> RenderGraph::findImage(const std::string& name) const {
+    for (ImageHandle handle = 0; handle < m_images.size(); handle++)
+        if (m_images[handle].name == name) return handle;
+
+    return std::nullopt;
+}
+
+void RenderGraph::markOutput(ImageHandle handle, Usage finalUsage) {
+    m_images[handle].outputUsage = finalUsage;
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name) {
+    assert(!m_compiled);
+    return m_passes.emplace_back(name);
+}
+
+void RenderGraph::cullPasses() {
+    std::vector<bool> imageIsNeeded (m_images.size(), false);
+    for (ImageHandle handle = 0; handle < m_images.size(); handle++)
+        imageIsNeeded[handle] = m_images[handle].outputUsage.has_value();
+
+    // walk backwards so every reader has been visited before the passes that write what it reads.
+    // writes may be partial, e.g. with a load op, so earlier writers of a needed image are still needed
+    for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); pass++) {
+        bool needed = pass->m_sideEffects;
+
+        for (auto& access : pass->m_accesses)
+            if (access.write && imageIsNeeded[access.image]) needed = true;
+
+        pass->m_culled = !needed;
+        if (!needed) continue;
+
+        for (auto& access : pass->m_accesses)
+            imageIsNeeded[access.image] = true;
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (uint32_t passIndex = 0; passIndex < m_passes.size(); passIndex++) {
+        Pass& pass = m_passes[passIndex];
+        if (pass.m_culled) continue;
+
+        for (auto& access : pass.m_accesses) {
+            ImageResource& resource = m_images[access.image];
+            resource.firstPass = std::min(resource.firstPass, passIndex);
+            resource.lastPass = std::max(resource.lastPass, passIndex);
+        }
+    }
+
+    for (auto& resource : m_images)
+        if (resource.outputUsage) resource.lastPass = m_passes.size();
+}
+
+bool RenderGraph::canBeLazilyAllocated(const TransientImageInfo& info) {
+    constexpr vk::ImageUsageFlags attachmentUsage = vk::ImageUsageFlagBits::eColorAttachment
+                                                  | vk::ImageUsageFlagBits::eDepthStencilAttachment
+                                                  | vk::ImageUsageFlagBits::eInputAttachment;
+
+    if (info.usage & ~attachmentUsage) return false;
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(IEngine::get().getAllocator(), &memoryProperties);
+
+    for (uint32_t type = 0; type < memoryProperties->memoryTypeCount; type++)
+        if (memoryProperties->memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) return true;
+
+    return false;
+}
+
+void RenderGraph::allocateTransientImages(ResourceScope& scope) {
+    IEngine& engine = IEngine::get();
+    vk::Device device = engine.getDevice();
+    VmaAllocator allocator = engine.getAllocator();
+
+    struct Candidate {
+        ImageHandle            handle;
+        vk::MemoryRequirements requirements;
+    };
+
+    std::vector<Candidate>     candidates;
+    std::vector<VmaAllocation> allocations;
+
+    for (ImageHandle handle = 0; handle < m_images.size(); handle++) {
+        ImageResource& resource = m_images[handle];
+        if (!resource.transient) continue;
+
+        // a transient image no pass uses after culling is never created
+        if (resource.firstPass == UINT32_MAX) continue;
+
+        const TransientImageInfo& info = resource.transientInfo;
+        bool lazy = canBeLazilyAllocated(info);
+
+        vk::Image image = device.createImage(vk::ImageCreateInfo {}
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(info.format)
+            .setExtent({ info.extent.width, info.extent.height, 1 })
+            .setMipLevels(info.mipLevelCount)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setUsage(lazy ? info.usage | vk::ImageUsageFlagBits::eTransientAttachment : info.usage)
+            .setInitialLayout(vk::ImageLayout::eUndefined));
+
+        scope.addDeferredDestroy(device, image);
+
+        resource.p_image = &m_transientImages.emplace_back(
+            image, info.format,
+            vk::Extent3D { info.extent.width, info.extent.height, 1 },
+            info.aspectMask, info.mipLevelCount, 1, vk::ImageLayout::eUndefined, info.usage);
+
+        resetState(resource);
+        m_stats.transientImageCount++;
+
+        if (lazy) {
+            // lazily allocated memory is committed per image as the tiler needs it, so it is never aliased
+            VmaAllocationCreateInfo lazyCreateInfo { .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED };
+            VmaAllocation allocation;
+
+            vk::resultCheck(static_cast<vk::Result>(
+                vmaAllocateMemoryForImage(allocator, image, &lazyCreateInfo, &allocation, nullptr)),
+                "Failed to allocate lazily allocated render graph memory");
+
+            vk::resultCheck(static_cast<vk::Result>(vmaBindImageMemory(allocator, allocation, image)),
+                "Failed to bind render graph transient image memory");
+
+            allocations.push_back(allocation);
+            m_stats.lazyImageCount++;
+            continue;
+        }
+
+        candidates.push_back({ handle, device.getImageMemoryRequirements(image) });
+    }
+
+    // place the largest images first, each into the first block whose images' lifetimes don't overlap with it
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.requirements.size > b.requirements.size;
+    });
+
+    vk::DeviceSize unaliasedSize = 0;
+
+    for (auto& candidate : candidates) {
+        ImageResource& resource = m_images[candidate.handle];
+        unaliasedSize += candidate.requirements.size;
+
+        auto overlaps = [&](ImageHandle other) {
+            return resource.firstPass <= m_images[other].lastPass
+                && m_images[other].firstPass <= resource.lastPass;
+        };
+
+        for (int32_t blockIndex = 0; blockIndex < m_memoryBlocks.size(); blockIndex++) {
+            MemoryBlock& block = m_memoryBlocks[blockIndex];
+
+            if (!(block.requirements.memoryTypeBits & candidate.requirements.memoryTypeBits)) continue;
+            if (std::any_of(block.images.begin(), block.images.end(), overlaps)) continue;
+
+            resource.memoryBlock = blockIndex;
+            break;
+        }
+
+        if (resource.memoryBlock < 0) {
+            resource.memoryBlock = m_memoryBlocks.size();
+            m_memoryBlocks.emplace_back().requirements = candidate.requirements;
+        }
+
+        MemoryBlock& block = m_memoryBlocks[resource.memoryBlock];
+        block.images.push_back(candidate.handle);
+        block.requirements.size = std::max(block.requirements.size, candidate.requirements.size);
+        block.requirements.alignment = std::max(block.requirements.alignment, candidate.requirements.alignment);
+        block.requirements.memoryTypeBits &= candidate.requirements.memoryTypeBits;
+    }
+
+    VmaAllocationCreateInfo allocationCreateInfo {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+
+    for (auto& block : m_memoryBlocks) {
+        VkMemoryRequirements requirements = block.requirements;
+
+        vk::resultCheck(static_cast<vk::Result>(
+            vmaAllocateMemory(allocator, &requirements, &allocationCreateInfo, &block.allocation, nullptr)),
+            "Failed to allocate render graph transient memory");
+
+        for (ImageHandle handle : block.images)
+            vk::resultCheck(static_cast<vk::Result>(
+                vmaBindImageMemory(allocator, block.allocation, m_images[handle].p_image->getImage())),
+                "Failed to bind render graph transient image memory");
+
+        m_stats.transientMemorySize += block.requirements.size;
+        allocations.push_back(block.allocation);
+    }
+
+    // registered after the images, so the memory is freed just before they are destroyed, which vulkan allows
+    // since nothing uses them by then. The scope may be cleaned up after this graph has been replaced, so it
+    // keeps its own copy of the allocations
+    for (auto allocation : allocations) scope.addDeferredFree(allocator, allocation);
+
+    scope.trackAllocation(m_stats.transientMemorySize);
+
+    m_stats.memoryBlockCount = m_memoryBlocks.size();
+    m_stats.aliasedMemorySaved = unaliasedSize - m_stats.transientMemorySize;
+}
+
+void RenderGraph::compile(ResourceScope& scope) {
+    assert(!m_compiled);
+
+    cullPasses();
+    computeLifetimes();
+    allocateTransientImages(scope);
+
+    m_stats.passCount = m_passes.size();
+    m_stats.culledPassCount = std::count_if(m_passes.begin(), m_passes.end(), [](const Pass& pass) { return pass.m_culled; });
+
+    for (auto& pass : m_passes)
+        if (pass.m_culled) IGNIS_LOG("Render Graph", Info, "Culled pass: " << pass.m_name);
+
+    IGNIS_LOG("Render Graph", Info, "Compiled "
+        << m_stats.passCount - m_stats.culledPassCount << " of " << m_stats.passCount << " passes, "
+        << m_stats.transientImageCount << " transient images in " << m_stats.memoryBlockCount << " memory blocks "
+        << "(" << m_stats.lazyImageCount << " lazily allocated), "
+        << m_stats.aliasedMemorySaved / 1024 << " KiB saved by aliasing");
+
+    m_compiled = true;
+}
+
+void RenderGraph::addBarriers(
+    ImageHandle handle, Usage usage, uint32_t baseMipLevel, uint32_t mipLevelCount, BarrierBatch& barriers
+) {
+    ImageResource& resource = m_images[handle];
+    Image& image = *resource.p_image;
+    UsageInfo info = getUsageInfo(usage);
+
+    MemoryBlock* block = resource.memoryBlock >= 0 ? &m_memoryBlocks[resource.memoryBlock] : nullptr;
+
+    if (!resource.touchedThisFrame) {
+        resource.touchedThisFrame = true;
+
+        // the memory may have last been used by another image aliasing it, so wait on whatever that was
+        if (block) {
+            resource.firstUseStages = block->lastStages;
+            resource.firstUseAccess = block->lastAccess;
+            block->lastStages = {};
+            block->lastAccess = {};
+        }
+    }
+
+    uint32_t mipLevelEnd = mipLevelCount == VK_REMAINING_MIP_LEVELS
+        ? image.getMipLevelCount()
+        : std::min(baseMipLevel + mipLevelCount, image.getMipLevelCount());
+
+    bool isWrite = static_cast<bool>(info.writeAccess);
+
+    for (uint32_t mipLevel = baseMipLevel; mipLevel < mipLevelEnd; mipLevel++) {
+        SubresourceState& state = resource.mipStates[mipLevel];
+
+        vk::ImageLayout oldLayout = image.getLayout(mipLevel);
+        vk::PipelineStageFlags2 barrierSrcStages;
+        vk::AccessFlags2 barrierSrcAccess;
+        bool needsBarrier;
+
+        if (!state.usedThisFrame && resource.discardOnFirstUse) {
+            oldLayout = vk::ImageLayout::eUndefined;
+            barrierSrcStages = resource.firstUseStages;
+            barrierSrcAccess = resource.firstUseAccess;
+            needsBarrier = true;
+        } else {
+            bool layoutChanges = oldLayout != info.layout;
+            bool readAfterWrite = state.writeStages && (info.stages & ~state.visibleStages);
+            bool writeAfterWrite = isWrite && state.writeStages;
+            bool writeAfterRead = isWrite && state.readStages;
+
+            needsBarrier = layoutChanges || readAfterWrite || writeAfterWrite || writeAfterRead;
+
+            barrierSrcStages = state.writeStages;
+            barrierSrcAccess = state.writeAccess;
+
+            // only writes and layout transitions need to wait for earlier reads to finish
+            if (layoutChanges || isWrite) barrierSrcStages |= state.readStages;
+
+            // a layout transition is itself a write which later readers in other stages must wait on
+            if (layoutChanges && !isWrite && !state.writeStages) state.writeStages = info.stages;
+        }
+
+        state.usedThisFrame = true;
+
+        if (block) {
+            block->lastStages |= info.stages;
+            block->lastAccess |= info.writeAccess;
+        }
+
+        if (isWrite) {
+            state.writeStages = info.stages;
+            state.writeAccess = info.writeAccess;
+            state.readStages = {};
+            state.visibleStages = {};
+        } else {
+            state.readStages |= info.stages;
+            if (needsBarrier) state.visibleStages |= info.stages;
+        }
+
+        if (!needsBarrier) continue;
+
+        for (uint32_t layer = 0; layer < image.getArrayLayerCount(); layer++)
+            image.getLayout(mipLevel, layer) = info.layout;
+
+        // the batch merges this with the previous mip level's barrier if only the range differs
+        barriers.addImageBarrier(vk::ImageMemoryBarrier2 {}
+            .setSrcStageMask(barrierSrcStages)
+            .setDstStageMask(info.stages)
+            .setImage(image.getImage())
+            .setOldLayout(oldLayout)
+            .setNewLayout(info.layout)
+            .setSrcAccessMask(barrierSrcAccess)
+            .setDstAccessMask(info.access)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setSubresourceRange(vk::ImageSubresourceRange {}
+                .setAspectMask(image.getAspectMask())
+                .setBaseMipLevel(mipLevel)
+                .setLevelCount(1)
+                .setBaseArrayLayer(0)
+                .setLayerCount(image.getArrayLayerCount())));
+    }
+}
+
+void RenderGraph::flushBarriers(vk::CommandBuffer cmd, BarrierBatch& barriers) {
+    if (barriers.empty()) return;
+
+    m_stats.imageBarrierCount += barriers.getBarrierCount();
+    m_stats.barrierCallCount++;
+
+    barriers.flush(cmd);
+}
+
+void RenderGraph::execute(vk::CommandBuffer cmd) {
+    assert(m_compiled);
+
+    GPUProfiler& profiler = IEngine::get().getGPUProfiler();
+
+    m_stats.imageBarrierCount = 0;
+    m_stats.barrierCallCount = 0;
+
+    for (auto& resource : m_images) {
+        resource.touchedThisFrame = false;
+        for (auto& state : resource.mipStates) state.usedThisFrame = false;
+    }
+
+    BarrierBatch barriers;
+    const std::string* openGroup = nullptr;
+
+    for (auto& pass : m_passes) {
+        if (pass.m_culled) continue;
+
+        if (openGroup && *openGroup != pass.m_group) {
+            profiler.endScope(cmd);
+            openGroup = nullptr;
+        }
+
+        if (!openGroup && !pass.m_group.empty()) {
+            profiler.beginScope(cmd, pass.m_group);
+            openGroup = &pass.m_group;
+        }
+
+        for (auto& access : pass.m_accesses)
+            addBarriers(access.image, access.usage, access.baseMipLevel, access.mipLevelCount, barriers);
+
+        flushBarriers(cmd, barriers);
+
+        if (pass.m_group.empty()) profiler.beginScope(cmd, pass.m_name);
+        if (pass.m_recordFunction) pass.m_recordFunction(cmd);
+        if (pass.m_group.empty()) profiler.endScope(cmd);
+    }
+
+    if (openGroup) profiler.endScope(cmd);
+
+    for (ImageHandle handle = 0; handle < m_images.size(); handle++)
+        if (m_images[handle].outputUsage)
+            addBarriers(handle, *m_images[handle].outputUsage, 0, VK_REMAINING_MIP_LEVELS, barriers);
+
+    flushBarriers(cmd, barriers);
+
+    // imported images keep their contents from one frame to the next unless they are rebound
+    for (auto& resource : m_images)
+        if (!resource.transient) resource.discardOnFirstUse = false;
+}
+
+}
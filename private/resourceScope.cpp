@@ -1,43 +1,149 @@
 #include "resourceScope.hpp"
 #include "engine.hpp"
 
+#include <algorithm>
+
 #ifndef RESOURCE_SCOPE_DEBUG
 #define RESOURCE_SCOPE_DEBUG(...)
 #endif
 
 namespace ignis {
 
-int ResourceScope::s_openScopes = 0;
-int ResourceScope::s_nextID = 0;
+std::atomic<int> ResourceScope::s_openScopes = 0;
+std::atomic<int> ResourceScope::s_nextID = 0;
+
+std::mutex               ResourceScope::s_liveScopesMutex;
+std::set<ResourceScope*> ResourceScope::s_liveScopes;
+
+void ResourceScope::registerScope() {
+    std::lock_guard<std::mutex> lock { s_liveScopesMutex };
+    s_liveScopes.insert(this);
+}
 
 ResourceScope::ResourceScope(
     std::string name,
-    bool shouldLog
+    bool shouldLog,
+    bool deferredDeletion
 ) : m_name(name),
-    m_shouldLog(shouldLog)
+    m_shouldLog(shouldLog),
+    m_deferredDeletion(deferredDeletion)
 {
+    registerScope();
     m_ID = s_nextID++;
-    s_openScopes++;
-    IGNIS_RESOURCE_SCOPE_DEBUG("Opened scope %s(%d). %d scopes open.\n", m_name.c_str(), m_ID, s_openScopes);
+    [[maybe_unused]] int openScopes = ++s_openScopes;
+    IGNIS_RESOURCE_SCOPE_DEBUG("Opened scope %s(%d). %d scopes open.\n", m_name.c_str(), m_ID, openScopes);
 }
 
 ResourceScope::~ResourceScope() {
-    executeDeferredCleanupFunctions();
-    s_openScopes--;
-    IGNIS_RESOURCE_SCOPE_DEBUG("Closed scope %s(%d). %d scopes open.\n", m_name.c_str(), m_ID, s_openScopes);
+    retire();
+
+    {
+        std::lock_guard<std::mutex> lock { s_liveScopesMutex };
+        s_liveScopes.erase(this);
+    }
+
+    [[maybe_unused]] int openScopes = --s_openScopes;
+    IGNIS_RESOURCE_SCOPE_DEBUG("Closed scope %s(%d). %d scopes open.\n", m_name.c_str(), m_ID, openScopes);
 }
 
 void ResourceScope::addDeferredCleanupFunction(std::function<void()> func) {
-    m_deferredCleanupCommands.push_back(func);
+    std::lock_guard<std::mutex> lock { m_cleanupMutex };
+    m_cleanupFunctions.push_back(std::move(func));
+    m_cleanupRecords.push_back({ CleanupKind::Function });
+}
+
+void ResourceScope::trackAllocation(vk::DeviceSize bytes) {
+    m_memory->bytes += bytes;
+    m_memory->allocationCount++;
+
+    // runs just before the allocation's own cleanup, which was added first. The counters are swapped along with
+    // the records, so they are still this scope's when it runs
+    addRecord({ CleanupKind::UntrackAllocation, bytes });
+}
+
+std::vector<ResourceScope::MemoryUsage> ResourceScope::getMemoryUsage() {
+    std::vector<MemoryUsage> usage;
+
+    {
+        std::lock_guard<std::mutex> lock { s_liveScopesMutex };
+
+        for (ResourceScope* scope : s_liveScopes) {
+            if (scope->m_memory->allocationCount == 0) continue;
+            usage.push_back({ scope->m_name, scope->m_memory->bytes, scope->m_memory->allocationCount });
+        }
+    }
+
+    std::sort(usage.begin(), usage.end(), [](const MemoryUsage& a, const MemoryUsage& b) { return a.bytes > b.bytes; });
+
+    return usage;
+}
+
+void ResourceScope::retire(uint64_t timelineValue) {
+    bool empty;
+    {
+        std::lock_guard<std::mutex> lock { m_cleanupMutex };
+        empty = m_cleanupRecords.empty();
+    }
+
+    if (m_deferredDeletion && !empty) IEngine::get().deferScopeCleanup(*this, timelineValue);
+    else executeDeferredCleanupFunctions();
 }
 
 void ResourceScope::executeDeferredCleanupFunctions() {
     if (m_shouldLog)
         IGNIS_LOG("Resource Scope", Info, "Cleaning up: " << m_name << " (id " << m_ID << ")");
 
-    while (!m_deferredCleanupCommands.empty()) {
-        m_deferredCleanupCommands.back()();
-        m_deferredCleanupCommands.pop_back();
+    // popped before running, and run outside the lock, since cleanup functions may add more cleanups,
+    // e.g. by destroying a deferred scope
+    while (true) {
+        CleanupRecord         record;
+        std::function<void()> func;
+
+        {
+            std::lock_guard<std::mutex> lock { m_cleanupMutex };
+            if (m_cleanupRecords.empty()) break;
+
+            record = m_cleanupRecords.back();
+            m_cleanupRecords.pop_back();
+
+            if (record.kind == CleanupKind::Function) {
+                func = std::move(m_cleanupFunctions.back());
+                m_cleanupFunctions.pop_back();
+            }
+        }
+
+        if (func) func();
+        else      executeRecord(record);
+    }
+}
+
+void ResourceScope::executeRecord(const CleanupRecord& record) {
+    vk::Device   device { static_cast<VkDevice>(record.owner) };
+    VmaAllocator allocator = static_cast<VmaAllocator>(record.owner);
+
+    switch (record.kind) {
+    case CleanupKind::Function: break;
+    case CleanupKind::UntrackAllocation:
+        m_memory->bytes -= record.handle;
+        m_memory->allocationCount--;
+        break;
+    case CleanupKind::Buffer:
+        vmaDestroyBuffer(allocator, fromBits<VkBuffer>(record.handle), record.allocation);
+        break;
+    case CleanupKind::Image:
+        vmaDestroyImage(allocator, fromBits<VkImage>(record.handle), record.allocation);
+        break;
+    case CleanupKind::Memory:
+        vmaFreeMemory(allocator, record.allocation);
+        break;
+    case CleanupKind::DeviceImage:         device.destroyImage(fromBits<vk::Image>(record.handle)); break;
+    case CleanupKind::ImageView:           device.destroyImageView(fromBits<vk::ImageView>(record.handle)); break;
+    case CleanupKind::Sampler:             device.destroySampler(fromBits<vk::Sampler>(record.handle)); break;
+    case CleanupKind::DescriptorPool:      device.destroyDescriptorPool(fromBits<vk::DescriptorPool>(record.handle)); break;
+    case CleanupKind::DescriptorSetLayout: device.destroyDescriptorSetLayout(fromBits<vk::DescriptorSetLayout>(record.handle)); break;
+    case CleanupKind::PipelineLayout:      device.destroyPipelineLayout(fromBits<vk::PipelineLayout>(record.handle)); break;
+    case CleanupKind::Pipeline:            device.destroyPipeline(fromBits<vk::Pipeline>(record.handle)); break;
+    case CleanupKind::ShaderModule:        device.destroyShaderModule(fromBits<vk::ShaderModule>(record.handle)); break;
     }
 }
 
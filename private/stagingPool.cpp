@@ -0,0 +1,119 @@
+#include "stagingPool.hpp"
+#include "bufferBuilder.hpp"
+
+namespace ignis {
+
+void StagingPool::setup(ResourceScope& scope, vk::DeviceSize chunkSize, uint32_t maxFreeChunks) {
+    m_chunkSize = chunkSize;
+    m_maxFreeChunks = maxFreeChunks;
+
+    scope.addDeferredCleanupFunction([&]() {
+        m_freeChunks.clear();
+        m_openChunks.clear();
+        m_chunkCount = 0;
+    });
+}
+
+vk::ResultValue<std::unique_ptr<StagingChunk>> StagingPool::createChunk(vk::DeviceSize size) {
+    auto chunk = std::make_unique<StagingChunk>();
+    chunk->scope = std::make_unique<ResourceScope>("Staging chunk");
+    chunk->size = size;
+
+    vk::ResultValue<Allocated<vk::Buffer>> buffer = BufferBuilder { *chunk->scope }
+        .setAllocationUsage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+        .setAllocationFlags(VMA_ALLOCATION_CREATE_MAPPED_BIT)
+        .setBufferUsage(vk::BufferUsageFlagBits::eTransferSrc)
+        .setSize(size)
+        .build();
+
+    if (buffer.result != vk::Result::eSuccess) return { buffer.result, nullptr };
+
+    chunk->buffer = buffer.value;
+    chunk->cpuPtr = static_cast<uint8_t*>(chunk->buffer.getInfo().pMappedData);
+    m_chunkCount++;
+
+    return { vk::Result::eSuccess, std::move(chunk) };
+}
+
+vk::ResultValue<StagingAllocation> StagingPool::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (!m_openChunks.empty()) {
+        StagingChunk& chunk = *m_openChunks.back();
+        vk::DeviceSize offset = (chunk.used + alignment - 1) & ~(alignment - 1);
+
+        if (offset + size <= chunk.size) {
+            chunk.used = offset + size;
+            return { vk::Result::eSuccess, StagingAllocation { *chunk.buffer, offset, chunk.cpuPtr + offset } };
+        }
+    }
+
+    std::unique_ptr<StagingChunk> chunk;
+
+    if (size <= m_chunkSize && !m_freeChunks.empty()) {
+        chunk = std::move(m_freeChunks.back());
+        m_freeChunks.pop_back();
+    } else {
+        auto created = createChunk(std::max(size, m_chunkSize));
+        if (created.result != vk::Result::eSuccess) return { created.result, {} };
+        chunk = std::move(created.value);
+    }
+
+    chunk->used = size;
+    StagingAllocation allocation { *chunk->buffer, 0, chunk->cpuPtr };
+
+    // a dedicated chunk is full straight away, so keep allocating from the current one
+    if (chunk->size > m_chunkSize && !m_openChunks.empty())
+        m_openChunks.insert(m_openChunks.end() - 1, std::move(chunk));
+    else
+        m_openChunks.push_back(std::move(chunk));
+
+    return { vk::Result::eSuccess, allocation };
+}
+
+std::vector<std::unique_ptr<StagingChunk>> StagingPool::takeOpenChunks() {
+    std::vector<std::unique_ptr<StagingChunk>> chunks = std::move(m_openChunks);
+    m_openChunks.clear();
+
+    for (auto& chunk : chunks) {
+        // a no-op for host coherent memory
+        vk::resultCheck(chunk->buffer.flush(), "Failed to flush a staging chunk");
+        m_bytesInFlight += chunk->used;
+    }
+
+    m_peakBytesInFlight = std::max(m_peakBytesInFlight, m_bytesInFlight);
+
+    return chunks;
+}
+
+void StagingPool::retire(std::vector<std::unique_ptr<StagingChunk>>&& chunks) {
+    for (auto& chunk : chunks) {
+        m_bytesInFlight -= chunk->used;
+        chunk->used = 0;
+
+        if (chunk->size == m_chunkSize && m_freeChunks.size() < m_maxFreeChunks) {
+            m_freeChunks.push_back(std::move(chunk));
+        } else {
+            // the batch has finished, so the buffer can be destroyed straight away
+            chunk = nullptr;
+            m_chunkCount--;
+        }
+    }
+
+    chunks.clear();
+}
+
+StagingPool::Stats StagingPool::getStats() const {
+    Stats stats {
+        .bytesInFlight = m_bytesInFlight,
+        .peakBytesInFlight = m_peakBytesInFlight,
+        .chunkCount = m_chunkCount,
+        .freeChunkCount = static_cast<uint32_t>(m_freeChunks.size()),
+    };
+
+    for (auto& chunk : m_openChunks) stats.bytesPending += chunk->used;
+
+    return stats;
+}
+
+}
@@ -34,9 +34,7 @@ vk::DescriptorPool DescriptorPoolBuilder::build() {
         .setMaxSets(m_maxSetCount)
         .setPoolSizes(m_poolSizes));
     
-    r_scope.addDeferredCleanupFunction([=, device = getDevice()]() {
-        device.destroyDescriptorPool(pool);
-    });
+    r_scope.addDeferredDestroy(getDevice(), pool);
 
     return pool;
 }
@@ -60,9 +58,7 @@ vk::DescriptorSetLayout DescriptorLayoutBuilder::build() {
     vk::DescriptorSetLayout layout = getDevice().createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo {}
         .setBindings(m_bindings));
 
-    r_scope.addDeferredCleanupFunction([=, device = getDevice()]() {
-        device.destroyDescriptorSetLayout(layout);
-    });
+    r_scope.addDeferredDestroy(getDevice(), layout);
 
     return layout;
 }
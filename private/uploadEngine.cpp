@@ -0,0 +1,399 @@
+#include "uploadEngine.hpp"
+#include "engine.hpp"
+#include "image.hpp"
+
+namespace ignis {
+
+bool UploadToken::isComplete() const {
+    return IEngine::get().getUploadEngine().isComplete(*this);
+}
+
+void UploadToken::wait() const {
+    IEngine::get().getUploadEngine().wait(*this);
+}
+
+void UploadEngine::setup(
+    ResourceScope& scope,
+    vk::Queue transferQueue, uint32_t transferQueueIndex,
+    vk::Queue graphicsQueue, uint32_t graphicsQueueIndex
+) {
+    m_device = IEngine::get().getDevice();
+
+    m_transferQueue      = transferQueue;
+    m_transferQueueIndex = transferQueueIndex;
+
+    m_graphicsQueue      = graphicsQueue;
+    m_graphicsQueueIndex = graphicsQueueIndex;
+
+    // registered before the cleanup below, so the pools outlive the batches whose command buffers they own
+    for (auto [pool, queueFamilyIndex] : { std::pair { &m_transferCmdPool, transferQueueIndex }, std::pair { &m_graphicsCmdPool, graphicsQueueIndex } }) {
+        *pool = m_device.createCommandPool(vk::CommandPoolCreateInfo {}
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient)
+            .setQueueFamilyIndex(queueFamilyIndex));
+
+        scope.addDeferredCleanupFunction([device = m_device, pool = *pool]() { device.destroyCommandPool(pool); });
+    }
+
+    m_stagingPool.setup(scope, s_stagingChunkSize, s_maxFreeStagingChunks);
+
+    scope.addDeferredCleanupFunction([&]() {
+        std::lock_guard<std::mutex> lock { m_mutex };
+
+        // the open batch is never submitted, its command buffers are freed along with their pools
+        m_stagingPool.retire(m_stagingPool.takeOpenChunks());
+        m_openScope.executeDeferredCleanupFunctions();
+        m_transferCmd = VK_NULL_HANDLE;
+        m_graphicsCmd = VK_NULL_HANDLE;
+
+        for (auto& batch : m_inFlight) {
+            auto _ = m_device.waitForFences(batch.fence, true, UINT64_MAX);
+            m_stagingPool.retire(std::move(batch.stagingChunks));
+            batch.scope.executeDeferredCleanupFunctions();
+
+            m_device.destroyFence(batch.fence);
+            if (batch.semaphore) m_device.destroySemaphore(batch.semaphore);
+        }
+
+        for (auto& fence : m_freeFences) m_device.destroyFence(fence);
+        for (auto& semaphore : m_freeSemaphores) m_device.destroySemaphore(semaphore);
+
+        m_inFlight.clear();
+        m_freeFences.clear();
+        m_freeSemaphores.clear();
+        m_freeTransferCmds.clear();
+        m_freeGraphicsCmds.clear();
+    });
+}
+
+vk::ResultValue<StagingAllocation> UploadEngine::stage(const void* data, vk::DeviceSize size) {
+    // 16 bytes covers the texel block size of every format, as required for buffer to image copies
+    vk::ResultValue<StagingAllocation> staging = m_stagingPool.allocate(size, 16);
+    if (staging.result == vk::Result::eSuccess) std::memcpy(staging.value.cpuPtr, data, size);
+    return staging;
+}
+
+vk::CommandBuffer UploadEngine::getTransferCommands() {
+    // without a dedicated queue, copies are recorded alongside the graphics work and no ownership transfer is needed
+    if (!hasDedicatedQueue()) return getGraphicsCommands();
+
+    if (!m_transferCmd) m_transferCmd = beginCommands(m_transferCmdPool, m_freeTransferCmds);
+    return m_transferCmd;
+}
+
+vk::CommandBuffer UploadEngine::getGraphicsCommands() {
+    if (!m_graphicsCmd) m_graphicsCmd = beginCommands(m_graphicsCmdPool, m_freeGraphicsCmds);
+    return m_graphicsCmd;
+}
+
+vk::CommandBuffer UploadEngine::beginCommands(vk::CommandPool pool, std::vector<vk::CommandBuffer>& freeCmds) {
+    vk::CommandBuffer cmd;
+
+    if (!freeCmds.empty()) {
+        cmd = freeCmds.back();
+        freeCmds.pop_back();
+        m_cmdStats.reuses++;
+    } else {
+        cmd = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo {}
+            .setCommandBufferCount(1)
+            .setCommandPool(pool)
+            .setLevel(vk::CommandBufferLevel::ePrimary))[0];
+        m_cmdStats.allocations++;
+    }
+
+    // begin implicitly resets command buffers from a pool created with eResetCommandBuffer
+    cmd.begin(vk::CommandBufferBeginInfo {}.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    return cmd;
+}
+
+void UploadEngine::flushAcquireBarriers() {
+    if (m_acquireBarriers.empty()) return;
+
+    // the graphics submission waits on the transfer submission's semaphore at all stages, which covers the transfer stage
+    m_acquireBarriers.flush(getGraphicsCommands());
+}
+
+vk::ResultValue<UploadToken> UploadEngine::uploadBuffer(
+    vk::Buffer dst, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset,
+    vk::PipelineStageFlags dstStages, vk::AccessFlags dstAccess, bool concurrent
+) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    vk::ResultValue<StagingAllocation> staging = stage(data, size);
+    if (staging.result != vk::Result::eSuccess)
+        return { staging.result, UploadToken {} };
+
+    getTransferCommands().copyBuffer(staging.value.buffer, dst, vk::BufferCopy {}
+        .setSrcOffset(staging.value.offset)
+        .setDstOffset(dstOffset)
+        .setSize(size));
+
+    auto barrier = vk::BufferMemoryBarrier {}
+        .setBuffer(dst)
+        .setOffset(dstOffset)
+        .setSize(size)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(dstAccess);
+
+    // the release half makes the writes available, the acquire half makes them visible
+    if (hasDedicatedQueue() && !concurrent) {
+        barrier
+            .setSrcQueueFamilyIndex(m_transferQueueIndex)
+            .setDstQueueFamilyIndex(m_graphicsQueueIndex);
+
+        m_releaseBarriers.addBufferBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+            vk::BufferMemoryBarrier { barrier }.setDstAccessMask({}));
+        barrier.setSrcAccessMask({});
+    }
+
+    m_acquireBarriers.addBufferBarrier(vk::PipelineStageFlagBits::eTransfer, dstStages, barrier);
+
+    return { vk::Result::eSuccess, UploadToken { m_openBatch } };
+}
+
+vk::ResultValue<UploadToken> UploadEngine::uploadImage(
+    Image& image, const void* data, vk::DeviceSize size,
+    const std::vector<vk::BufferImageCopy>& regions,
+    vk::ImageLayout finalLayout, bool generateMipMap, bool concurrent, MipGenerator::Filter mipFilter
+) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    vk::ResultValue<StagingAllocation> staging = stage(data, size);
+    if (staging.result != vk::Result::eSuccess)
+        return { staging.result, UploadToken {} };
+
+    // regions are relative to `data`, which now starts part way through a staging chunk
+    std::vector<vk::BufferImageCopy> stagedRegions = regions;
+    for (auto& region : stagedRegions) region.bufferOffset += staging.value.offset;
+
+    vk::CommandBuffer transferCmd = getTransferCommands();
+
+    // every mip level is overwritten, either by the copy or by mip generation, so the old contents are discarded
+    image.transitionLayout()
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .execute(transferCmd);
+
+    transferCmd.copyBufferToImage(staging.value.buffer, image.getImage(), vk::ImageLayout::eTransferDstOptimal, stagedRegions);
+
+    // mips are generated on the graphics queue, after the image has been acquired
+    vk::ImageLayout        acquiredLayout = generateMipMap ? vk::ImageLayout::eTransferDstOptimal : finalLayout;
+    vk::PipelineStageFlags dstStages      = generateMipMap ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eAllCommands;
+    vk::AccessFlags        dstAccess      = generateMipMap
+        ? vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite
+        : vk::AccessFlagBits::eShaderRead;
+
+    auto barrier = vk::ImageMemoryBarrier {}
+        .setImage(image.getImage())
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(acquiredLayout)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(dstAccess)
+        .setSubresourceRange(vk::ImageSubresourceRange {}
+            .setAspectMask(image.getAspectMask())
+            .setLevelCount(image.getMipLevelCount())
+            .setLayerCount(image.getArrayLayerCount()));
+
+    // the layout transition happens once, between the release and the acquire, so both must describe it
+    if (hasDedicatedQueue() && !concurrent) {
+        barrier
+            .setSrcQueueFamilyIndex(m_transferQueueIndex)
+            .setDstQueueFamilyIndex(m_graphicsQueueIndex);
+
+        m_releaseBarriers.addImageBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+            vk::ImageMemoryBarrier { barrier }.setDstAccessMask({}));
+        barrier.setSrcAccessMask({});
+    }
+
+    m_acquireBarriers.addImageBarrier(vk::PipelineStageFlagBits::eTransfer, dstStages, barrier);
+
+    for (uint32_t layer = 0; layer < image.getArrayLayerCount(); layer++)
+    for (uint32_t level = 0; level < image.getMipLevelCount(); level++)
+        image.getLayout(level, layer) = acquiredLayout;
+
+    if (generateMipMap) {
+        flushAcquireBarriers();
+
+        vk::CommandBuffer graphicsCmd = getGraphicsCommands();
+        image.generateMipMap(graphicsCmd, 0, -1, &m_openScope, mipFilter);
+
+        // compute mip generation leaves the top level in a different layout to the levels it wrote
+        BarrierBatch barriers;
+
+        if (!image.layoutIs(finalLayout, 0, 1))
+            image.transitionLayout(0, 1)
+                .setNewLayout(finalLayout)
+                .execute(barriers);
+
+        if (image.getMipLevelCount() > 1)
+            image.transitionLayout(1)
+                .setNewLayout(finalLayout)
+                .execute(barriers);
+
+        barriers.flush(graphicsCmd);
+    }
+
+    return { vk::Result::eSuccess, UploadToken { m_openBatch } };
+}
+
+UploadToken UploadEngine::recordGraphicsCommands(std::function<void(vk::CommandBuffer cmd)> func) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    flushAcquireBarriers();
+    func(getGraphicsCommands());
+
+    return UploadToken { m_openBatch };
+}
+
+UploadToken UploadEngine::flush() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    UploadToken token { m_openBatch };
+    flushLocked();
+    return token;
+}
+
+void UploadEngine::flushLocked() {
+    if (!m_transferCmd && !m_graphicsCmd) return;
+
+    flushAcquireBarriers();
+
+    Batch batch { .id = m_openBatch };
+
+    if (!m_freeFences.empty()) {
+        batch.fence = m_freeFences.back();
+        m_freeFences.pop_back();
+    } else {
+        batch.fence = m_device.createFence(vk::FenceCreateInfo {});
+    }
+
+    vk::SubmitInfo         graphicsSubmitInfo;
+    vk::PipelineStageFlags graphicsWaitStages = vk::PipelineStageFlagBits::eAllCommands;
+
+    if (m_transferCmd) {
+        m_releaseBarriers.flush(m_transferCmd);
+
+        if (!m_freeSemaphores.empty()) {
+            batch.semaphore = m_freeSemaphores.back();
+            m_freeSemaphores.pop_back();
+        } else {
+            batch.semaphore = m_device.createSemaphore(vk::SemaphoreCreateInfo {});
+        }
+
+        m_transferCmd.end();
+        batch.transferCmd = m_transferCmd;
+
+        auto queueLock = IEngine::get().lockQueue(m_transferQueue);
+        m_transferQueue.submit(vk::SubmitInfo {}
+            .setCommandBuffers(m_transferCmd)
+            .setSignalSemaphores(batch.semaphore));
+
+        graphicsSubmitInfo
+            .setWaitSemaphores(batch.semaphore)
+            .setWaitDstStageMask(graphicsWaitStages);
+    }
+
+    // every transfer is acquired on the graphics queue, so a batch always ends with a graphics submission,
+    // and batches complete in the order they were submitted
+    batch.graphicsCmd = getGraphicsCommands();
+    batch.graphicsCmd.end();
+
+    {
+        auto queueLock = IEngine::get().lockQueue(m_graphicsQueue);
+        m_graphicsQueue.submit(graphicsSubmitInfo.setCommandBuffers(batch.graphicsCmd), batch.fence);
+    }
+
+    batch.stagingChunks = m_stagingPool.takeOpenChunks();
+    batch.scope = std::move(m_openScope);
+
+    m_inFlight.push_back(std::move(batch));
+
+    m_releaseBarriers.clear();
+    m_transferCmd = VK_NULL_HANDLE;
+    m_graphicsCmd = VK_NULL_HANDLE;
+    m_openBatch++;
+}
+
+void UploadEngine::collect() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    collectLocked();
+}
+
+void UploadEngine::collectLocked() {
+    while (!m_inFlight.empty()) {
+        Batch& batch = m_inFlight.front();
+
+        // a thread waiting on the fence retires the batch itself once it wakes
+        if (batch.waiters > 0 || m_device.getFenceStatus(batch.fence) != vk::Result::eSuccess) break;
+
+        m_device.resetFences(batch.fence);
+        m_freeFences.push_back(batch.fence);
+
+        // the graphics submission which waited on it has finished, so it is unsignalled and can be reused
+        if (batch.semaphore) m_freeSemaphores.push_back(batch.semaphore);
+
+        // as has the transfer submission, which the graphics submission waited on
+        if (batch.transferCmd) m_freeTransferCmds.push_back(batch.transferCmd);
+        m_freeGraphicsCmds.push_back(batch.graphicsCmd);
+
+        m_stagingPool.retire(std::move(batch.stagingChunks));
+        batch.scope.executeDeferredCleanupFunctions();
+
+        m_completedBatch = batch.id;
+        m_inFlight.pop_front();
+    }
+}
+
+bool UploadEngine::isComplete(UploadToken token) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    collectLocked();
+    return token.getBatch() <= m_completedBatch;
+}
+
+void UploadEngine::wait(UploadToken token) {
+    std::unique_lock<std::mutex> lock { m_mutex };
+
+    if (token.getBatch() == m_openBatch) flushLocked();
+
+    collectLocked();
+    if (token.getBatch() <= m_completedBatch) return;
+
+    auto findBatch = [&]() -> Batch& {
+        for (auto& batch : m_inFlight) if (batch.id == token.getBatch()) return batch;
+        throw std::runtime_error("Waiting on an upload batch which was never submitted");
+    };
+
+    // the fence can't be recycled while anyone is waiting on it, so the lock can be released for the wait
+    Batch& batch = findBatch();
+    batch.waiters++;
+    vk::Fence fence = batch.fence;
+
+    lock.unlock();
+    vk::Result result = m_device.waitForFences(fence, true, UINT64_MAX);
+    lock.lock();
+
+    findBatch().waiters--;
+    collectLocked();
+
+    vk::resultCheck(result, "Failed to wait for upload batch");
+}
+
+StagingPool::Stats UploadEngine::getStagingStats() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    return m_stagingPool.getStats();
+}
+
+CommandBufferStats UploadEngine::collectCommandBufferStats() {
+    std::lock_guard<std::mutex> lock { m_mutex };
+
+    CommandBufferStats stats = m_cmdStats;
+    m_cmdStats = {};
+    return stats;
+}
+
+}
@@ -0,0 +1,64 @@
+#include "workerPool.hpp"
+
+namespace ignis {
+
+void WorkerPool::setup(ResourceScope& scope, uint32_t threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_stopping = false;
+
+    for (uint32_t workerIndex = 0; workerIndex < threadCount; workerIndex++)
+        m_threads.emplace_back([this, workerIndex]() { workerMain(workerIndex); });
+
+    scope.addDeferredCleanupFunction([&]() {
+        {
+            std::lock_guard<std::mutex> lock { m_mutex };
+            m_stopping = true;
+        }
+
+        m_workAvailable.notify_all();
+
+        for (auto& thread : m_threads) thread.join();
+        m_threads.clear();
+    });
+}
+
+void WorkerPool::workerMain(uint32_t workerIndex) {
+    std::unique_lock<std::mutex> lock { m_mutex };
+
+    while (true) {
+        m_workAvailable.wait(lock, [&]() { return m_stopping || m_nextJob < m_jobCount; });
+
+        if (m_stopping) return;
+
+        // claim jobs one at a time so uneven chunks balance themselves across workers
+        while (m_nextJob < m_jobCount) {
+            uint32_t index = m_nextJob++;
+
+            lock.unlock();
+            m_job(index, workerIndex);
+            lock.lock();
+
+            if (++m_finishedJobs == m_jobCount) m_workFinished.notify_all();
+        }
+    }
+}
+
+void WorkerPool::dispatch(uint32_t count, std::function<void(uint32_t index, uint32_t workerIndex)> func) {
+    if (count == 0) return;
+
+    std::unique_lock<std::mutex> lock { m_mutex };
+
+    m_job = std::move(func);
+    m_jobCount = count;
+    m_nextJob = 0;
+    m_finishedJobs = 0;
+
+    m_workAvailable.notify_all();
+    m_workFinished.wait(lock, [&]() { return m_finishedJobs == m_jobCount; });
+
+    m_job = nullptr;
+    m_jobCount = 0;
+}
+
+}
@@ -4,6 +4,8 @@
 
 namespace ignis {
 
+class UploadToken;
+
 class BaseAllocated {
 protected:
     VmaAllocator getAllocator();
@@ -15,6 +17,12 @@ public:
     VmaAllocation m_allocation;
 
     VmaAllocationInfo getInfo();
+
+    /**
+     * @brief The properties of the memory type the allocation was placed in
+     */
+    vk::MemoryPropertyFlags getMemoryProperties();
+
     vk::ResultValue<void*> map();
     void unmap();
     vk::Result flush();
@@ -68,39 +76,22 @@ struct Allocated<vk::Buffer> : public BaseAllocated {
     vk::Buffer* operator ->() { return &m_inner; }
 
     /**
-     * @brief Copies data via a staging buffer
+     * @brief Copies data via a staging buffer, batched by the engine's UploadEngine. Returns once the data
+     *        has been staged, the buffer can be used on the graphics queue from the next frame onwards
      * 
-     * @param fence The fence to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
-     * @param signalSemaphore The semaphore to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
+     * @param p_token Optional output for the upload's completion token
+     * @param concurrent True if the buffer was created with concurrent sharing, so needs no ownership transfer
      */
-    vk::Result stagedCopyData(const void* data, uint32_t size, vk::Fence fence = {}, vk::Semaphore signalSemaphore = {});
+    vk::Result stagedCopyData(const void* data, uint32_t size, UploadToken* p_token = nullptr, bool concurrent = false);
 
-    /**
-     * @brief Copies data via a staging buffer
-     * 
-     * @param fence The fence to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
-     * @param signalSemaphore The semaphore to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
-     */
     template<typename T>
-    vk::Result stagedCopyData(const T* data, uint32_t count, vk::Fence fence = {}, vk::Semaphore signalSemaphore = {}) {
-        return stagedCopyData(static_cast<void*>(data), count * sizeof(T), fence, signalSemaphore);
+    vk::Result stagedCopyData(const T* data, uint32_t count, UploadToken* p_token = nullptr, bool concurrent = false) {
+        return stagedCopyData(static_cast<const void*>(data), count * sizeof(T), p_token, concurrent);
     }
 
-    /**
-     * @brief Copies data via a staging buffer
-     * 
-     * @param fence The fence to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
-     * @param signalSemaphore The semaphore to signal for an asynchronous staged copy.
-     *  If one is provided, the function will be called asynchronously
-     */
     template<typename T>
-    vk::Result stagedCopyData(const std::vector<T>& data, vk::Fence fence = {}, vk::Semaphore signalSemaphore = {}) {
-        return stagedCopyData<T>(data.data(), data.size(), fence, signalSemaphore);
+    vk::Result stagedCopyData(const std::vector<T>& data, UploadToken* p_token = nullptr, bool concurrent = false) {
+        return stagedCopyData<T>(data.data(), data.size(), p_token, concurrent);
     }
 };
 
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "libraries.hpp"
+
+namespace ignis {
+
+struct BarrierStats {
+    uint32_t barriers = 0;
+    uint32_t calls    = 0;
+};
+
+/**
+ * @brief Collects memory, buffer and image barriers, then records them all in a single pipelineBarrier2,
+ *        each with its own stage masks. Consecutive image barriers which only differ by mip level are
+ *        merged into one. Synchronization 1 barriers are converted, their stages and access bits are the
+ *        same in the 64 bit flags
+ */
+class BarrierBatch {
+    std::vector<vk::MemoryBarrier2>       m_memoryBarriers;
+    std::vector<vk::BufferMemoryBarrier2> m_bufferBarriers;
+    std::vector<vk::ImageMemoryBarrier2>  m_imageBarriers;
+
+public:
+    BarrierBatch& addMemoryBarrier(const vk::MemoryBarrier2& barrier);
+    BarrierBatch& addBufferBarrier(const vk::BufferMemoryBarrier2& barrier);
+    BarrierBatch& addImageBarrier(const vk::ImageMemoryBarrier2& barrier);
+
+    BarrierBatch& addMemoryBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::MemoryBarrier& barrier);
+    BarrierBatch& addBufferBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::BufferMemoryBarrier& barrier);
+    BarrierBatch& addImageBarrier(vk::PipelineStageFlags srcStageMask, vk::PipelineStageFlags dstStageMask, const vk::ImageMemoryBarrier& barrier);
+
+    bool     empty() const { return getBarrierCount() == 0; }
+    uint32_t getBarrierCount() const { return m_memoryBarriers.size() + m_bufferBarriers.size() + m_imageBarriers.size(); }
+
+    /**
+     * @brief Record the barriers and clear the batch. Does nothing if it is empty
+     *
+     * @param cmd Optional command buffer to record into. If none is provided, they are recorded into the
+     *  upload engine's next batch, which is submitted before the next frame
+     */
+    void flush(vk::CommandBuffer cmd = VK_NULL_HANDLE);
+
+    void clear();
+
+    static vk::PipelineStageFlags2 toStageFlags2(vk::PipelineStageFlags stages) {
+        return vk::PipelineStageFlags2 { static_cast<VkPipelineStageFlags>(stages) };
+    }
+
+    static vk::AccessFlags2 toAccessFlags2(vk::AccessFlags access) {
+        return vk::AccessFlags2 { static_cast<VkAccessFlags>(access) };
+    }
+};
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "libraries.hpp"
+
+#include <vector>
+
+namespace ignis {
+
+/**
+ * @brief Bounding box block compressors, for cooking textures offline. `rgba` is tightly packed RGBA8, and
+ *        blocks past the right or bottom edge repeat the last column or row. The output is tightly packed
+ *        blocks, as ImageBuilder::loadMipChain expects
+ */
+std::vector<uint8_t> compressBC1(const uint8_t* rgba, uint32_t width, uint32_t height);
+std::vector<uint8_t> compressBC3(const uint8_t* rgba, uint32_t width, uint32_t height);
+std::vector<uint8_t> compressBC4(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t channel = 0);
+std::vector<uint8_t> compressBC5(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+}
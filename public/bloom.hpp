@@ -4,6 +4,7 @@
 #include "libraries.hpp"
 #include "uniform.hpp"
 #include "image.hpp"
+#include "renderGraph.hpp"
 
 namespace ignis {
 
@@ -14,16 +15,17 @@ class BloomPostProcess {
 
     PipelineData m_pipeline;
 
-    Allocated<Image> m_hBlurChain;
-    Allocated<Image> m_vBlurChain;
+    // transient images owned by the render graph. The horizontal chain is dead once the blur has finished
+    RenderGraph::ImageHandle m_hBlurHandle = RenderGraph::s_invalidHandle;
+    RenderGraph::ImageHandle m_vBlurHandle = RenderGraph::s_invalidHandle;
+    Image*                   m_hBlurChain  = nullptr;
+    Image*                   m_vBlurChain  = nullptr;
+
+    static constexpr uint32_t s_maxMipLevelCount = 9;
 
     std::vector<vk::ImageView> m_hBlurChainViews;
     std::vector<vk::ImageView> m_vBlurChainViews;
 
-    void filterHighlights(vk::CommandBuffer cmd);
-    void blurDownMipChain(vk::CommandBuffer cmd);
-    void overlayUpMipChain(vk::CommandBuffer cmd);
-
     struct PassConfig {
         enum Operation : int {
             Filter = 0, Blur, Overlay
@@ -48,13 +50,31 @@ class BloomPostProcess {
         uint32_t mipLevel = 0,
         vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear);
 
+    void recordPass(
+        vk::CommandBuffer cmd,
+        Image& image, vk::ImageView imageView,
+        uint32_t mipLevel,
+        vk::AttachmentLoadOp loadOp,
+        vk::DescriptorSet source,
+        PassConfig config);
+
 public:
     float clipping   = 1.0f;
     float dispersion = 1.0f;
     float mixing     = 0.5f;
 
-    bool setup(ResourceScope& scope);
-    void draw(vk::CommandBuffer cmd);
+    /**
+     * @brief Add the filter, blur and overlay passes, which read and write the G-buffer's emissive image.
+     *        The blur chains are declared as transient images of `graph`
+     */
+    void addPasses(RenderGraph& graph);
+
+    /**
+     * @brief Create the pipeline and descriptors, once `graph` has been compiled with this pass's images.
+     *        The passes record nothing until this has succeeded
+     */
+    bool setup(ResourceScope& scope, RenderGraph& graph);
+    bool isReady() const;
 };
 
 }
@@ -2,6 +2,7 @@
 
 #include "builder.hpp"
 #include "allocated.hpp"
+#include "common.hpp"
 
 namespace ignis {
 
@@ -15,6 +16,7 @@ public:
 
     BufferBuilder& addQueueFamilyIndices(std::vector<uint32_t> indices);
     BufferBuilder& setAllocationUsage(VmaMemoryUsage usage);
+    BufferBuilder& setAllocationFlags(VmaAllocationCreateFlags flags);
     BufferBuilder& setSize(uint32_t size);
     BufferBuilder& setBufferUsage(vk::BufferUsageFlags usage);
 
@@ -50,7 +52,7 @@ public:
         vk::ResultValue<Allocated<vk::Buffer>> ret = build();
 
         if (ret.result == vk::Result::eSuccess)
-            ret.result = ret.value.stagedCopyData(data, size);
+            ret.result = ret.value.stagedCopyData(data, size, nullptr, uniqueQueueFamilyIndices(m_queueFamilyIndices).size() > 1);
 
         return ret;
     }
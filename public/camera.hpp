@@ -21,11 +21,21 @@ struct Camera {
     float far = 1'000.f;
     float fov = 45.f;
 
-    std::vector<ignis::Allocated<vk::Buffer>> m_buffers;
+    // a dynamic uniform buffer in the frame allocator's buffer, bound with getDynamicOffset()
     ignis::Uniform uniform;
 
     void setup(ResourceScope& scope);
     CameraUniform getUniformData(vk::Extent2D viewport);
+
+    /**
+     * @brief Write this frame's uniform data into the frame allocator. Call from prepareFrame
+     */
+    bool update(vk::Extent2D viewport);
+
+    uint32_t getDynamicOffset() const { return m_dynamicOffset; }
+
+private:
+    uint32_t m_dynamicOffset = 0;
 };
 
 }
\ No newline at end of file
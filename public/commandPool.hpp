@@ -0,0 +1,96 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+
+#include <mutex>
+
+namespace ignis {
+
+struct CommandBufferStats {
+    uint32_t allocations = 0;
+    uint32_t reuses      = 0;
+};
+
+/**
+ * @brief Command pool owned by a single frame in flight. All command buffers allocated from it
+ *        are recycled at once by reset(), which must only be called once that frame's fence has signalled
+ */
+class FrameCommandPool {
+    vk::CommandPool m_pool;
+
+    std::vector<vk::CommandBuffer> m_primaryBuffers;
+    std::vector<vk::CommandBuffer> m_secondaryBuffers;
+    uint32_t                       m_primaryCursor   = 0;
+    uint32_t                       m_secondaryCursor = 0;
+
+    CommandBufferStats m_stats;
+
+public:
+    void setup(ResourceScope& scope, uint32_t queueFamilyIndex);
+
+    /**
+     * @brief Resets the pool and every command buffer allocated from it
+     */
+    void reset();
+
+    /**
+     * @brief Get a command buffer that is valid until the next reset. Reuses a previously allocated
+     *        command buffer where possible, so the steady state performs no allocations
+     */
+    vk::CommandBuffer allocate(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+    vk::CommandPool getPool() const { return m_pool; }
+
+    /**
+     * @brief Allocation counts since the last reset
+     */
+    const CommandBufferStats& getStats() const { return m_stats; }
+};
+
+/**
+ * @brief Hands out one time command buffers, e.g. for staged copies and layout transitions,
+ *        and recycles them once the GPU has finished executing them
+ */
+class OneTimeCommandPool {
+    struct InFlight {
+        vk::CommandBuffer cmd;
+        vk::Fence         fence;
+    };
+
+    std::mutex m_mutex;
+
+    vk::Device      m_device;
+    vk::CommandPool m_pool;
+
+    std::vector<vk::CommandBuffer> m_freeBuffers;
+    std::vector<vk::Fence>         m_freeFences;
+    std::vector<InFlight>          m_inFlight;
+
+    CommandBufferStats m_stats;
+
+    /**
+     * @brief Moves every command buffer whose submission has completed back to the free list
+     */
+    void recycle();
+
+public:
+    void setup(ResourceScope& scope, uint32_t queueFamilyIndex);
+
+    vk::CommandBuffer begin();
+
+    /**
+     * @brief Ends and submits a command buffer created by OneTimeCommandPool::begin
+     *
+     * @param wait If true, block until the submission has finished. The command buffer is recycled by the
+     *  waiting thread, so the pool's fence is never reset while it is being waited on
+     */
+    void submit(vk::CommandBuffer cmd, vk::Queue queue, vk::SubmitInfo submitInfo, bool wait = false);
+
+    /**
+     * @brief Allocation counts since the last call, resets the counters
+     */
+    CommandBufferStats collectStats();
+};
+
+}
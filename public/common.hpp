@@ -22,4 +22,14 @@ T getValue(vkb::Result<T> rv, const char* message) {
     return *rv;
 }
 
+/**
+ * @brief Removes duplicate queue family indices. Resources are only shared concurrently
+ *        if this leaves more than one, e.g. when graphics and compute use different families
+ */
+inline std::vector<uint32_t> uniqueQueueFamilyIndices(std::vector<uint32_t> indices) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return indices;
+}
+
 }
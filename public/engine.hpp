@@ -6,8 +6,19 @@
 #include "log.hpp"
 #include "uniform.hpp"
 #include "pipelineBuilder.hpp"
+#include "commandPool.hpp"
+#include "profiler.hpp"
+#include "renderGraph.hpp"
+#include "workerPool.hpp"
+#include "uploadEngine.hpp"
+#include "frameAllocator.hpp"
+#include "geometryPool.hpp"
+#include "barrierBatch.hpp"
+#include "mipGenerator.hpp"
 
 #include <chrono>
+#include <atomic>
+#include <deque>
 
 #define IGNIS_LOG(category, type, msg) { \
     std::stringstream ss; \
@@ -28,8 +39,11 @@ public:
 
     Log& getLog() { return m_log; }
 
+    GPUProfiler& getGPUProfiler() { return m_gpuProfiler; }
+
     ResourceScope& getGlobalResourceScope()        { return m_globalResourceScope; }
     ResourceScope& getUntilWindowSizeChangeScope() { return m_untilWindowSizeChangeScope; }
+    ResourceScope& getUntilSceneSizeChangeScope()  { return m_untilSceneSizeChangeScope; }
 
     vk::DispatchLoaderDynamic& getDynamicDispatchLoader() { return m_dispatchLoaderDynamic; }
 
@@ -37,49 +51,310 @@ public:
     VmaAllocator       getAllocator()      const { return m_allocator; }
     vk::Instance       getInstance()       const { return { m_instance }; }
     vk::PhysicalDevice getPhysicalDevice() const { return { m_phys_device }; }
+    bool               supportsBlockCompression() const { return m_phys_device.features.textureCompressionBC; }
     vk::Device         getDevice()         const { return { m_device }; }
     vk::SurfaceKHR     getSurface()        const { return { m_surface }; }
     vkb::Swapchain     getVkbSwapchain()   const { return m_swapchain; }
     vk::SwapchainKHR   getSwapchain()      const { return { m_swapchain }; }
+    vk::Extent2D       getOutputExtent()   const { return m_outputExtent; }
+    vk::Extent2D       getSceneExtent()    const { return m_sceneExtent; }
+    vk::Format         getOutputFormat()   const { return m_outputFormat; }
+    uint64_t           getFrameCount()     const { return m_frameCount; }
     uint32_t           getInFlightIndex()  const { return m_inFlightFrameIndex; }
     ImGuiContext*      getImGuiContext()   const { return m_imGuiContext; }
-    Allocated<Image>&  getDepthBuffer()          { return getGBuffer().depthImage; }
+    Image&             getDepthBuffer()          { return *getGBuffer().depthImage; }
 
     struct GBuffer {
+        static constexpr vk::Format s_depthFormat        = vk::Format::eD32Sfloat;
+        static constexpr vk::Format s_albedoFormat       = vk::Format::eR8G8B8A8Srgb;
+        static constexpr vk::Format s_normalFormat       = vk::Format::eR8G8B8A8Snorm;
+        static constexpr vk::Format s_emissiveFormat     = vk::Format::eR16G16B16A16Sfloat;
+        static constexpr vk::Format s_aoMetalRoughFormat = vk::Format::eR8G8B8A8Unorm;
+
         Uniform uniform;
         
-        Allocated<Image> depthImage;
-        Allocated<Image> albedoImage;
-        Allocated<Image> normalImage;
-        Allocated<Image> emissiveImage;
-        Allocated<Image> aoMetalRoughImage;
+        // transient images owned by the render graph, which shares their memory with images whose lifetimes don't overlap
+        Image* depthImage        = nullptr;
+        Image* albedoImage       = nullptr;
+        Image* normalImage       = nullptr;
+        Image* emissiveImage     = nullptr;
+        Image* aoMetalRoughImage = nullptr;
 
         vk::ImageView depthImageView;
         vk::ImageView albedoImageView;
         vk::ImageView normalImageView;
         vk::ImageView emissiveImageView;
         vk::ImageView aoMetalRoughImageView;
+
+        struct Handles {
+            RenderGraph::ImageHandle depth;
+            RenderGraph::ImageHandle albedo;
+            RenderGraph::ImageHandle normal;
+            RenderGraph::ImageHandle emissive;
+            RenderGraph::ImageHandle aoMetalRough;
+        } handles;
     } m_gBuffer;
 
     GBuffer& getGBuffer() { return m_gBuffer; }
 
+    /**
+     * @brief The graph of passes recorded each frame. Rebuilt whenever the window size changes
+     */
+    RenderGraph& getRenderGraph() { return m_renderGraph; }
+
     vk::Queue       getQueue(vkb::QueueType queueType) const;
     uint32_t        getQueueIndex(vkb::QueueType queueType) const;
     vk::CommandPool getCommandPool(vkb::QueueType queueType) const;
 
     /**
-     * @brief Create a command buffer that can be used for one time actions. e.g. staged copying
+     * @brief Queues must be externally synchronised, and several queue types may share one vk::Queue.
+     *        Hold the lock while submitting to or presenting on `queue`, from any thread
+     */
+    std::unique_lock<std::mutex> lockQueue(vk::Queue queue);
+
+    /**
+     * @brief Create a command buffer that can be used for one time actions. e.g. staged copying.
+     *        Only call this from the render thread, other threads record through the upload engine
      */
     vk::CommandBuffer beginOneTimeCommandBuffer(vkb::QueueType queueType);
 
     /**
      * @brief Submit a command buffer created by IEngine::beginOneTimeCommandBuffer
+     *
+     * @param wait If true, block until the submission has finished on the GPU
+     */
+    void submitOneTimeCommandBuffer(vk::CommandBuffer cmd, vkb::QueueType queueType, vk::SubmitInfo submitInfo, bool wait = false);
+
+    /**
+     * @brief Get a command buffer from the current frame's command pool. It is valid until this frame in flight comes round again
+     */
+    vk::CommandBuffer allocateFrameCommandBuffer(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+    struct SecondaryRenderingInfo {
+        std::vector<vk::Format> colorAttachmentFormats;
+        vk::Format              depthAttachmentFormat = vk::Format::eUndefined;
+        vk::Viewport            viewport;
+        vk::Rect2D              scissor;
+    };
+
+    /**
+     * @brief Record `chunkCount` chunks concurrently on the worker threads, each into its own secondary command buffer,
+     *        then execute them on `cmd` in chunk order. Must be called inside a dynamic rendering instance begun with
+     *        vk::RenderingFlagBits::eContentsSecondaryCommandBuffers, whose attachment formats match `renderingInfo`
+     *
+     * @param func Called once per chunk, from a worker thread. Each secondary starts with the given viewport and scissor
+     */
+    void recordSecondaryChunks(
+        vk::CommandBuffer cmd,
+        const SecondaryRenderingInfo& renderingInfo,
+        uint32_t chunkCount,
+        std::function<void(vk::CommandBuffer cmd, uint32_t chunkIndex)> func);
+
+    WorkerPool& getWorkerPool() { return m_workerPool; }
+
+    /**
+     * @brief Batches staged copies onto the transfer queue. Use it instead of blocking one time command buffers
+     */
+    UploadEngine& getUploadEngine() { return m_uploadEngine; }
+
+    /**
+     * @brief Per-frame linear allocations for data the GPU reads once. Allocate from prepareFrame and the
+     *        recording functions, when the current frame in flight's previous submission has finished
+     */
+    FrameAllocator& getFrameAllocator() { return m_frameAllocator; }
+
+    /**
+     * @brief Shared vertex and index buffers for every model. Static geometry belongs in the device local pool,
+     *        the host visible pool is for geometry the CPU rewrites every frame
+     */
+    GeometryPool& getGeometryPool(GeometryPool::Placement placement = GeometryPool::DeviceLocal) {
+        return placement == GeometryPool::HostVisible ? m_hostVisibleGeometryPool : m_geometryPool;
+    }
+
+    /**
+     * @brief Generates mip chains in one compute dispatch, for loaded textures and render targets alike
+     */
+    MipGenerator& getMipGenerator() { return m_mipGenerator; }
+
+    /**
+     * @brief True if uploads run on a different queue family to graphics, and so can overlap with rendering
      */
-    void submitOneTimeCommandBuffer(vk::CommandBuffer cmd, vkb::QueueType queueType, vk::SubmitInfo submitInfo, vk::Fence fence = {});
+    bool hasDedicatedTransfer() const { return m_transferQueueIndex != m_graphicsQueueIndex; }
+
+    /**
+     * @brief True if compute work runs on a different queue to graphics, and so can overlap with it
+     */
+    bool hasAsyncCompute() const { return m_computeQueueIndex != m_graphicsQueueIndex; }
+
+    enum class ComputeTiming {
+        // submitted immediately, this frame's graphics work waits for it
+        BeforeGraphics,
+        // submitted after this frame's graphics work and waits for it, the next frame's graphics work waits for it.
+        // e.g. post processing or light culling which overlaps with the next frame's G-buffer
+        AfterGraphics,
+    };
+
+    /**
+     * @brief Begin a command buffer for the compute queue. Resources shared with the graphics queue must either
+     *        be created with both queue family indices, or have their ownership transferred
+     */
+    vk::CommandBuffer beginAsyncComputeCommands();
+
+    /**
+     * @brief Submit a command buffer created by IEngine::beginAsyncComputeCommands, synchronised with the frame's
+     *        graphics submission by semaphores. Must be called from the render thread
+     *
+     * @param graphicsWaitStages The stages of graphics work which wait for the compute work to finish
+     */
+    void submitAsyncComputeCommands(vk::CommandBuffer cmd, vk::PipelineStageFlags graphicsWaitStages, ComputeTiming timing = ComputeTiming::BeforeGraphics);
+
+    /**
+     * @brief The timeline semaphore signalled by each frame's last submission, counting frames finished on the GPU.
+     *        That is the graphics submission, or the last compute submitted with ComputeTiming::AfterGraphics
+     */
+    vk::Semaphore getFrameTimeline() const { return m_frameTimeline; }
+
+    /**
+     * @brief The value the frame timeline reaches once the frame currently being recorded has finished on the GPU.
+     *        Anything the frame uses is safe to free from then on
+     */
+    uint64_t getFrameTimelineValue() const { return m_frameTimelineValue + 1; }
+
+    /**
+     * @brief The latest value reached by the frame timeline. Cheap, and safe to call from any thread
+     */
+    uint64_t getCompletedTimelineValue() const;
+
+    bool isTimelineValueComplete(uint64_t value) const { return getCompletedTimelineValue() >= value; }
+    void waitForTimelineValue(uint64_t value) const;
+
+    /**
+     * @brief Run `func` once the frame timeline has reached `timelineValue`. Safe to call from any thread
+     *
+     * @param timelineValue If 0, defaults to getFrameTimelineValue()
+     */
+    void addDeferredDeletion(std::function<void()> func, uint64_t timelineValue = 0);
+
+    /**
+     * @brief Move the scope's cleanup functions into the deferred deletion queue, leaving it empty and reusable.
+     *        Use instead of waiting for the device to idle before freeing resources the GPU may still be using
+     *
+     * @param timelineValue If 0, defaults to getFrameTimelineValue()
+     */
+    void deferScopeCleanup(ResourceScope& scope, uint64_t timelineValue = 0);
+
+    /**
+     * @brief Command buffer allocations made by the frame command pools during the last frame
+     */
+    const CommandBufferStats& getFrameCommandBufferStats()   const { return m_frameCommandBufferStats; }
+
+    /**
+     * @brief One time command buffer allocations made since the previous frame
+     */
+    const CommandBufferStats& getOneTimeCommandBufferStats() const { return m_oneTimeCommandBufferStats; }
+
+    /**
+     * @brief Barriers recorded by BarrierBatch, including the render graph's and uploads', since the previous frame
+     */
+    const BarrierStats& getBarrierStats() const { return m_barrierStats; }
+
+    /**
+     * @brief Called by BarrierBatch::flush for each pipelineBarrier it records. Safe to call from any thread
+     */
+    void countBarriers(uint32_t barrierCount) {
+        m_barrierCount += barrierCount;
+        m_barrierCallCount++;
+    }
 
     double getDeltaTime() const;
     double getTime()      const;
 
+    /**
+     * @brief Request a present mode, e.g. eMailbox or eImmediate for low latency. The swapchain is recreated
+     *        before the next frame, falling back to eFifo if the mode is unsupported
+     */
+    void               setPresentMode(vk::PresentModeKHR presentMode);
+    vk::PresentModeKHR getPresentMode() const { return m_presentMode; }
+
+    /**
+     * @brief The most frames the CPU may queue ahead of the GPU, between 1 and s_framesInFlight.
+     *        Fewer queued frames means input is sampled closer to when the frame is presented
+     */
+    void     setMaxQueuedFrames(uint32_t count);
+    uint32_t getMaxQueuedFrames() const { return m_maxQueuedFrames; }
+
+    /**
+     * @brief Cap the frame rate, e.g. to reduce power usage. 0 disables the limit
+     */
+    void   setFrameRateLimit(double framesPerSecond) { m_frameRateLimit = std::max(0.0, framesPerSecond); }
+    double getFrameRateLimit() const { return m_frameRateLimit; }
+
+    /**
+     * @brief Smoothed latencies, in seconds, from sampling input in glfwPollEvents
+     */
+    struct LatencyStats {
+        // until the frame was handed to the presentation engine
+        double inputToPresent     = 0.0;
+        // until the frame was seen to have finished on the GPU, an upper bound accurate to around one frame
+        double inputToGPUFinished = 0.0;
+    };
+
+    const LatencyStats& getLatencyStats() const { return m_latencyStats; }
+
+    /**
+     * @brief Fraction of the game view region's resolution the G-buffer and lighting are rendered at.
+     *        The lit image is upscaled to the game view region when tonemapping
+     */
+    void  setRenderScale(float scale);
+    float getRenderScale() const { return m_renderScale; }
+
+    /**
+     * @brief When enabled, the render scale is adjusted to keep the GPU frame time, measured by the
+     *        GPU profiler, at the target. Has no effect if timestamps are unsupported
+     */
+    void setAutoRenderScale(bool enabled) { m_autoRenderScale = enabled; }
+    bool isAutoRenderScale() const { return m_autoRenderScale; }
+
+    void   setTargetFrameTime(double milliseconds) { m_targetFrameTime = std::max(1.0, milliseconds); }
+    double getTargetFrameTime() const { return m_targetFrameTime; }
+
+    static constexpr float s_minRenderScale = 0.25f;
+
+    /**
+     * @brief One memory heap's budget, sampled at the start of every frame. Without VK_EXT_memory_budget,
+     *        usage only counts this process's VMA blocks and the budget is estimated by VMA
+     */
+    struct MemoryHeapBudget {
+        vk::MemoryHeapFlags flags;
+        vk::DeviceSize      size            = 0;
+        vk::DeviceSize      usage           = 0;
+        vk::DeviceSize      budget          = 0;
+        vk::DeviceSize      blockBytes      = 0;
+        vk::DeviceSize      allocationBytes = 0;
+        uint32_t            blockCount      = 0;
+        uint32_t            allocationCount = 0;
+    };
+
+    const std::vector<MemoryHeapBudget>& getMemoryBudgets() const { return m_memoryBudgets; }
+    bool hasMemoryBudgetExtension() const { return m_hasMemoryBudgetExtension; }
+
+    /**
+     * @brief The highest fraction of its budget any heap is using
+     */
+    float getMemoryBudgetPressure() const;
+
+    /**
+     * @brief onMemoryBudgetWarning is called when a heap's usage rises above this fraction of its budget
+     */
+    static constexpr float s_memoryBudgetWarningFraction = 0.9f;
+
+    /**
+     * @brief Write the most recently rendered frame to a PNG file. Only available when headless
+     *
+     * @return true if the image was written successfully
+     */
+    bool captureOutputImage(const std::string& filename);
+
     virtual std::string getName()       = 0;
     virtual uint32_t    getAppVersion() = 0;
 
@@ -96,15 +371,67 @@ protected:
 
     virtual glm::ivec2 getInitialWindowSize() { return { 1280, 720 }; }
 
+    /**
+     * @brief When headless, no window, surface or swapchain is created. Frames are rendered
+     *        into an offscreen image ring of getInitialWindowSize() instead
+     */
+    virtual bool     isHeadless()            { return false; }
+    virtual uint64_t getHeadlessFrameCount() { return 1; }
+
+    /**
+     * @brief Called when headless, after the last frame has been drawn and before anything is cleaned up,
+     *        e.g. to captureOutputImage for comparison against a reference
+     */
+    virtual void onHeadlessFramesFinished() {}
+
     virtual void setup() {};
     virtual void drawUI() {};
     virtual void update() {};
     virtual void onWindowSizeChanged(glm::vec<2, uint32_t> size) {}
 
+    /**
+     * @brief Called when the G-buffer is resized to fit the game view region, which happens whenever the dock
+     *        layout changes. Resources sized to the G-buffer should be created in getUntilSceneSizeChangeScope().
+     *        The render graph has been rebuilt and compiled by now, so its transient images can be looked up
+     */
+    virtual void onSceneSizeChanged(glm::vec<2, uint32_t> size) {}
+
+    /**
+     * @brief Called on the render thread when a heap's usage rises above s_memoryBudgetWarningFraction of its
+     *        budget, so the application can release resources, e.g. by lowering the render scale
+     */
+    virtual void onMemoryBudgetWarning(uint32_t heapIndex, const MemoryHeapBudget& budget) {}
+
+    /**
+     * @brief Called on the render thread once the frame in flight's resources are free to reuse, before any
+     *        passes are recorded. Use it to prepare anything the chunk recording functions share
+     */
+    virtual void prepareFrame(vk::Extent2D viewport) {};
+
     virtual void recordGBufferCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) {};
     virtual void recordLightingCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) {};
+
+    /**
+     * @brief If greater than 0, the G-buffer pass is recorded by calling recordGBufferChunk for each chunk
+     *        in parallel on the worker threads instead of calling recordGBufferCommands
+     */
+    virtual uint32_t getGBufferChunkCount() { return 0; }
+    virtual void     recordGBufferChunk(vk::CommandBuffer cmd, vk::Extent2D viewport, uint32_t chunkIndex, uint32_t chunkCount) {};
+
+    /**
+     * @brief If greater than 0, the lighting pass is recorded by calling recordLightingChunk for each chunk
+     *        in parallel on the worker threads instead of calling recordLightingCommands
+     */
+    virtual uint32_t getLightingChunkCount() { return 0; }
+    virtual void     recordLightingChunk(vk::CommandBuffer cmd, vk::Extent2D viewport, uint32_t chunkIndex, uint32_t chunkCount) {};
     virtual void recordPostProcessingCommands(vk::CommandBuffer cmd, vk::Extent2D viewport) {};
 
+    /**
+     * @brief Add passes between lighting and tonemapping. By default adds a single pass which calls
+     *        recordPostProcessingCommands, override to declare finer grained passes instead
+     */
+    virtual void addPostProcessingPasses(RenderGraph& graph);
+
     PipelineData m_postProcessingPipeline;
 
 private:
@@ -114,17 +441,72 @@ private:
     uint32_t    getEngineVersion() { return VK_MAKE_API_VERSION(0, 1, 0, 0); }
 
     void init();
+
+    /**
+     * @brief Sleeps until the next frame is due under the frame rate limit, then waits for the GPU to
+     *        get within the max queued frames. Called before input is sampled
+     */
+    void paceFrame();
+    void recordInputLatency(uint64_t frameTimelineValue);
+
+    /**
+     * @brief In auto mode, step the render scale towards the target frame time using the latest GPU timings
+     */
+    void updateRenderScale();
+    static constexpr uint64_t s_renderScaleSettleFrames = 30;
+
+    /**
+     * @brief Sample VMA's statistics and each heap's budget for this frame
+     */
+    void updateMemoryBudgets();
     void draw(vk::Rect2D viewport);
     void windowSizeChanged();
+
+    /**
+     * @brief Recreate the G-buffer, everything the application sizes to it and the render graph at `extent`
+     */
+    void sceneSizeChanged(vk::Extent2D extent);
+    vk::Extent2D clampSceneExtent(vk::Extent2D extent) const;
+    void setupSwapchain(ResourceScope& scope);
+    void setupOffscreenOutput(ResourceScope& scope);
+    void buildRenderGraph(ResourceScope& scope);
+
+    void beginOutputRendering(vk::CommandBuffer cmd, vk::AttachmentLoadOp loadOp);
+    void recordGBufferPass(vk::CommandBuffer cmd);
+    void recordLightingPass(vk::CommandBuffer cmd);
+    void recordTonemapPass(vk::CommandBuffer cmd);
+    void recordGUIPass(vk::CommandBuffer cmd);
     
     void registerDeltaTime(double deltaTime);
 
+    /**
+     * @brief Runs every deferred deletion whose timeline value is at most `completedValue`
+     */
+    void processDeferredDeletions(uint64_t completedValue);
+
+    OneTimeCommandPool& getOneTimeCommandPool(vkb::QueueType queueType);
+
+    /**
+     * @brief Get a binary semaphore for synchronising queues, recycled once the frame that waits on it has finished
+     */
+    vk::Semaphore acquireSemaphore();
+
     Log m_log;
 
+    GPUProfiler m_gpuProfiler;
+
+    RenderGraph              m_renderGraph;
+    RenderGraph::ImageHandle m_outputImageHandle = RenderGraph::s_invalidHandle;
+    vk::Rect2D               m_gameViewRegion;
+
+    // size of the G-buffer, which tracks the game view region rather than the output
+    vk::Extent2D m_sceneExtent;
+
     ResourceScope m_globalResourceScope        { "Global" };
-    ResourceScope m_untilWindowSizeChangeScope { "Until window size change" };
+    ResourceScope m_untilWindowSizeChangeScope { "Until window size change", false, true };
+    ResourceScope m_untilSceneSizeChangeScope  { "Until scene size change", false, true };
 
-    GLFWwindow*   m_window;
+    GLFWwindow*   m_window = nullptr;
     VmaAllocator  m_allocator;
     ImGuiContext* m_imGuiContext;
 
@@ -134,16 +516,34 @@ private:
     vkb::PhysicalDevice m_phys_device;
     vkb::Device         m_device;
     vkb::Swapchain      m_swapchain;
-    VkSurfaceKHR        m_surface;
+    VkSurfaceKHR        m_surface = VK_NULL_HANDLE;
 
-    std::vector<Image>         m_swapchainImages;
-    std::vector<vk::ImageView> m_swapchainImageViews;
+    // swapchain images, or the offscreen image ring when headless
+    std::vector<Image>         m_outputImages;
+    std::vector<vk::ImageView> m_outputImageViews;
+    vk::Extent2D               m_outputExtent;
+    vk::Format                 m_outputFormat;
+    uint32_t                   m_outputImageIndex     = 0;
+    uint32_t                   m_lastOutputImageIndex = 0;
+    uint64_t                   m_frameCount           = 0;
 
     std::vector<vk::Semaphore> m_imageAcquiredSemaphores;
     std::vector<vk::Semaphore> m_renderingFinishedSemaphores;
-    std::vector<vk::Fence>     m_frameFinishedFences;
     uint8_t                    m_inFlightFrameIndex = 0;
 
+    // each slot holds the timeline value signalled by that frame in flight's last submission
+    vk::Semaphore                          m_frameTimeline;
+    std::atomic<uint64_t>                  m_frameTimelineValue = 0;
+    std::array<uint64_t, s_framesInFlight> m_inFlightTimelineValues {};
+
+    struct DeferredDeletion {
+        uint64_t              timelineValue;
+        std::function<void()> func;
+    };
+
+    std::mutex                    m_deferredDeletionMutex;
+    std::vector<DeferredDeletion> m_deferredDeletions;
+
     std::chrono::high_resolution_clock::time_point m_startTime;
     std::chrono::high_resolution_clock::time_point m_currentFrameStartTime;
 
@@ -151,14 +551,95 @@ private:
     double               m_deltaTimeSum;
     static constexpr int s_deltaTimeSampleCount = 10;
 
+    vk::PresentModeKHR m_presentMode          = vk::PresentModeKHR::eFifo;
+    vk::PresentModeKHR m_requestedPresentMode = vk::PresentModeKHR::eFifo;
+    uint32_t           m_maxQueuedFrames      = s_framesInFlight;
+    double             m_frameRateLimit       = 0.0;
+
+    std::chrono::steady_clock::time_point m_nextFrameTime;
+    std::chrono::steady_clock::time_point m_inputSampleTime;
+
+    // when each frame's input was sampled, until the frame is seen to have finished
+    std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> m_pendingInputSamples;
+    LatencyStats                                                            m_latencyStats;
+
+    float    m_renderScale             = 1.0f;
+    bool     m_autoRenderScale         = false;
+    double   m_targetFrameTime         = 1000.0 / 60.0;
+    double   m_smoothedGPUFrameTime    = 0.0;
+    uint64_t m_lastRenderScaleFrame    = 0;
+    uint64_t m_lastRenderScaleGPUFrame = 0;
+
+    bool                          m_hasMemoryBudgetExtension = false;
+    std::vector<MemoryHeapBudget> m_memoryBudgets;
+    std::vector<bool>             m_memoryBudgetWarnings;
+
     vk::Queue m_graphicsQueue;
     vk::Queue m_presentQueue;
+    vk::Queue m_computeQueue;
+    vk::Queue m_transferQueue;
 
     uint32_t m_graphicsQueueIndex;
     uint32_t m_presentQueueIndex;
+    uint32_t m_computeQueueIndex;
+    uint32_t m_transferQueueIndex;
+
+    // one per queue type, in the order above. Types sharing a vk::Queue use the first one's
+    std::array<std::mutex, 4> m_queueMutexes;
 
     vk::CommandPool m_graphicsCmdPool;
     vk::CommandPool m_presentCmdPool;
+    vk::CommandPool m_computeCmdPool;
+    vk::CommandPool m_transferCmdPool;
+
+    std::array<FrameCommandPool, s_framesInFlight> m_frameCommandPools;
+
+    WorkerPool                                                  m_workerPool;
+    std::array<std::vector<FrameCommandPool>, s_framesInFlight> m_workerCommandPools;
+    OneTimeCommandPool                             m_graphicsOneTimeCmdPool;
+    OneTimeCommandPool                             m_presentOneTimeCmdPool;
+    OneTimeCommandPool                             m_computeOneTimeCmdPool;
+    OneTimeCommandPool                             m_transferOneTimeCmdPool;
+
+    UploadEngine m_uploadEngine;
+
+    FrameAllocator                  m_frameAllocator;
+    static constexpr vk::DeviceSize s_frameAllocatorSize = 16 * 1024 * 1024;
+
+    GeometryPool              m_geometryPool;
+    static constexpr uint32_t s_initialGeometryVertexCapacity = 1 << 20;
+    static constexpr uint32_t s_initialGeometryIndexCapacity  = 1 << 22;
+
+    MipGenerator m_mipGenerator;
+
+    GeometryPool              m_hostVisibleGeometryPool;
+    static constexpr uint32_t s_initialHostVisibleGeometryVertexCapacity = 1 << 16;
+    static constexpr uint32_t s_initialHostVisibleGeometryIndexCapacity  = 1 << 18;
+
+    struct GraphicsWait {
+        vk::Semaphore          semaphore;
+        vk::PipelineStageFlags stages;
+        // signalled by the graphics work the compute waited on, if any, and retired with it
+        vk::Semaphore          upstreamSemaphore = {};
+    };
+
+    struct DeferredComputeSubmission {
+        vk::CommandBuffer      cmd;
+        vk::PipelineStageFlags graphicsWaitStages;
+    };
+
+    std::vector<GraphicsWait>              m_pendingGraphicsWaits;
+    std::vector<DeferredComputeSubmission> m_deferredComputeSubmissions;
+    std::vector<vk::Semaphore>             m_freeSemaphores;
+
+    std::array<std::vector<vk::Semaphore>, s_framesInFlight> m_retiringSemaphores;
+
+    CommandBufferStats m_frameCommandBufferStats;
+    CommandBufferStats m_oneTimeCommandBufferStats;
+
+    std::atomic<uint32_t> m_barrierCount     = 0;
+    std::atomic<uint32_t> m_barrierCallCount = 0;
+    BarrierStats          m_barrierStats;
 
 };
 
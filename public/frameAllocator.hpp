@@ -0,0 +1,99 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "allocated.hpp"
+#include "resourceScope.hpp"
+
+#include <atomic>
+
+namespace ignis {
+
+/**
+ * @brief A sub-range of the frame allocator's buffer, valid until the same frame in flight comes around again
+ */
+struct FrameAllocation {
+    vk::Buffer     buffer;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size   = 0;
+    void*          cpuPtr = nullptr;
+
+    bool isValid() const { return cpuPtr != nullptr; }
+
+    template<typename T>
+    T* as() { return static_cast<T*>(cpuPtr); }
+};
+
+/**
+ * @brief A persistently mapped linear allocator with one region per frame in flight, for data which is
+ *        written by the CPU and read by the GPU once, e.g. instance data, uniforms and dynamic vertices.
+ *        A frame's region is reset when the engine begins recording that frame in flight again, so nothing
+ *        is allocated from VMA while rendering. Allocation is lock-free, so chunks can allocate concurrently
+ */
+class FrameAllocator {
+    Allocated<vk::Buffer> m_buffer;
+    uint8_t*              p_mapped = nullptr;
+
+    vk::DeviceSize m_frameSize        = 0;
+    vk::DeviceSize m_uniformAlignment = 1;
+    vk::DeviceSize m_storageAlignment = 1;
+    uint32_t       m_frameIndex       = 0;
+
+    // offset of the next allocation, relative to the start of the current frame's region
+    std::atomic<vk::DeviceSize> m_head           = 0;
+    vk::DeviceSize              m_highWaterMark  = 0;
+    std::atomic<bool>           m_overflowLogged = false;
+
+public:
+    /**
+     * @param frameSize The capacity of each frame in flight's region, in bytes
+     */
+    void setup(ResourceScope& scope, uint32_t frameCount, vk::DeviceSize frameSize);
+
+    /**
+     * @brief Reset the region of the given frame in flight. Must only be called once its last submission has finished
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * @brief Make this frame's writes visible to the device, if the memory is not host coherent.
+     *        Called by the engine before the frame is submitted
+     */
+    vk::Result flush();
+
+    /**
+     * @brief Allocate `size` bytes from the current frame's region. Returns an invalid allocation if the region is full
+     *
+     * @param alignment Must be a power of two
+     */
+    FrameAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+
+    template<typename T>
+    FrameAllocation allocateAndCopy(const T* data, size_t count, vk::DeviceSize alignment = alignof(T)) {
+        FrameAllocation allocation = allocate(sizeof(T) * count, alignment);
+        if (allocation.isValid() && count > 0) std::memcpy(allocation.cpuPtr, data, sizeof(T) * count);
+        return allocation;
+    }
+
+    template<typename T>
+    FrameAllocation allocateAndCopy(const std::vector<T>& data, vk::DeviceSize alignment = alignof(T)) {
+        return allocateAndCopy(data.data(), data.size(), alignment);
+    }
+
+    template<typename T>
+    FrameAllocation allocateAndCopy(const T& data, vk::DeviceSize alignment = alignof(T)) {
+        return allocateAndCopy(&data, 1, alignment);
+    }
+
+    vk::Buffer     getBuffer()           { return *m_buffer; }
+    vk::DeviceSize getFrameSize()        const { return m_frameSize; }
+    vk::DeviceSize getUniformAlignment() const { return m_uniformAlignment; }
+    vk::DeviceSize getStorageAlignment() const { return m_storageAlignment; }
+
+    /**
+     * @brief Bytes allocated so far this frame, and the most allocated in any single frame
+     */
+    vk::DeviceSize getUsed()          const { return std::min<vk::DeviceSize>(m_head, m_frameSize); }
+    vk::DeviceSize getHighWaterMark() const { return m_highWaterMark; }
+};
+
+}
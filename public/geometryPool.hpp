@@ -0,0 +1,167 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "allocated.hpp"
+#include "resourceScope.hpp"
+#include "rangeAllocator.hpp"
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+namespace ignis {
+
+class UploadToken;
+
+/**
+ * @brief A shared heap of vertex and index buffers. Vertices are stored de-interleaved, one buffer per
+ *        stream, so every stream of an allocation shares a vertex offset. Once bound, everything in the
+ *        pool is drawn with the allocation's `firstIndex` and `vertexOffset`, with no further binds
+ */
+class GeometryPool {
+public:
+    /**
+     * @brief DeviceLocal pools are filled through the UploadEngine's staging buffers. HostVisible pools are
+     *        mapped and written directly, for geometry the CPU rewrites every frame
+     */
+    enum Placement : uint32_t {
+        DeviceLocal = 0,
+        HostVisible,
+    };
+
+    static const char* getPlacementName(Placement placement);
+
+    enum Stream : uint32_t {
+        Position = 0,
+        Texcoord,
+        Normal,
+        Tangent,
+        StreamCount,
+    };
+
+    static constexpr std::array<uint32_t, StreamCount> s_streamStrides {
+        sizeof(glm::vec3), // POSITION
+        sizeof(glm::vec2), // TEXCOORD_0
+        sizeof(glm::vec3), // NORMAL
+        sizeof(glm::vec4), // TANGENT
+    };
+
+    using Handle = uint32_t;
+    static constexpr Handle s_invalidHandle = ~0u;
+
+    struct Range {
+        uint32_t vertexOffset = 0;
+        uint32_t vertexCount  = 0;
+        uint32_t firstIndex   = 0;
+        uint32_t indexCount   = 0;
+    };
+
+    struct Stats {
+        uint64_t vertexCapacity   = 0;
+        uint64_t verticesUsed     = 0;
+        uint64_t vertexFreeRanges = 0;
+        uint64_t indexCapacity    = 0;
+        uint64_t indicesUsed      = 0;
+        uint64_t indexFreeRanges  = 0;
+        uint32_t allocationCount  = 0;
+        uint32_t compactionCount  = 0;
+
+        // the memory each buffer actually landed in, which may be both device local and host visible
+        std::array<vk::MemoryPropertyFlags, StreamCount> vertexMemory {};
+        vk::MemoryPropertyFlags                          indexMemory {};
+    };
+
+private:
+    // shared while the engine draws from the pool, exclusive while its ranges or buffers change
+    std::shared_mutex m_mutex;
+    Placement         m_placement = DeviceLocal;
+
+    struct Buffers {
+        std::unique_ptr<ResourceScope>                 scope;
+        std::array<Allocated<vk::Buffer>, StreamCount> vertexBuffers;
+        Allocated<vk::Buffer>                          indexBuffer;
+
+        // only mapped in host visible pools
+        std::array<uint8_t*, StreamCount> vertexPtrs {};
+        uint8_t*                          indexPtr = nullptr;
+    } m_buffers;
+
+    RangeAllocator m_vertexAllocator;
+    RangeAllocator m_indexAllocator;
+
+    std::vector<Range>  m_ranges;
+    std::vector<Handle> m_freeHandles;
+    uint32_t            m_compactionCount = 0;
+
+    vk::Result createBuffers(Buffers& buffers, uint32_t vertexCapacity, uint32_t indexCapacity);
+    void       logPlacement(Buffers& buffers);
+
+    /**
+     * @brief Write `size` bytes at `offset` into one of the pool's buffers, directly if it is mapped,
+     *        otherwise through the UploadEngine
+     */
+    vk::Result write(Allocated<vk::Buffer>& buffer, uint8_t* ptr, const void* data, vk::DeviceSize size,
+        vk::DeviceSize offset, vk::AccessFlags dstAccess, UploadToken* p_token);
+
+    /**
+     * @brief Move every allocation to the start of new buffers with the given capacities, so all free space is contiguous
+     */
+    vk::Result repack(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+public:
+    void setup(ResourceScope& scope, uint32_t vertexCapacity, uint32_t indexCapacity, Placement placement = DeviceLocal);
+
+    Placement getPlacement() const { return m_placement; }
+
+    /**
+     * @brief Allocate space for a mesh and write it, through the UploadEngine unless the pool is host visible.
+     *        If the pool is too fragmented or full, it is compacted or grown first
+     *
+     * @param streams Tightly packed data for each stream, with s_streamStrides. Null streams are left uninitialised
+     * @param indices Relative to the mesh's first vertex
+     */
+    vk::ResultValue<Handle> allocate(
+        uint32_t vertexCount, const std::array<const void*, StreamCount>& streams,
+        const std::vector<uint32_t>& indices, UploadToken* p_token = nullptr);
+
+    /**
+     * @brief Release an allocation's ranges for reuse. The GPU must have finished with them,
+     *        e.g. by freeing from a scope passed to IEngine::deferScopeCleanup
+     */
+    void free(Handle handle);
+
+    /**
+     * @brief Overwrite part of one of an allocation's streams. In a host visible pool the write is immediate,
+     *        so the caller must not overwrite vertices a frame in flight is still drawing, e.g. by alternating
+     *        between one allocation per frame in flight
+     */
+    vk::Result update(Handle handle, Stream stream, const void* data, uint32_t firstVertex, uint32_t vertexCount,
+        UploadToken* p_token = nullptr);
+
+    /**
+     * @brief Defragment the pool. The copy is recorded into the UploadEngine's next batch, and the old buffers
+     *        are freed once the frames in flight have finished. Must not be called while recording draws
+     */
+    bool compact();
+
+    /**
+     * @brief Offsets are only stable until the next allocation or compaction, so look them up while recording
+     */
+    const Range& getRange(Handle handle) const { return m_ranges[handle]; }
+
+    /**
+     * @brief Held by the engine from before a frame is recorded until it is submitted, so allocations made
+     *        from other threads, e.g. loading models in the background, wait rather than moving ranges or
+     *        retiring buffers the frame is using. Must not allocate, free or compact while holding it
+     */
+    std::shared_lock<std::shared_mutex> lockForDrawing() { return std::shared_lock<std::shared_mutex> { m_mutex }; }
+
+    /**
+     * @brief Bind every vertex stream, at `firstBinding` onwards, and the 32 bit index buffer
+     */
+    void bind(vk::CommandBuffer cmd, uint32_t firstBinding = 0);
+
+    Stats getStats();
+};
+
+}
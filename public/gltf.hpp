@@ -7,15 +7,21 @@
 #include "uniform.hpp"
 #include "image.hpp"
 #include "camera.hpp"
+#include "frameAllocator.hpp"
+#include "geometryPool.hpp"
+#include "modelPackage.hpp"
+
+#include <atomic>
 
 namespace ignis {
 
 class GLTFModel {
     std::string m_filename;
 
-    gltf::Model m_model;
+    // only the scenes, nodes and lights, which can be edited. Everything else is resolved into m_package
+    gltf::Model  m_model;
+    ModelPackage m_package;
 
-    std::vector<Allocated<vk::Buffer>> m_buffers;
     std::vector<Allocated<Image>>      m_images;
     std::vector<vk::ImageView>         m_imageViews;
     std::vector<vk::Sampler>           m_samplers;
@@ -80,38 +86,35 @@ class GLTFModel {
 
     struct BindingData {
         PipelineData* pipelineData = nullptr;
-        int32_t positionAccessor   = -1;
-        int32_t texcoordAccessor   = -1;
-        int32_t tangentAccessor    = -1;
-        int32_t normalAccessor     = -1;
 
-        bool isValid() const { return pipelineData != nullptr; }
+        GeometryPool::Handle geometry = GeometryPool::s_invalidHandle;
+
+        bool isValid() const { return pipelineData != nullptr && geometry != GeometryPool::s_invalidHandle; }
     };
 
-    bool bind(vk::CommandBuffer cmd, const BindingData& data, vk::DescriptorSet cameraDescriptorSet, vk::DescriptorSet materialDescriptorSet);
+    /**
+     * @param p_boundPipeline The pipeline last bound to `cmd`, updated if a different one is bound
+     */
+    bool bind(vk::CommandBuffer cmd, const BindingData& data, Camera& camera, vk::DescriptorSet materialDescriptorSet, PipelineData*& p_boundPipeline);
 
     std::vector<std::vector<BindingData>> m_bindingData;
 
-    ResourceScope m_localScope { "GLTFModel empty", true };
-    std::array<ResourceScope, 5> m_oneFrameScopes {
-        ResourceScope { "GLTFModel oneFrameScope 0" },
-        ResourceScope { "GLTFModel oneFrameScope 1" },
-        ResourceScope { "GLTFModel oneFrameScope 2" },
-        ResourceScope { "GLTFModel oneFrameScope 3" },
-        ResourceScope { "GLTFModel oneFrameScope 4" },
-    };
+    // every (mesh, primitive) pair, so draws can be split into even chunks
+    std::vector<std::pair<int, int>> m_primitives;
+
+    // this frame's instance data, written by prepareDraw. Each mesh's instances start at its first instance
+    FrameAllocation       m_instanceAllocation;
+    std::vector<uint32_t> m_firstInstances;
+
+    // frames in flight may still be drawing the model when it is unloaded, so its resources outlive it until they finish
+    ResourceScope m_localScope { "GLTFModel empty", true, true };
+
+    GeometryPool::Placement m_geometryPlacement = GeometryPool::DeviceLocal;
 
     void updateInstances(uint32_t scene = 0) { updateInstances(m_model.scenes[scene]); }
     void updateInstances(gltf::Scene& scene);
     void updateInstances(gltf::Node& node, const glm::mat4& parentMat = glm::mat4 { 1.f });
 
-    /**
-     * @brief Bind a vertex buffer by name
-     * 
-     * @return true if the primitive contains a vertex attribute with the given name, otherwise false
-     */
-    bool bindBuffer(vk::CommandBuffer cmd, gltf::Primitive primitive, const char* name, uint32_t binding);
-
     static constexpr std::array<const char*, 1> s_supportedExtensions {
         "KHR_lights_punctual"
     };
@@ -129,6 +132,7 @@ public:
         Failed = 0,
         Initial,
         Loaded,
+        SettingUp,
         Ready,
     };
 
@@ -136,18 +140,50 @@ public:
     GLTFModel(GLTFModel&& other) = default;
     GLTFModel& operator =(GLTFModel&& other) = default;
 
-    ~GLTFModel();
-
     static bool setupStatics(ResourceScope& scope, vk::DescriptorSetLayout cameraDescriptorSetLayout);
 
+    /**
+     * @brief Load a glTF binary, or a package cooked from one by ignis_cook, which needs no decoding
+     */
     bool load(const std::string& filename);
     void loadAsync(const std::string& filename, bool* p_success = nullptr);
+
+    /**
+     * @brief Load and then set up the model on a background thread, so its buffers, images, samplers and
+     *        descriptor sets are all created while frames keep rendering. It can be drawn once isReady()
+     */
+    void loadAsync(const std::string& filename, vk::DescriptorSetLayout cameraDescriptorSetLayout, bool* p_success = nullptr);
+
+    /**
+     * @brief Create the model's GPU resources. Safe to call from any thread, but only the first call
+     *        after loading does anything
+     */
     bool setup(vk::DescriptorSetLayout cameraDescriptorSetLayout);
 
+    /**
+     * @brief Choose which of the engine's geometry pools the model is placed in. Only host visible if the CPU
+     *        will rewrite the vertices every frame. Must be called before setup
+     */
+    void setGeometryPlacement(GeometryPool::Placement placement) { m_geometryPlacement = placement; }
+    GeometryPool::Placement getGeometryPlacement() const { return m_geometryPlacement; }
+
+    /**
+     * @brief Update this frame's instance data. Must be called on the render thread before recording
+     *        any chunks with drawMeshes
+     */
+    bool prepareDraw();
+
     void drawMeshes(vk::CommandBuffer cmd, Camera& camera);
     void drawLights(vk::CommandBuffer cmd, Camera& camera);
 
-    Status status() const { return m_status; }
+    /**
+     * @brief Draw one of `chunkCount` even slices of the model's primitives. Chunks only read the model,
+     *        so they may be recorded concurrently once prepareDraw has been called for the frame
+     */
+    void drawMeshes(vk::CommandBuffer cmd, Camera& camera, uint32_t chunkIndex, uint32_t chunkCount);
+    void drawLights(vk::CommandBuffer cmd, Camera& camera, uint32_t chunkIndex, uint32_t chunkCount);
+
+    Status status() const { return m_status.value; }
 
     std::string& getFileName() { return m_filename; }
 
@@ -157,14 +193,21 @@ public:
     void renderNodeUI(uint32_t nodeID);
     void renderNodeTransformUI(gltf::Node& node);
 
-    bool shouldSetup() const { return isLoaded() && !isReady(); }
-    bool isLoaded() const { return m_status >= Loaded; }
-    bool isReady() const { return m_status >= Ready; }
-    bool failed() const { return m_status == Failed; }
+    bool shouldSetup() const { return status() == Loaded; }
+    bool isLoaded() const { return status() >= Loaded; }
+    bool isReady() const { return status() >= Ready; }
+    bool failed() const { return status() == Failed; }
 
 private:
-    Status m_status {};
-    
+    // written by the loading thread and polled by the render thread. Moving a model while it loads isn't supported
+    struct AtomicStatus {
+        std::atomic<Status> value {};
+
+        AtomicStatus() = default;
+        AtomicStatus(AtomicStatus&& other) : value(other.value.load()) {}
+        AtomicStatus& operator =(AtomicStatus&& other) { value = other.value.load(); return *this; }
+    } m_status;
+
 };
 
 }
@@ -3,36 +3,97 @@
 #include "libraries.hpp"
 #include "builder.hpp"
 #include "allocated.hpp"
+#include "barrierBatch.hpp"
+#include "mipGenerator.hpp"
+
+#include <atomic>
+#include <optional>
 
 namespace ignis {
 
 class Image;
+class UploadToken;
+
+/**
+ * @brief How a format's texels are packed. Uncompressed formats have 1x1 blocks
+ */
+struct FormatBlockInfo {
+    uint32_t width         = 1;
+    uint32_t height        = 1;
+    uint32_t bytesPerBlock = 0;
+
+    bool isCompressed() const { return width > 1 || height > 1; }
+
+    /**
+     * @brief The size of a tightly packed width x height region, e.g. one mip level
+     */
+    vk::DeviceSize getSize(uint32_t texelWidth, uint32_t texelHeight) const {
+        return vk::DeviceSize { (texelWidth + width - 1) / width } * ((texelHeight + height - 1) / height) * bytesPerBlock;
+    }
+};
 
+/**
+ * @brief Block info for the sampled formats images are loaded in, with zero bytesPerBlock for any other format
+ */
+FormatBlockInfo getFormatBlockInfo(vk::Format format);
+
+/**
+ * @brief A synchronization2 image barrier. Stage and access masks which aren't set are inferred from the
+ *        layouts, e.g. eColorAttachmentOptimal -> eShaderReadOnlyOptimal waits for color attachment writes
+ *        before fragment shader sampled reads
+ */
 class ImageLayoutTransition {
     Image& r_image;
 
+    static std::atomic<bool> s_debugRedundantTransitions;
+
 public:
     ImageLayoutTransition(Image& image);
 
-    vk::PipelineStageFlags    m_srcStageMask     { vk::PipelineStageFlagBits::eTopOfPipe };
-    vk::PipelineStageFlags    m_dstStageMask     { vk::PipelineStageFlagBits::eBottomOfPipe };
-    vk::ImageLayout           m_oldLayout        { vk::ImageLayout::eUndefined };
-    vk::ImageLayout           m_newLayout        { vk::ImageLayout::eUndefined };
-    vk::AccessFlags           m_srcAccessMask    {};
-    vk::AccessFlags           m_dstAccessMask    {};
-    vk::ImageSubresourceRange m_subResourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+    std::optional<vk::PipelineStageFlags2> m_srcStageMask;
+    std::optional<vk::PipelineStageFlags2> m_dstStageMask;
+    vk::ImageLayout                        m_oldLayout        { vk::ImageLayout::eUndefined };
+    vk::ImageLayout                        m_newLayout        { vk::ImageLayout::eUndefined };
+    std::optional<vk::AccessFlags2>        m_srcAccessMask;
+    std::optional<vk::AccessFlags2>        m_dstAccessMask;
+    vk::ImageSubresourceRange              m_subResourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
 
-    ImageLayoutTransition& setSrcStageMask(vk::PipelineStageFlags mask);
-    ImageLayoutTransition& setDstStageMask(vk::PipelineStageFlags mask);
+    ImageLayoutTransition& setSrcStageMask(vk::PipelineStageFlags2 mask);
+    ImageLayoutTransition& setDstStageMask(vk::PipelineStageFlags2 mask);
     ImageLayoutTransition& setOldLayout(vk::ImageLayout layout);
     ImageLayoutTransition& setNewLayout(vk::ImageLayout layout);
-    ImageLayoutTransition& setSrcAccessMask(vk::AccessFlags mask);
-    ImageLayoutTransition& setDstAccessMask(vk::AccessFlags mask);
+    ImageLayoutTransition& setSrcAccessMask(vk::AccessFlags2 mask);
+    ImageLayoutTransition& setDstAccessMask(vk::AccessFlags2 mask);
     ImageLayoutTransition& setArrayLayerRange(uint32_t base, uint32_t count);
     ImageLayoutTransition& setMipLevelRange(uint32_t base, uint32_t count);
     ImageLayoutTransition& setAspectMask(vk::ImageAspectFlags mask);
 
+    /**
+     * @param cmd Optional command buffer to record the transition into. If none is provided, it is
+     *  recorded into the upload engine's next batch, which is submitted before the next frame
+     */
     void execute(vk::CommandBuffer cmd = VK_NULL_HANDLE);
+
+    /**
+     * @brief Add the transition to `batch`, to be recorded along with others by its next flush. The image's
+     *        tracked layout is updated straight away
+     */
+    void execute(BarrierBatch& batch);
+
+    /**
+     * @brief The stages which use an image in `layout`, and how. Source access only includes writes,
+     *        since reads never need to be made available
+     */
+    static vk::PipelineStageFlags2 getLayoutStages(vk::ImageLayout layout);
+    static vk::AccessFlags2        getLayoutSrcAccess(vk::ImageLayout layout);
+    static vk::AccessFlags2        getLayoutDstAccess(vk::ImageLayout layout);
+
+    /**
+     * @brief Log a warning for every transition between the same layouts with no writes to make visible,
+     *        which only stalls the pipeline
+     */
+    static void setDebugRedundantTransitions(bool debug) { s_debugRedundantTransitions = debug; }
+    static bool getDebugRedundantTransitions() { return s_debugRedundantTransitions; }
 };
 
 class Image {
@@ -46,8 +107,11 @@ class Image {
     uint32_t      m_arrayLayerCount;
     vk::Extent3D  m_extent;
     vk::ImageAspectFlags m_aspectMask;
+    vk::ImageUsageFlags  m_usage;
     std::optional<VmaAllocation> m_allocation;
 
+    void recordBlitMipMap(vk::CommandBuffer cmd);
+
 public:
     Image() = default;
 
@@ -58,7 +122,8 @@ public:
         vk::ImageAspectFlags aspectMask,
         uint32_t             mipLevelCount = 1,
         uint32_t             arrayLayerCount = 1,
-        vk::ImageLayout      initialLayout = vk::ImageLayout::eUndefined
+        vk::ImageLayout      initialLayout = vk::ImageLayout::eUndefined,
+        vk::ImageUsageFlags  usage = {}
     );
 
     Image(Image&& other) = default;
@@ -73,6 +138,11 @@ public:
     uint32_t     getArrayLayerCount() { return m_arrayLayerCount; }
     vk::Extent3D getExtent()          { return m_extent; }
 
+    /**
+     * @brief What the image was created for, if whoever created it said. Empty for swapchain images
+     */
+    vk::ImageUsageFlags getUsage() { return m_usage; }
+
     glm::uvec3 getSize(uint32_t mipLevel = 0) {
         float scale = mipLevel > 0 ? glm::pow(0.5, mipLevel) : 1.0f;
 
@@ -99,12 +169,17 @@ public:
         uint32_t baseArrayLayer = 0, int32_t layerCount = -1);
     
     /**
-     * @brief Fills the mip levels with a simple box blur mip chain
+     * @brief Fills the mip levels from the top level, in one dispatch of the engine's MipGenerator if the image
+     *        supports it, otherwise by blitting with a linear filter one level at a time
      * 
      * @param cmd Optional command buffer to create mip chain inside a command buffer.
      *  If none is provided, this function executes synchronously
+     * @param p_scope Where the dispatch's views and descriptors are created when recording into `cmd`, which must
+     *  outlive its execution. Without one, mips recorded into `cmd` are always blitted
      */
-    void generateMipMap(vk::CommandBuffer cmd = VK_NULL_HANDLE, uint32_t baseArrayLayer = 0, int32_t layerCount = -1);
+    void generateMipMap(
+        vk::CommandBuffer cmd = VK_NULL_HANDLE, uint32_t baseArrayLayer = 0, int32_t layerCount = -1,
+        ResourceScope* p_scope = nullptr, MipGenerator::Filter filter = MipGenerator::Filter::Average);
 
     vk::ImageLayout& getLayout(uint32_t mipLevel = 0, uint32_t arrayLayer = 0);
 
@@ -121,6 +196,7 @@ public:
     vk::Format            m_format             = vk::Format::eR8G8B8A8Srgb;
     vk::ImageAspectFlags  m_aspectMask         = vk::ImageAspectFlagBits::eColor;
     vk::ImageUsageFlags   m_usage              = vk::ImageUsageFlagBits::eSampled;
+    vk::ImageCreateFlags  m_flags              = {};
     std::vector<uint32_t> m_queueFamilyIndices = {};
     vk::Extent3D          m_extent             = { 1, 1, 1 };
     vk::ImageType         m_imageType          = vk::ImageType::e2D;
@@ -133,6 +209,8 @@ public:
         Initialise
     } m_autoMipMapMode = None;
 
+    MipGenerator::Filter m_mipFilter = MipGenerator::Filter::Average;
+
     ImageBuilder(ResourceScope& scope);
 
     ImageBuilder& setMipLevelCount(uint32_t mipLevelCount);
@@ -141,6 +219,7 @@ public:
     ImageBuilder& setAspectMask(vk::ImageAspectFlags mask);
     ImageBuilder& setUsage(vk::ImageUsageFlags usage);
     ImageBuilder& addUsage(vk::ImageUsageFlags usage);
+    ImageBuilder& addFlags(vk::ImageCreateFlags flags);
     ImageBuilder& setQueueFamilyIndices(std::vector<uint32_t> indices);
     ImageBuilder& addQueueFamilyIndex(uint32_t index);
     ImageBuilder& setSize(glm::uvec2 size);
@@ -149,25 +228,53 @@ public:
     ImageBuilder& setInitialLayout(vk::ImageLayout layout);
     ImageBuilder& setAutoMipMapMode(AutoMipMapMode mode);
 
+    /**
+     * @brief How AutoMipMapMode::Initialise generates the mips. Filters other than Average need compute mip
+     *        generation, blitting always averages
+     */
+    ImageBuilder& setMipFilter(MipGenerator::Filter filter);
+
     Allocated<Image> build() override;
-    Allocated<Image> load(const char* filename);
-    Allocated<Image> load(const void* data, uint32_t width, uint32_t height);
+
+    /**
+     * @brief Build the image and upload its contents through the engine's UploadEngine without waiting.
+     *        It can be used on the graphics queue from the next frame onwards. DDS and KTX2 files are loaded
+     *        with the format and mip chain they were written with, anything else is decoded to RGBA8
+     *
+     * @param p_token Optional output for the upload's completion token
+     */
+    Allocated<Image> load(const char* filename, UploadToken* p_token = nullptr);
+    Allocated<Image> load(const void* data, uint32_t width, uint32_t height, UploadToken* p_token = nullptr);
+
+    /**
+     * @brief Build the image from a pre-built mip chain in `m_format`, which may be block compressed, e.g. BC7.
+     *        Each level is tightly packed and starts `levelOffsets[level]` bytes into `data`. A single
+     *        uncompressed level may still be extended with AutoMipMapMode::Initialise
+     */
+    Allocated<Image> loadMipChain(
+        const void* data, vk::DeviceSize size, uint32_t width, uint32_t height,
+        const std::vector<vk::DeviceSize>& levelOffsets, UploadToken* p_token = nullptr);
 };
 
 class ImageViewBuilder : public IBuilder<vk::ImageView> {
     Image& r_image;
 
 public:
-    vk::ComponentMapping m_components      = {};
-    vk::ImageViewType    m_viewType        = vk::ImageViewType::e2D;
-    vk::ImageAspectFlags m_aspectMask      = vk::ImageAspectFlagBits::eColor;
-    uint32_t             m_baseArrayLayer  = 0;
-    uint32_t             m_baseMipLevel    = 0;
-    uint32_t             m_arrayLayerCount = 1;
-    uint32_t             m_mipLevelCount   = 1;
+    std::optional<vk::Format> m_format;
+    vk::ComponentMapping      m_components      = {};
+    vk::ImageViewType         m_viewType        = vk::ImageViewType::e2D;
+    vk::ImageAspectFlags      m_aspectMask      = vk::ImageAspectFlagBits::eColor;
+    uint32_t                  m_baseArrayLayer  = 0;
+    uint32_t                  m_baseMipLevel    = 0;
+    uint32_t                  m_arrayLayerCount = 1;
+    uint32_t                  m_mipLevelCount   = 1;
 
     ImageViewBuilder(Image& image, ResourceScope& scope);
 
+    /**
+     * @brief Defaults to the image's format. Others must be compatible, and the image created with eMutableFormat
+     */
+    ImageViewBuilder& setFormat(vk::Format format);
     ImageViewBuilder& setComponentMapping(vk::ComponentMapping mapping);
     ImageViewBuilder& setViewType(vk::ImageViewType viewType);
     ImageViewBuilder& setAspectMask(vk::ImageAspectFlags mask);
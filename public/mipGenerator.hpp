@@ -0,0 +1,118 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+#include "pipelineBuilder.hpp"
+#include "uniform.hpp"
+
+namespace ignis {
+
+class Image;
+
+/**
+ * @brief Generates an image's mip chain from its top level in a single compute dispatch, rather than one blit and
+ *        barrier per level. Workgroups reduce 64x64 tiles in shared memory, and the last one to finish reduces
+ *        their results the rest of the way, so images up to 4096x4096 get all 12 of their levels at once.
+ *        Only power of two sizes are supported, since each level must be exactly half the one above it
+ *
+ *        Images need storage and sampled usage, which ImageBuilder adds when generating mips if supports() says
+ *        so. Per-frame render targets prepare a Target once, e.g. after their render graph has been compiled,
+ *        and record it from a pass which reads level 0 as Usage::ComputeSampled and writes the rest as Usage::Storage
+ */
+class MipGenerator {
+public:
+    enum class Filter : uint32_t {
+        // each texel is the mean of the four beneath it, as with blitting
+        Average = 0,
+
+        // a 4x4 Kaiser windowed sinc of the top level, which keeps more detail. Later levels are averaged from it
+        Kaiser,
+
+        // the farthest or nearest depth beneath each texel, e.g. for a depth pyramid for occlusion culling
+        Max,
+        Min,
+    };
+
+    static constexpr uint32_t s_maxGeneratedLevelCount = 12;
+    static constexpr uint32_t s_maxExtent              = 1 << s_maxGeneratedLevelCount;
+
+    /**
+     * @brief The views, descriptors and scratch memory for generating one image's mips
+     */
+    struct Target {
+        Image*     p_image = nullptr;
+        Uniform    uniform;
+        vk::Buffer scratch;
+        bool       srgb           = false;
+        bool       scratchCleared = false;
+
+        bool isValid() const { return p_image != nullptr; }
+    };
+
+private:
+    struct PushConstants {
+        glm::ivec2 sourceSize;
+        glm::ivec2 tileCount;
+        uint32_t   levelCount;
+        uint32_t   filter;
+        uint32_t   srgb;
+        uint32_t   baseArrayLayer;
+        glm::vec2  kaiserWeights;
+    };
+
+    static constexpr uint32_t s_tileSize = 64;
+
+    PipelineData            m_pipeline;
+    vk::DescriptorSetLayout m_setLayout;
+    vk::Sampler             m_sampler;
+    vk::DeviceSize          m_storageAlignment = 1;
+
+    /**
+     * @brief The outer and inner weights of a 4 tap Kaiser windowed sinc, halving the resolution
+     */
+    static glm::vec2 getKaiserWeights(float alpha);
+
+public:
+    /**
+     * @brief Build the pipeline. Without storage image writes in any format and dynamic indexing of storage image
+     *        arrays, it is left unready and everything falls back to blitting
+     */
+    void setup(ResourceScope& scope);
+    bool isReady() const { return static_cast<bool>(m_pipeline.pipeline); }
+
+    /**
+     * @brief sRGB images are written through a UNORM view, so need eMutableFormat and eExtendedUsage
+     */
+    static vk::Format getStorageFormat(vk::Format format);
+
+    /**
+     * @brief True if images of `format` and `extent` can have their mips generated here, given storage usage.
+     *        Both dimensions must be powers of two, no larger than s_maxExtent
+     */
+    bool supports(vk::Format format, vk::Extent3D extent) const;
+
+    /**
+     * @brief True if `image` can have its mips generated here as it was created
+     */
+    bool supports(Image& image) const;
+
+    /**
+     * @brief Create the views, descriptors and scratch memory for generating `image`'s mips in `scope`, which
+     *        must outlive every command buffer the target is recorded into
+     */
+    Target prepare(ResourceScope& scope, Image& image);
+
+    /**
+     * @brief Record generating every level of the target's image from its top level. The top level is left in
+     *        eShaderReadOnlyOptimal and the rest in eGeneral, and are only transitioned if they aren't already,
+     *        e.g. by a render graph
+     *
+     * @param kaiserAlpha How sharp the Kaiser window is, higher is blurrier with less ringing
+     */
+    void record(
+        vk::CommandBuffer cmd, Target& target,
+        Filter filter = Filter::Average, float kaiserAlpha = 4.0f,
+        uint32_t baseArrayLayer = 0, int32_t layerCount = -1);
+};
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "geometryPool.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace ignis {
+
+/**
+ * @brief A glTF model resolved into the streams, images and materials GLTFModel uploads. ignis_cook writes
+ *        these to disk with compressed textures, full mip chains and optimised geometry, so loading a package
+ *        only reads the file. Models loaded from glTF files are resolved the same way, minus the slow steps
+ */
+struct ModelPackage {
+    static constexpr uint32_t s_magic   = 0x4b504749; // "IGPK"
+    static constexpr uint32_t s_version = 1;
+
+    struct Image {
+        vk::Format                  format = vk::Format::eR8G8B8A8Unorm;
+        uint32_t                    width  = 0;
+        uint32_t                    height = 0;
+        std::vector<vk::DeviceSize> levelOffsets;
+        std::vector<uint8_t>        data;
+    };
+
+    struct Sampler {
+        vk::SamplerAddressMode addressModeU = vk::SamplerAddressMode::eRepeat;
+        vk::SamplerAddressMode addressModeV = vk::SamplerAddressMode::eRepeat;
+        vk::Filter             minFilter    = vk::Filter::eNearest;
+        vk::Filter             magFilter    = vk::Filter::eNearest;
+    };
+
+    // in the order of the material descriptor set's bindings
+    enum TextureSlot : uint32_t {
+        BaseColor = 0,
+        MetallicRoughness,
+        Emissive,
+        Occlusion,
+        Normal,
+        TextureSlotCount,
+    };
+
+    // -1 for the null image, or the default sampler
+    struct Texture {
+        int32_t image   = -1;
+        int32_t sampler = -1;
+    };
+
+    struct Material {
+        std::string                           name;
+        glm::vec3                             emissiveFactor  { 0.0f };
+        glm::vec4                             baseColorFactor { 1.0f };
+        float                                 metallicFactor  = 1.0f;
+        float                                 roughnessFactor = 1.0f;
+        std::array<Texture, TextureSlotCount> textures;
+    };
+
+    /**
+     * @brief Tightly packed streams with GeometryPool::s_streamStrides, and indices relative to the first vertex.
+     *        Primitives which can't be drawn have no vertices, so indices still line up with the glTF meshes
+     */
+    struct Primitive {
+        uint32_t                                                  material    = 0;
+        uint32_t                                                  vertexCount = 0;
+        std::array<std::vector<float>, GeometryPool::StreamCount> streams;
+        std::vector<uint32_t>                                     indices;
+
+        bool isValid()     const { return vertexCount > 0; }
+        bool hasTangents() const { return !streams[GeometryPool::Tangent].empty(); }
+    };
+
+    struct Mesh {
+        std::string            name;
+        std::vector<Primitive> primitives;
+    };
+
+    struct Light {
+        std::string name;
+        std::string type;
+        glm::vec3   color     { 1.0f };
+        float       intensity = 1.0f;
+    };
+
+    struct Node {
+        std::string          name;
+        int32_t              mesh        = -1;
+        int32_t              light       = -1;
+        glm::vec3            translation { 0.0f };
+        glm::quat            rotation    { 1.0f, 0.0f, 0.0f, 0.0f };
+        glm::vec3            scale       { 1.0f };
+        std::vector<int32_t> children;
+    };
+
+    struct Scene {
+        std::string          name;
+        std::vector<int32_t> nodes;
+    };
+
+    std::vector<Image>    images;
+    std::vector<Sampler>  samplers;
+    std::vector<Material> materials;
+    std::vector<Mesh>     meshes;
+    std::vector<Light>    lights;
+    std::vector<Node>     nodes;
+    std::vector<Scene>    scenes;
+
+    struct CookOptions {
+        // build every image's mip chain on the CPU, rather than blitting it on the GPU after upload
+        bool buildMipChains = false;
+
+        // BC1, BC3, BC4 or BC5 depending on what each image is used for, requires buildMipChains
+        bool compressTextures = false;
+
+        // weld duplicate vertices, and reorder triangles and vertices for the post transform and fetch caches
+        bool optimiseGeometry = false;
+    };
+
+    /**
+     * @brief Resolve a loaded glTF model. Image data is moved out of `model`, everything else is copied
+     *
+     * @param warnings Problems which don't stop the model loading, e.g. primitives which can't be drawn
+     */
+    static ModelPackage cook(gltf::Model& model, const CookOptions& options, std::vector<std::string>& warnings);
+
+    /**
+     * @brief Throws std::runtime_error if the file can't be written
+     */
+    void write(const std::string& filename) const;
+
+    /**
+     * @brief Throws std::runtime_error if the file can't be read, or isn't a package of this version
+     */
+    static ModelPackage read(const std::string& filename);
+
+    /**
+     * @brief Fill in the parts of a glTF model GLTFModel edits at runtime: its scenes, nodes and lights
+     */
+    void fillModel(gltf::Model& model) const;
+};
+
+/**
+ * @brief Copy a float accessor into a tightly packed array, following its buffer view's stride
+ */
+bool readFloatAccessor(const gltf::Model& model, int accessorID, int componentCount, std::vector<float>& out);
+
+/**
+ * @brief Read an accessor of 8, 16 or 32 bit unsigned indices as 32 bit indices
+ */
+bool readIndices(const gltf::Model& model, int accessorID, std::vector<uint32_t>& out);
+
+}
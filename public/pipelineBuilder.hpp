@@ -39,7 +39,7 @@ public:
 
 class ComputePipelineBuilder : public IPipelineBuilder {
 public:
-    std::string m_functionName;
+    std::string m_functionName = "main";
     vk::ShaderModule m_shaderModule;
 
     ComputePipelineBuilder(ResourceScope& scope);
@@ -47,7 +47,7 @@ public:
 
     ComputePipelineBuilder& setPipelineLayout(vk::PipelineLayout pipelineLayout);
     ComputePipelineBuilder& setShaderModule(vk::ShaderModule shaderModule);
-    ComputePipelineBuilder& setSHaderModule(const char* filename);
+    ComputePipelineBuilder& setShaderModuleFromFile(const char* filename);
     ComputePipelineBuilder& setFunctionName(const char* functionName);
 
     ComputePipelineBuilder& modify(std::function<void(ComputePipelineBuilder&)> func) { func(*this); return *this; }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+
+namespace ignis {
+
+/**
+ * @brief Measures GPU time spent in named scopes of a frame using timestamp queries.
+ *        Each frame in flight has its own query pool, which is read back once that frame's fence has signalled,
+ *        so reading results never stalls
+ */
+class GPUProfiler {
+public:
+    struct Timing {
+        std::string name;
+        uint32_t    depth;
+        double      milliseconds;
+        double      averageMilliseconds;
+    };
+
+    struct Frame {
+        uint64_t            frameNumber;
+        std::vector<Timing> timings;
+    };
+
+private:
+    struct Scope {
+        std::string name;
+        uint32_t    depth;
+        uint32_t    beginQuery;
+        uint32_t    endQuery;
+    };
+
+    struct FrameQueries {
+        vk::QueryPool      pool;
+        std::vector<Scope> scopes;
+        uint32_t           queryCount  = 0;
+        uint64_t           frameNumber = 0;
+    };
+
+    std::vector<FrameQueries> m_frames;
+    FrameQueries*             p_currentFrame = nullptr;
+    std::vector<uint32_t>     m_openScopes;
+
+    uint32_t m_maxQueryCount  = 0;
+    uint64_t m_timestampMask  = 0;
+    double   m_timestampPeriod = 0.0;
+    bool     m_supported      = false;
+
+    Frame                         m_latest;
+    std::map<std::string, double> m_averages;
+    bool                          m_recording = false;
+    std::vector<Frame>            m_recordedFrames;
+
+    static constexpr double s_averageWeight = 0.05;
+
+    void resolve(FrameQueries& frame);
+
+public:
+    /**
+     * @param frameCount The number of frames in flight
+     * @param maxScopeCount The maximum number of scopes recorded in a single frame
+     */
+    void setup(ResourceScope& scope, uint32_t frameCount, uint32_t queueFamilyIndex, uint32_t maxScopeCount = 64);
+
+    /**
+     * @brief Read back the results from the last time this frame in flight was recorded, and reset its queries.
+     *        Must be called after the frame's fence has signalled, at the start of the frame's command buffer
+     */
+    void beginFrame(vk::CommandBuffer cmd, uint32_t frameIndex, uint64_t frameNumber);
+
+    void beginScope(vk::CommandBuffer cmd, const std::string& name);
+    void endScope(vk::CommandBuffer cmd);
+
+    bool isSupported() const { return m_supported; }
+
+    /**
+     * @brief Timings of the most recent frame that has finished on the GPU
+     */
+    const Frame& getLatestFrame() const { return m_latest; }
+
+    /**
+     * @return The time of the most recent scope with the given name, in milliseconds, or 0 if it was not recorded
+     */
+    double getTime(const std::string& name) const;
+
+    /**
+     * @brief While recording, every resolved frame is kept so it can be written out with writeCSV or writeJSON
+     */
+    void setRecording(bool recording);
+    bool isRecording() const { return m_recording; }
+
+    /**
+     * @brief Write the recorded frames, or the latest frame if none have been recorded
+     */
+    bool writeCSV(const std::string& filename) const;
+    bool writeJSON(const std::string& filename) const;
+
+    void draw();
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "libraries.hpp"
+
+#include <map>
+#include <optional>
+
+namespace ignis {
+
+/**
+ * @brief Hands out ranges of an abstract address space, e.g. vertices or indices of a larger buffer.
+ *        Best fit over a free list, with neighbouring free ranges merged when a range is freed
+ */
+class RangeAllocator {
+    uint64_t m_capacity = 0;
+    uint64_t m_used     = 0;
+
+    // free ranges by offset, for merging, and by size, for best fit
+    std::map<uint64_t, uint64_t>      m_freeByOffset;
+    std::multimap<uint64_t, uint64_t> m_freeBySize;
+
+    // allocated ranges by offset
+    std::map<uint64_t, uint64_t> m_allocated;
+
+    void insertFree(uint64_t offset, uint64_t size);
+    void eraseFree(std::map<uint64_t, uint64_t>::iterator it);
+
+public:
+    RangeAllocator() = default;
+    RangeAllocator(uint64_t capacity);
+
+    /**
+     * @param alignment Must be a power of two
+     * @return The offset of the range, or nothing if no free range is large enough
+     */
+    std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+    void                    free(uint64_t offset);
+
+    uint64_t getCapacity()         const { return m_capacity; }
+    uint64_t getUsed()             const { return m_used; }
+    uint64_t getFree()             const { return m_capacity - m_used; }
+    uint64_t getFreeRangeCount()   const { return m_freeByOffset.size(); }
+    uint64_t getLargestFreeRange() const { return m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first; }
+
+    /**
+     * @brief Every allocated range, by offset
+     */
+    const std::map<uint64_t, uint64_t>& getAllocations() const { return m_allocated; }
+};
+
+}
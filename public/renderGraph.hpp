@@ -0,0 +1,226 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+#include "image.hpp"
+
+#include <deque>
+
+namespace ignis {
+
+/**
+ * @brief Collects passes which declare the images they read and write, then records them with the
+ *        barriers that are actually required between them, one batched pipeline barrier per pass.
+ *        Passes which contribute nothing to an output are culled, and transient images with
+ *        non-overlapping lifetimes share memory
+ */
+class RenderGraph {
+public:
+    using ImageHandle = uint32_t;
+
+    static constexpr ImageHandle s_invalidHandle = UINT32_MAX;
+
+    enum class Usage : uint8_t {
+        ColorAttachment = 0,
+        DepthAttachment,
+        Sampled,
+        TransferSrc,
+        TransferDst,
+        Present,
+
+        // read and written by compute shaders, e.g. MipGenerator's top level and the levels it generates
+        ComputeSampled,
+        Storage,
+    };
+
+    struct TransientImageInfo {
+        vk::Format           format        = vk::Format::eR8G8B8A8Unorm;
+        vk::Extent2D         extent        = { 1, 1 };
+        uint32_t             mipLevelCount = 1;
+        vk::ImageUsageFlags  usage         = vk::ImageUsageFlagBits::eColorAttachment;
+        vk::ImageAspectFlags aspectMask    = vk::ImageAspectFlagBits::eColor;
+    };
+
+    struct Stats {
+        uint32_t     passCount          = 0;
+        uint32_t     culledPassCount    = 0;
+        uint32_t     imageBarrierCount  = 0;
+        uint32_t     barrierCallCount   = 0;
+        uint32_t     transientImageCount = 0;
+        uint32_t     lazyImageCount     = 0;
+        uint32_t     memoryBlockCount   = 0;
+        vk::DeviceSize transientMemorySize = 0;
+        vk::DeviceSize aliasedMemorySaved  = 0;
+    };
+
+    class Pass {
+        friend RenderGraph;
+
+        struct Access {
+            ImageHandle image;
+            Usage       usage;
+            uint32_t    baseMipLevel;
+            uint32_t    mipLevelCount;
+            bool        write;
+        };
+
+        std::string         m_name;
+        std::string         m_group;
+        std::vector<Access> m_accesses;
+        bool                m_sideEffects = false;
+        bool                m_culled      = false;
+
+        std::function<void(vk::CommandBuffer)> m_recordFunction;
+
+        void addAccess(const Access& access);
+
+    public:
+        Pass(std::string name) : m_name(name) {}
+
+        Pass& read(ImageHandle image, Usage usage = Usage::Sampled, uint32_t baseMipLevel = 0, uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS);
+        Pass& write(ImageHandle image, Usage usage = Usage::ColorAttachment, uint32_t baseMipLevel = 0, uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS);
+
+        /**
+         * @brief Consecutive passes in the same group share one GPU profiler scope instead of one each
+         */
+        Pass& setGroup(std::string group);
+
+        /**
+         * @brief Passes with side effects are never culled, even if nothing reads what they write
+         */
+        Pass& setSideEffects(bool sideEffects = true);
+
+        Pass& setRecordFunction(std::function<void(vk::CommandBuffer)> func);
+
+        const std::string& getName() const { return m_name; }
+        bool               isCulled() const { return m_culled; }
+    };
+
+private:
+    struct UsageInfo {
+        vk::ImageLayout         layout;
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2        access;
+        vk::AccessFlags2        writeAccess;
+    };
+
+    static UsageInfo getUsageInfo(Usage usage);
+
+    struct SubresourceState {
+        vk::PipelineStageFlags2 writeStages   {};
+        vk::AccessFlags2        writeAccess   {};
+        vk::PipelineStageFlags2 readStages    {};
+        vk::PipelineStageFlags2 visibleStages {};
+        bool                    usedThisFrame = false;
+    };
+
+    struct ImageResource {
+        std::string                   name;
+        Image*                        p_image = nullptr;
+        std::vector<SubresourceState> mipStates;
+        std::optional<Usage>          outputUsage;
+
+        bool                    discardOnFirstUse = false;
+        vk::PipelineStageFlags2 firstUseStages    {};
+        vk::AccessFlags2        firstUseAccess    {};
+        bool                    touchedThisFrame  = false;
+
+        bool               transient = false;
+        TransientImageInfo transientInfo;
+        int32_t            memoryBlock = -1;
+        uint32_t           firstPass   = UINT32_MAX;
+        uint32_t           lastPass    = 0;
+    };
+
+    struct MemoryBlock {
+        VmaAllocation           allocation     = VK_NULL_HANDLE;
+        vk::MemoryRequirements  requirements   {};
+        std::vector<uint32_t>   images;
+        vk::PipelineStageFlags2 lastStages     {};
+        vk::AccessFlags2        lastAccess     {};
+    };
+
+    std::vector<ImageResource> m_images;
+    std::deque<Image>          m_transientImages;
+    std::deque<Pass>           m_passes;
+    std::vector<MemoryBlock>   m_memoryBlocks;
+
+    bool  m_compiled = false;
+    Stats m_stats;
+
+    void resetState(ImageResource& resource);
+    void cullPasses();
+    void computeLifetimes();
+    void allocateTransientImages(ResourceScope& scope);
+
+    /**
+     * @brief Images only ever used as attachments can be backed by lazily allocated memory on tilers,
+     *        which may never be committed at all
+     */
+    static bool canBeLazilyAllocated(const TransientImageInfo& info);
+
+    /**
+     * @brief Adds the barriers needed before `usage` of the given mip levels to `barriers`, and updates the tracked state
+     */
+    void addBarriers(ImageHandle handle, Usage usage, uint32_t baseMipLevel, uint32_t mipLevelCount, BarrierBatch& barriers);
+
+    void flushBarriers(vk::CommandBuffer cmd, BarrierBatch& barriers);
+
+public:
+    RenderGraph() = default;
+    RenderGraph(RenderGraph&& other) = default;
+    RenderGraph& operator =(RenderGraph&& other) = default;
+
+    RenderGraph(const RenderGraph& other) = delete;
+    RenderGraph& operator =(const RenderGraph& other) = delete;
+
+    /**
+     * @brief Make an image owned elsewhere available to passes
+     */
+    ImageHandle importImage(const std::string& name, Image& image);
+
+    /**
+     * @brief Rebind an imported image, e.g. to the swapchain image acquired this frame
+     *
+     * @param firstUseStages Stages the first barrier must wait on, e.g. the wait stage of an acquire semaphore
+     * @param discardContents If true, the image's previous contents are discarded on its first use
+     */
+    void setImage(ImageHandle handle, Image& image, vk::PipelineStageFlags2 firstUseStages = {}, bool discardContents = false);
+
+    /**
+     * @brief Declare an image which only lives for the duration of the graph. Its memory is
+     *        allocated by compile() and may be shared with other transient images. Attachment only
+     *        images use lazily allocated memory instead, where the device has it
+     */
+    ImageHandle addTransientImage(const std::string& name, const TransientImageInfo& info);
+
+    /**
+     * @brief Only valid for transient images once the graph has been compiled
+     */
+    Image& getImage(ImageHandle handle) { return *m_images[handle].p_image; }
+
+    std::optional<ImageHandle> findImage(const std::string& name) const;
+
+    /**
+     * @brief Mark an image as a result of the graph. It is transitioned for `finalUsage` at the end of execute()
+     */
+    void markOutput(ImageHandle handle, Usage finalUsage);
+
+    Pass& addPass(const std::string& name);
+
+    /**
+     * @brief Culls unused passes, computes transient image lifetimes and allocates their memory
+     */
+    void compile(ResourceScope& scope);
+
+    /**
+     * @brief Record every pass which has not been culled, along with the barriers between them
+     */
+    void execute(vk::CommandBuffer cmd);
+
+    bool isCompiled() const { return m_compiled; }
+
+    const Stats& getStats() const { return m_stats; }
+};
+
+}
@@ -3,7 +3,11 @@
 #include "libraries.hpp"
 
 #include <mutex>
-#include <list>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <memory>
+#include <cstring>
 
 // #define IGNIS_RESOURCE_SCOPE_DEBUG(...) printf(__VA_ARGS__)
 #ifndef IGNIS_RESOURCE_SCOPE_DEBUG
@@ -14,45 +18,207 @@ namespace ignis {
 
 /**
  * @brief Collects cleanup commands via void addDeferredCleanupFunction(std::function<void()> func),
- *        then later executes those commands in reverse via void executeDeferredCleanupFunctions()
+ *        or addDeferredDestroy for plain handles, then later executes those commands in reverse via
+ *        void executeDeferredCleanupFunctions(). Cleanups may be added from any thread
  */
 class ResourceScope {
+public:
+    /**
+     * @brief Device memory attributed to a scope, from allocations made by builders using it
+     */
+    struct MemoryUsage {
+        std::string    name;
+        vk::DeviceSize bytes           = 0;
+        uint32_t       allocationCount = 0;
+    };
+
+private:
     std::string m_name = "";
 
-    std::list<std::function<void()>> m_deferredCleanupCommands;
+    enum class CleanupKind : uint8_t {
+        Function = 0,
+        UntrackAllocation,
+        Buffer,
+        Image,
+        Memory,
+        DeviceImage,
+        ImageView,
+        Sampler,
+        DescriptorPool,
+        DescriptorSetLayout,
+        PipelineLayout,
+        Pipeline,
+        ShaderModule,
+    };
+
+    // destroying a handle is most of what scopes do, so those are stored inline rather than as a std::function,
+    // and only Function records have an entry in m_cleanupFunctions
+    struct CleanupRecord {
+        CleanupKind   kind       = CleanupKind::Function;
+        uint64_t      handle     = 0;       // or the byte count for UntrackAllocation
+        void*         owner      = nullptr; // the VkDevice or VmaAllocator which destroys the handle or frees the memory
+        VmaAllocation allocation = VK_NULL_HANDLE;
+    };
 
-    static int s_openScopes;
-    static int s_nextID;
+    // guards the records and functions, not the scope's name or registration
+    mutable std::mutex                 m_cleanupMutex;
+    std::vector<CleanupRecord>         m_cleanupRecords;
+    std::vector<std::function<void()>> m_cleanupFunctions;
+
+    void addRecord(const CleanupRecord& record) {
+        std::lock_guard<std::mutex> lock { m_cleanupMutex };
+        m_cleanupRecords.push_back(record);
+    }
+
+    template<typename Handle>
+    static constexpr CleanupKind getCleanupKind() {
+        if constexpr (std::is_same_v<Handle, vk::Image>)                    return CleanupKind::DeviceImage;
+        else if constexpr (std::is_same_v<Handle, vk::ImageView>)           return CleanupKind::ImageView;
+        else if constexpr (std::is_same_v<Handle, vk::Sampler>)             return CleanupKind::Sampler;
+        else if constexpr (std::is_same_v<Handle, vk::DescriptorPool>)      return CleanupKind::DescriptorPool;
+        else if constexpr (std::is_same_v<Handle, vk::DescriptorSetLayout>) return CleanupKind::DescriptorSetLayout;
+        else if constexpr (std::is_same_v<Handle, vk::PipelineLayout>)      return CleanupKind::PipelineLayout;
+        else if constexpr (std::is_same_v<Handle, vk::Pipeline>)            return CleanupKind::Pipeline;
+        else if constexpr (std::is_same_v<Handle, vk::ShaderModule>)        return CleanupKind::ShaderModule;
+        else static_assert(sizeof(Handle) == 0, "No cleanup kind for this handle type");
+    }
+
+    // non-dispatchable handles are pointers on 64 bit platforms and integers otherwise
+    template<typename Handle>
+    static uint64_t toBits(Handle handle) {
+        static_assert(sizeof(Handle) <= sizeof(uint64_t));
+        uint64_t bits = 0;
+        std::memcpy(&bits, &handle, sizeof(Handle));
+        return bits;
+    }
+
+    template<typename Handle>
+    static Handle fromBits(uint64_t bits) {
+        Handle handle;
+        std::memcpy(&handle, &bits, sizeof(Handle));
+        return handle;
+    }
+
+    void executeRecord(const CleanupRecord& record);
+
+    // shared with the cleanup functions, and moved along with them, so memory stays attributed until it is freed
+    struct MemoryCounters {
+        std::atomic<vk::DeviceSize> bytes           = 0;
+        std::atomic<uint32_t>       allocationCount = 0;
+    };
+
+    std::shared_ptr<MemoryCounters> m_memory = std::make_shared<MemoryCounters>();
+
+    static std::mutex               s_liveScopesMutex;
+    static std::set<ResourceScope*> s_liveScopes;
+
+    static std::atomic<int> s_openScopes;
+    static std::atomic<int> s_nextID;
     int m_ID = -1;
-    bool m_shouldLog;
+    bool m_shouldLog = false;
+
+    // copied by move construction but not swapped by move assignment, it belongs to the owner of the scope
+    // rather than its contents
+    bool m_deferredDeletion = false;
+
+    void registerScope();
 
     ResourceScope(const ResourceScope& other) = delete;
     ResourceScope& operator =(const ResourceScope& other) = delete;
 
 public:
-    ResourceScope(std::string name = "", bool shouldLog = false);
+    /**
+     * @param deferredDeletion If true, the cleanup functions left when the scope is destroyed, or when retire() is
+     *        called, run once the frames in flight have finished, via IEngine::deferScopeCleanup
+     */
+    ResourceScope(std::string name = "", bool shouldLog = false, bool deferredDeletion = false);
     ~ResourceScope();
 
-    ResourceScope(ResourceScope&& other) {
-        std::swap(m_deferredCleanupCommands, other.m_deferredCleanupCommands);
+    ResourceScope(ResourceScope&& other) : m_shouldLog(other.m_shouldLog), m_deferredDeletion(other.m_deferredDeletion) {
+        registerScope();
+        std::lock_guard<std::mutex> cleanupLock { other.m_cleanupMutex };
+        std::swap(m_cleanupRecords, other.m_cleanupRecords);
+        std::swap(m_cleanupFunctions, other.m_cleanupFunctions);
         std::swap(m_ID, other.m_ID);
         std::swap(m_name, other.m_name);
+        std::swap(m_memory, other.m_memory);
     }
 
     ResourceScope& operator =(ResourceScope&& other) {
-        std::swap(m_deferredCleanupCommands, other.m_deferredCleanupCommands);
+        std::lock_guard<std::mutex> lock { s_liveScopesMutex };
+        std::scoped_lock cleanupLock { m_cleanupMutex, other.m_cleanupMutex };
+        std::swap(m_cleanupRecords, other.m_cleanupRecords);
+        std::swap(m_cleanupFunctions, other.m_cleanupFunctions);
         std::swap(m_ID, other.m_ID);
         std::swap(m_name, other.m_name);
+        std::swap(m_memory, other.m_memory);
         return *this;
     }
 
     void setName(std::string name) {
         IGNIS_RESOURCE_SCOPE_DEBUG("Renamed scope %s(%d) to %s\n", m_name.c_str(), m_ID, name.c_str());
+        std::lock_guard<std::mutex> lock { s_liveScopesMutex };
         m_name = name;
     }
 
+    const std::string& getName() const { return m_name; }
+
     void addDeferredCleanupFunction(std::function<void()> func);
+
+    /**
+     * @brief Destroy a handle with `device` when the scope is cleaned up, without allocating a std::function
+     */
+    template<typename Handle>
+    void addDeferredDestroy(vk::Device device, Handle handle) {
+        addRecord({ getCleanupKind<Handle>(), toBits(handle), static_cast<VkDevice>(device) });
+    }
+
+    void addDeferredDestroy(VmaAllocator allocator, vk::Buffer buffer, VmaAllocation allocation) {
+        addRecord({ CleanupKind::Buffer, toBits(buffer), allocator, allocation });
+    }
+
+    void addDeferredDestroy(VmaAllocator allocator, vk::Image image, VmaAllocation allocation) {
+        addRecord({ CleanupKind::Image, toBits(image), allocator, allocation });
+    }
+
+    /**
+     * @brief Free memory which isn't owned by a single buffer or image, e.g. memory shared by aliased images,
+     *        when the scope is cleaned up
+     */
+    void addDeferredFree(VmaAllocator allocator, VmaAllocation allocation) {
+        addRecord({ CleanupKind::Memory, 0, allocator, allocation });
+    }
+
+    /**
+     * @brief Run the cleanup functions now, in reverse, even in deferred deletion mode
+     */
     void executeDeferredCleanupFunctions();
+
+    /**
+     * @brief Clean up the scope's current contents, leaving it empty and reusable. In deferred deletion mode they
+     *        are queued against the frame timeline instead of the caller waiting for the device to idle
+     *
+     * @param timelineValue If 0, the current frame's timeline value
+     */
+    void retire(uint64_t timelineValue = 0);
+
+    void setDeferredDeletion(bool deferredDeletion) { m_deferredDeletion = deferredDeletion; }
+    bool isDeferredDeletion() const { return m_deferredDeletion; }
+
+    /**
+     * @brief Attribute `bytes` of device memory to this scope until its cleanup functions run.
+     *        Called by the builders, after adding the allocation's own cleanup function
+     */
+    void trackAllocation(vk::DeviceSize bytes);
+
+    vk::DeviceSize getAllocatedBytes()  const { return m_memory->bytes; }
+    uint32_t       getAllocationCount() const { return m_memory->allocationCount; }
+
+    /**
+     * @brief The memory attributed to every live scope with allocations, largest first. Scopes sharing a name,
+     *        e.g. one per model, are listed separately
+     */
+    static std::vector<MemoryUsage> getMemoryUsage();
 };
 
 }
\ No newline at end of file
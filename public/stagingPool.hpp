@@ -0,0 +1,84 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "allocated.hpp"
+#include "resourceScope.hpp"
+
+#include <memory>
+
+namespace ignis {
+
+/**
+ * @brief A persistently mapped staging buffer, sub-allocated linearly by the batch it belongs to
+ */
+struct StagingChunk {
+    std::unique_ptr<ResourceScope> scope;
+    Allocated<vk::Buffer>          buffer;
+    uint8_t*                       cpuPtr = nullptr;
+    vk::DeviceSize                 size   = 0;
+    vk::DeviceSize                 used   = 0;
+};
+
+struct StagingAllocation {
+    vk::Buffer     buffer;
+    vk::DeviceSize offset = 0;
+    void*          cpuPtr = nullptr;
+};
+
+/**
+ * @brief Recycles fixed size staging chunks between upload batches. Chunks are handed to a batch when it is
+ *        submitted and returned when the batch retires, so loading a scene creates a handful of buffers rather
+ *        than one per copy. Copies larger than a chunk get a dedicated chunk, freed when it retires.
+ *        Not thread-safe, the UploadEngine calls it under its lock
+ */
+class StagingPool {
+    vk::DeviceSize m_chunkSize     = 0;
+    uint32_t       m_maxFreeChunks = 0;
+
+    std::vector<std::unique_ptr<StagingChunk>> m_freeChunks;
+
+    // chunks used by the open batch, allocations are made from the last one
+    std::vector<std::unique_ptr<StagingChunk>> m_openChunks;
+
+    vk::DeviceSize m_bytesInFlight     = 0;
+    vk::DeviceSize m_peakBytesInFlight = 0;
+    uint32_t       m_chunkCount        = 0;
+
+    vk::ResultValue<std::unique_ptr<StagingChunk>> createChunk(vk::DeviceSize size);
+
+public:
+    /**
+     * @param chunkSize The size of pooled chunks, in bytes
+     * @param maxFreeChunks The most retired chunks kept for reuse, any more are freed
+     */
+    void setup(ResourceScope& scope, vk::DeviceSize chunkSize, uint32_t maxFreeChunks);
+
+    /**
+     * @param alignment Must be a power of two
+     */
+    vk::ResultValue<StagingAllocation> allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+
+    /**
+     * @brief Hand every chunk used since the last call over to the batch being submitted
+     */
+    std::vector<std::unique_ptr<StagingChunk>> takeOpenChunks();
+
+    /**
+     * @brief Return a batch's chunks once the batch has finished on the GPU
+     */
+    void retire(std::vector<std::unique_ptr<StagingChunk>>&& chunks);
+
+    struct Stats {
+        // submitted to the GPU and not yet retired
+        vk::DeviceSize bytesInFlight     = 0;
+        vk::DeviceSize peakBytesInFlight = 0;
+        // written into the open batch, which has not been submitted yet
+        vk::DeviceSize bytesPending      = 0;
+        uint32_t       chunkCount        = 0;
+        uint32_t       freeChunkCount    = 0;
+    };
+
+    Stats getStats() const;
+};
+
+}
@@ -34,6 +34,9 @@ public:
     vk::DescriptorSetLayout build() override;
 };
 
+/**
+ * @brief Descriptor pools are externally synchronised, so give each loading thread its own pool
+ */
 class UniformBuilder : public IBuilder<Uniform> {
     vk::DescriptorPool m_pool;
     std::vector<vk::DescriptorSetLayout> m_layouts;
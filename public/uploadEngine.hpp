@@ -0,0 +1,174 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+#include "stagingPool.hpp"
+#include "barrierBatch.hpp"
+#include "mipGenerator.hpp"
+#include "commandPool.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace ignis {
+
+class Image;
+
+/**
+ * @brief Identifies the upload batch a copy was recorded into. Cheap to copy, and valid for the engine's lifetime
+ */
+class UploadToken {
+    uint64_t m_batch = 0;
+
+public:
+    UploadToken() = default;
+    explicit UploadToken(uint64_t batch) : m_batch(batch) {}
+
+    uint64_t getBatch() const { return m_batch; }
+    bool     isValid()  const { return m_batch != 0; }
+
+    /**
+     * @brief True once the upload has finished on the GPU. Invalid tokens are always complete
+     */
+    bool isComplete() const;
+
+    /**
+     * @brief Block until the upload has finished on the GPU, submitting its batch first if it is still open
+     */
+    void wait() const;
+};
+
+/**
+ * @brief Batches staged copies into one submission on the transfer queue, then hands ownership of the
+ *        destinations to the graphics queue. Batches are submitted by the engine before each frame's
+ *        graphics work, so uploaded resources can be used on the graphics queue from the next frame
+ *        onwards without waiting. Wait on the token before using them anywhere else
+ */
+class UploadEngine {
+    struct Batch {
+        uint64_t          id;
+        vk::Fence         fence;
+        vk::Semaphore     semaphore;
+        vk::CommandBuffer transferCmd;
+        vk::CommandBuffer graphicsCmd;
+        uint32_t          waiters = 0;
+
+        // returned to the staging pool once the batch's fence has signalled
+        std::vector<std::unique_ptr<StagingChunk>> stagingChunks;
+
+        // resources only the batch's commands use, e.g. mip generation descriptors, cleaned up along with it
+        ResourceScope scope;
+    };
+
+    std::mutex m_mutex;
+
+    vk::Device m_device;
+    vk::Queue  m_transferQueue;
+    vk::Queue  m_graphicsQueue;
+    uint32_t   m_transferQueueIndex;
+    uint32_t   m_graphicsQueueIndex;
+
+    // command pools are externally synchronised, so the batch's command buffers come from pools of its own,
+    // guarded by m_mutex like everything else recorded into them
+    vk::CommandPool                m_transferCmdPool;
+    vk::CommandPool                m_graphicsCmdPool;
+    std::vector<vk::CommandBuffer> m_freeTransferCmds;
+    std::vector<vk::CommandBuffer> m_freeGraphicsCmds;
+    CommandBufferStats             m_cmdStats;
+
+    // the batch uploads are currently being recorded into
+    uint64_t                       m_openBatch = 1;
+    vk::CommandBuffer              m_transferCmd;
+    vk::CommandBuffer              m_graphicsCmd;
+    ResourceScope                  m_openScope { "Upload batch" };
+
+    StagingPool                     m_stagingPool;
+    static constexpr vk::DeviceSize s_stagingChunkSize     = 16 * 1024 * 1024;
+    static constexpr uint32_t       s_maxFreeStagingChunks = 4;
+
+    // recorded on the transfer queue after every copy in the batch
+    BarrierBatch m_releaseBarriers;
+
+    // recorded on the graphics queue before any other graphics work in the batch
+    BarrierBatch m_acquireBarriers;
+
+    std::deque<Batch>          m_inFlight;
+    uint64_t                   m_completedBatch = 0;
+    std::vector<vk::Fence>     m_freeFences;
+    std::vector<vk::Semaphore> m_freeSemaphores;
+
+    bool hasDedicatedQueue() const { return m_transferQueueIndex != m_graphicsQueueIndex; }
+
+    vk::ResultValue<StagingAllocation> stage(const void* data, vk::DeviceSize size);
+
+    vk::CommandBuffer beginCommands(vk::CommandPool pool, std::vector<vk::CommandBuffer>& freeCmds);
+    vk::CommandBuffer getTransferCommands();
+    vk::CommandBuffer getGraphicsCommands();
+    void              flushAcquireBarriers();
+
+    void flushLocked();
+    void collectLocked();
+
+public:
+    void setup(
+        ResourceScope& scope,
+        vk::Queue transferQueue, uint32_t transferQueueIndex,
+        vk::Queue graphicsQueue, uint32_t graphicsQueueIndex);
+
+    /**
+     * @brief Copy `data` into `dst` via a staging buffer. `data` may be freed as soon as this returns
+     *
+     * @param dstStages The graphics stages which will first use the buffer
+     * @param concurrent True if `dst` was created with concurrent sharing, so needs no ownership transfer
+     */
+    vk::ResultValue<UploadToken> uploadBuffer(
+        vk::Buffer dst, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset = 0,
+        vk::PipelineStageFlags dstStages = vk::PipelineStageFlagBits::eAllCommands,
+        vk::AccessFlags dstAccess = vk::AccessFlagBits::eMemoryRead,
+        bool concurrent = false);
+
+    /**
+     * @brief Copy `data` into `image` via a staging buffer, then transition every mip level to `finalLayout`.
+     *        Regions are relative to the start of `data`
+     *
+     * @param generateMipMap If true, the remaining mip levels are generated from mip 0 on the graphics queue
+     * @param concurrent True if `image` was created with concurrent sharing, so needs no ownership transfer
+     * @param mipFilter How the mip levels are generated, see Image::generateMipMap
+     */
+    vk::ResultValue<UploadToken> uploadImage(
+        Image& image, const void* data, vk::DeviceSize size,
+        const std::vector<vk::BufferImageCopy>& regions,
+        vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        bool generateMipMap = false,
+        bool concurrent = false,
+        MipGenerator::Filter mipFilter = MipGenerator::Filter::Average);
+
+    /**
+     * @brief Record commands into the open batch's graphics command buffer, after the batch's uploads.
+     *        Used instead of blocking one time submissions, e.g. for initial layout transitions
+     */
+    UploadToken recordGraphicsCommands(std::function<void(vk::CommandBuffer cmd)> func);
+
+    /**
+     * @brief Submit the open batch, if it has any work in it. Called by the engine before each frame's graphics submission
+     */
+    UploadToken flush();
+
+    /**
+     * @brief Retire every batch which has finished, releasing its staging memory
+     */
+    void collect();
+
+    bool isComplete(UploadToken token);
+    void wait(UploadToken token);
+
+    StagingPool::Stats getStagingStats();
+
+    /**
+     * @brief Command buffer allocation counts since the last call, resets the counters
+     */
+    CommandBufferStats collectCommandBufferStats();
+};
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "libraries.hpp"
+#include "resourceScope.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ignis {
+
+/**
+ * @brief A fixed set of worker threads which run batches of indexed jobs. Each worker has a stable index,
+ *        so jobs can use per worker resources, such as command pools, without locking
+ */
+class WorkerPool {
+    std::vector<std::thread> m_threads;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workFinished;
+
+    std::function<void(uint32_t index, uint32_t workerIndex)> m_job;
+    uint32_t m_jobCount     = 0;
+    uint32_t m_nextJob      = 0;
+    uint32_t m_finishedJobs = 0;
+    bool     m_stopping     = false;
+
+    void workerMain(uint32_t workerIndex);
+
+public:
+    /**
+     * @param threadCount If 0, uses one thread per hardware thread
+     */
+    void setup(ResourceScope& scope, uint32_t threadCount = 0);
+
+    uint32_t getThreadCount() const { return m_threads.size(); }
+
+    /**
+     * @brief Runs `func(index, workerIndex)` for every index in [0, count) across the workers,
+     *        and returns once every job has finished. Must not be called from a worker
+     */
+    void dispatch(uint32_t count, std::function<void(uint32_t index, uint32_t workerIndex)> func);
+};
+
+}
@@ -8,11 +8,14 @@ layout (set = 0, binding = 3) uniform sampler2D t_emissive;
 
 vec3 aces(vec3 x);
 float aces(float x);
+vec4 textureCatmullRom(sampler2D tex, vec2 uv);
 
 void main() {
     vec2 uv = i_uv;
 
-    vec4 emissive = texture(t_emissive, uv);
+    // the emissive image may be rendered at a lower resolution than the game view
+    vec4 emissive = textureCatmullRom(t_emissive, uv);
+    emissive = max(emissive, vec4(0.0));
     // emissive.rgb /= emissive.a;
     emissive.rgb /= 1.0 + emissive.rgb;
 
@@ -37,3 +40,39 @@ float aces(float x) {
   const float e = 0.14;
   return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
 }
+
+// Catmull-Rom filter in 9 bilinear taps, from Jimenez 2016, "Filmic SMAA"
+vec4 textureCatmullRom(sampler2D tex, vec2 uv) {
+    vec2 texSize = vec2(textureSize(tex, 0));
+    vec2 samplePos = uv * texSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 texPos0 = (texPos1 - 1.0) / texSize;
+    vec2 texPos3 = (texPos1 + 2.0) / texSize;
+    vec2 texPos12 = (texPos1 + offset12) / texSize;
+
+    vec4 result = vec4(0.0);
+    result += texture(tex, vec2(texPos0.x,  texPos0.y))  * w0.x  * w0.y;
+    result += texture(tex, vec2(texPos12.x, texPos0.y))  * w12.x * w0.y;
+    result += texture(tex, vec2(texPos3.x,  texPos0.y))  * w3.x  * w0.y;
+
+    result += texture(tex, vec2(texPos0.x,  texPos12.y)) * w0.x  * w12.y;
+    result += texture(tex, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+    result += texture(tex, vec2(texPos3.x,  texPos12.y)) * w3.x  * w12.y;
+
+    result += texture(tex, vec2(texPos0.x,  texPos3.y))  * w0.x  * w3.y;
+    result += texture(tex, vec2(texPos12.x, texPos3.y))  * w12.x * w3.y;
+    result += texture(tex, vec2(texPos3.x,  texPos3.y))  * w3.x  * w3.y;
+
+    return result;
+}
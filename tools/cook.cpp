@@ -0,0 +1,66 @@
+#include "modelPackage.hpp"
+
+#include <filesystem>
+#include <iostream>
+
+// ignis_cook <input.glb|.gltf> [output.ipkg]
+// Resolves a glTF model into a package GLTFModel can load without decoding, compressing or optimising anything
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.glb|.gltf> [output.ipkg]" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path input = argv[1];
+    std::filesystem::path output = argc == 3 ? std::filesystem::path { argv[2] } : std::filesystem::path { input }.replace_extension(".ipkg");
+
+    gltf::TinyGLTF loader;
+    gltf::Model model;
+    std::string error, warning;
+
+    bool loadSuccess = input.extension() == ".glb"
+        ? loader.LoadBinaryFromFile(&model, &error, &warning, input.string())
+        : loader.LoadASCIIFromFile(&model, &error, &warning, input.string());
+
+    if (!warning.empty()) std::cerr << warning;
+    if (!error.empty()) std::cerr << error;
+
+    if (!loadSuccess) {
+        std::cerr << "Failed to load glTF file: " << input.string() << std::endl;
+        return 1;
+    }
+
+    ignis::ModelPackage::CookOptions options {
+        .buildMipChains   = true,
+        .compressTextures = true,
+        .optimiseGeometry = true,
+    };
+
+    std::vector<std::string> warnings;
+    ignis::ModelPackage package = ignis::ModelPackage::cook(model, options, warnings);
+
+    for (auto& cookWarning : warnings) std::cerr << "Warning: " << cookWarning << std::endl;
+
+    try {
+        package.write(output.string());
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    size_t vertexCount = 0, indexCount = 0;
+    for (auto& mesh : package.meshes)
+    for (auto& primitive : mesh.primitives) {
+        vertexCount += primitive.vertexCount;
+        indexCount += primitive.indices.size();
+    }
+
+    std::cout << "Wrote " << output.string() << ": "
+        << package.images.size() << " images, "
+        << package.materials.size() << " materials, "
+        << package.meshes.size() << " meshes, "
+        << vertexCount << " vertices and "
+        << indexCount << " indices" << std::endl;
+
+    return 0;
+}
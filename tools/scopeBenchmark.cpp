@@ -0,0 +1,140 @@
+#include "resourceScope.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <list>
+
+// ignis_scope_benchmark [registrations] [rounds]
+// Times registering and cleaning up handles with ResourceScope against the std::list of std::function it used to be
+
+namespace {
+
+// how ResourceScope stored cleanups before typed records, kept here so the two can be compared
+class ListScope {
+    std::mutex                       m_mutex;
+    std::list<std::function<void()>> m_deferredCleanupCommands;
+
+public:
+    void addDeferredCleanupFunction(std::function<void()> func) {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        m_deferredCleanupCommands.push_back(func);
+    }
+
+    void executeDeferredCleanupFunctions() {
+        while (!m_deferredCleanupCommands.empty()) {
+            m_deferredCleanupCommands.back()();
+            m_deferredCleanupCommands.pop_back();
+        }
+    }
+};
+
+struct Timings {
+    double registration = 0.0;
+    double cleanup      = 0.0;
+};
+
+template<typename Register, typename Cleanup>
+Timings measure(uint32_t registrations, uint32_t rounds, std::function<void()> createHandles, Register registerAll, Cleanup cleanupAll) {
+    using Clock = std::chrono::steady_clock;
+
+    Timings best { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        createHandles();
+
+        auto start = Clock::now();
+        registerAll();
+        auto registered = Clock::now();
+        cleanupAll();
+        auto cleanedUp = Clock::now();
+
+        // the fastest round is the one least disturbed by everything else on the machine
+        best.registration = std::min(best.registration, std::chrono::duration<double, std::nano>(registered - start).count() / registrations);
+        best.cleanup = std::min(best.cleanup, std::chrono::duration<double, std::nano>(cleanedUp - registered).count() / registrations);
+    }
+
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    uint32_t registrations = argc > 1 ? std::stoul(argv[1]) : 10000;
+    uint32_t rounds        = argc > 2 ? std::stoul(argv[2]) : 20;
+
+    auto instance = vkb::InstanceBuilder {}
+        .set_app_name("ignis_scope_benchmark")
+        .require_api_version(1, 2, 0)
+        .set_headless(true)
+        .build();
+
+    if (!instance) {
+        std::cerr << "Failed to create a vulkan instance: " << instance.error().message() << std::endl;
+        return 1;
+    }
+
+    auto physicalDevice = vkb::PhysicalDeviceSelector { instance.value() }
+        .set_minimum_version(1, 2)
+        .select();
+
+    if (!physicalDevice) {
+        std::cerr << "Failed to select a physical device: " << physicalDevice.error().message() << std::endl;
+        vkb::destroy_instance(instance.value());
+        return 1;
+    }
+
+    auto vkbDevice = vkb::DeviceBuilder { physicalDevice.value() }.build();
+
+    if (!vkbDevice) {
+        std::cerr << "Failed to create a logical device: " << vkbDevice.error().message() << std::endl;
+        vkb::destroy_instance(instance.value());
+        return 1;
+    }
+
+    vk::Device device = vkbDevice.value().device;
+
+    // empty pipeline layouts are cheap to create, and there is no limit on how many can exist at once
+    std::vector<vk::PipelineLayout> layouts;
+    auto createHandles = [&]() {
+        layouts.clear();
+        for (uint32_t i = 0; i < registrations; i++)
+            layouts.push_back(device.createPipelineLayout(vk::PipelineLayoutCreateInfo {}));
+    };
+
+    ListScope listScope;
+    Timings listTimings = measure(registrations, rounds, createHandles,
+        [&]() {
+            for (vk::PipelineLayout layout : layouts)
+                listScope.addDeferredCleanupFunction([device, layout]() { device.destroyPipelineLayout(layout); });
+        },
+        [&]() { listScope.executeDeferredCleanupFunctions(); });
+
+    ignis::ResourceScope functionScope { "Benchmark functions" };
+    Timings functionTimings = measure(registrations, rounds, createHandles,
+        [&]() {
+            for (vk::PipelineLayout layout : layouts)
+                functionScope.addDeferredCleanupFunction([device, layout]() { device.destroyPipelineLayout(layout); });
+        },
+        [&]() { functionScope.executeDeferredCleanupFunctions(); });
+
+    ignis::ResourceScope recordScope { "Benchmark records" };
+    Timings recordTimings = measure(registrations, rounds, createHandles,
+        [&]() {
+            for (vk::PipelineLayout layout : layouts)
+                recordScope.addDeferredDestroy(device, layout);
+        },
+        [&]() { recordScope.executeDeferredCleanupFunctions(); });
+
+    vkb::destroy_device(vkbDevice.value());
+    vkb::destroy_instance(instance.value());
+
+    std::cout << registrations << " registrations, best of " << rounds << " rounds, ns per registration:" << std::endl;
+    std::cout << "  std::list of std::function:    register " << listTimings.registration << ", clean up " << listTimings.cleanup << std::endl;
+    std::cout << "  addDeferredCleanupFunction:    register " << functionTimings.registration << ", clean up " << functionTimings.cleanup << std::endl;
+    std::cout << "  addDeferredDestroy:            register " << recordTimings.registration << ", clean up " << recordTimings.cleanup << std::endl;
+
+    return 0;
+}